@@ -0,0 +1,2557 @@
+MU static int bts64_reg_u8(assembler_t *assembler, reg_t rm_reg, unsigned char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xf, 0xba};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x5, rm_reg);
+
+  serialize_operand_le(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int bts32_mem_u8(assembler_t *assembler, memory_t rm_mem, unsigned char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 10);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0xf, 0xba};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, 0x5, rm_mem);
+
+  serialize_operand_le(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int ret(assembler_t *assembler, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 2);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0xc3};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int jnc_i8(assembler_t *assembler, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0x73};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int bts32_reg_u8(assembler_t *assembler, reg_t rm_reg, unsigned char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xf, 0xba};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x5, rm_reg);
+
+  serialize_operand_le(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int bt32_mem_reg(assembler_t *assembler, memory_t rm_mem, reg_t reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 9);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0xf, 0xa3};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, reg, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int je_i8(assembler_t *assembler, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0x74};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int jnz_i8(assembler_t *assembler, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0x75};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int test8_reg_i8(assembler_t *assembler, reg_t rm_reg, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xf6};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x0, rm_reg);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov64_mem_reg(assembler_t *assembler, memory_t rm_mem, reg_t reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 8);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0x89};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, reg, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp32_reg_i8(assembler_t *assembler, reg_t rm_reg, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x83};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x7, rm_reg);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp32_reg_i32(assembler_t *assembler, reg_t rm_reg, long immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 7);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x81};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x7, rm_reg);
+
+  copy_displacement(code, immediate, 4);
+
+  code += 4;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp32_reg_u32(assembler_t *assembler, reg_t rm_reg, size_t immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 7);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x81};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x7, rm_reg);
+
+  serialize_operand_le(code, immediate, 4);
+
+  code += 4;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int jbe_i8(assembler_t *assembler, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0x76};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int inc32_reg(assembler_t *assembler, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xff};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x0, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int xor32_reg_reg(assembler_t *assembler, reg_t rm_reg, reg_t reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x31};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int sete8_reg(assembler_t *assembler, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xf, 0x94};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov32_reg_reg(assembler_t *assembler, reg_t reg, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x8b};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int setc8_reg(assembler_t *assembler, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xf, 0x92};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int shr32_reg_u8(assembler_t *assembler, reg_t rm_reg, unsigned char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xc1};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x5, rm_reg);
+
+  serialize_operand_le(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov32_reg_i32(assembler_t *assembler, reg_t rm_reg, long immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 7);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xc7};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x0, rm_reg);
+
+  copy_displacement(code, immediate, 4);
+
+  code += 4;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov8_reg_i8(assembler_t *assembler, reg_t rm_reg, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xc6};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x0, rm_reg);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int lea64_reg_mem(assembler_t *assembler, reg_t reg, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 8);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0x8d};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, reg, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int add64_reg_i8(assembler_t *assembler, reg_t rm_reg, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x83};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x0, rm_reg);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov64_reg_u64(assembler_t *assembler, reg_t reg, uint64_t immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 10);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  *(code++) = REX(1, 0, 0, reg >> 3u);
+  *(code++) = 0xb8 + (reg & 7u);
+  
+  serialize_operand_le(code, immediate, 8);
+  code += 8;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int push64_reg(assembler_t *assembler, reg_t reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 2);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  if(reg >> 3u) {
+    *(code++) = REX(0, 0, 0, 1);
+  }
+  
+  *(code++) = 0x50 + (reg & 7u);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int pop64_reg(assembler_t *assembler, reg_t reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 2);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  if(reg >> 3u) {
+    *(code++) = REX(0, 0, 0, 1);
+  }
+  
+  *(code++) = 0x58 + (reg & 7u);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int push64_mem(assembler_t *assembler, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 8);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0xff};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, 0x6, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov64_mem_i32(assembler_t *assembler, memory_t rm_mem, long immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 12);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0xc7};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, 0x0, rm_mem);
+
+  copy_displacement(code, immediate, 4);
+
+  code += 4;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov32_reg_u32(assembler_t *assembler, reg_t rm_reg, size_t immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 7);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xc7};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x0, rm_reg);
+
+  serialize_operand_le(code, immediate, 4);
+
+  code += 4;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int push64_i8(assembler_t *assembler, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0x6a};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov64_reg_mem(assembler_t *assembler, reg_t reg, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 8);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0x8b};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, reg, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp64_reg_i8(assembler_t *assembler, reg_t rm_reg, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x83};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x7, rm_reg);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov64_reg_reg(assembler_t *assembler, reg_t rm_reg, reg_t reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x89};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov32_mem_i32(assembler_t *assembler, memory_t rm_mem, long immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 12);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0xc7};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, 0x0, rm_mem);
+
+  copy_displacement(code, immediate, 4);
+
+  code += 4;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov32_reg_mem(assembler_t *assembler, reg_t reg, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 8);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0x8b};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, reg, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int inc64_reg(assembler_t *assembler, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xff};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x0, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmovne64_reg_mem(assembler_t *assembler, reg_t reg, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 9);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0xf, 0x45};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, reg, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmovne64_reg_reg(assembler_t *assembler, reg_t reg, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xf, 0x45};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp64_reg_mem(assembler_t *assembler, reg_t reg, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 8);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0x3b};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, reg, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int jne_i8(assembler_t *assembler, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0x75};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int shl64_reg_i8(assembler_t *assembler, reg_t rm_reg, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xc1};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x4, rm_reg);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int add64_reg_reg(assembler_t *assembler, reg_t reg, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x3};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp64_reg_reg(assembler_t *assembler, reg_t reg, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x3b};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int ja_i8(assembler_t *assembler, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0x77};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int xchg64_reg_reg(assembler_t *assembler, reg_t reg, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x87};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int shl164_reg(assembler_t *assembler, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xd1};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x4, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int call_mem(assembler_t *assembler, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 8);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0xff};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, 0x2, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int call_reg(assembler_t *assembler, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xff};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x2, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmove64_reg_reg(assembler_t *assembler, reg_t reg, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xf, 0x44};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int mov64_reg_i32(assembler_t *assembler, reg_t rm_reg, long immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 7);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xc7};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x0, rm_reg);
+
+  copy_displacement(code, immediate, 4);
+
+  code += 4;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int jmp_mem(assembler_t *assembler, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 8);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0xff};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, 0x4, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int jmp_i8(assembler_t *assembler, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0xeb};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp64_reg_i32(assembler_t *assembler, reg_t rm_reg, long immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 7);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x81};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x7, rm_reg);
+
+  copy_displacement(code, immediate, 4);
+
+  code += 4;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int xor8_reg_reg(assembler_t *assembler, reg_t rm_reg, reg_t reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x30};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp64_mem_i8(assembler_t *assembler, memory_t rm_mem, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 9);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0x83};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, 0x7, rm_mem);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int sub64_reg_i8(assembler_t *assembler, reg_t rm_reg, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x83};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x5, rm_reg);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int movzx328_reg_mem(assembler_t *assembler, reg_t reg, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 9);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0xf, 0xb6};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, reg, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int nop(assembler_t *assembler, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 2);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0x90};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int jc_i8(assembler_t *assembler, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char opcode[] = {0x72};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int sub64_reg_reg(assembler_t *assembler, reg_t reg, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0x2b};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int not32_reg(assembler_t *assembler, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xf7};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x2, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int bsf32_reg_reg(assembler_t *assembler, reg_t reg, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xf, 0xbc};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int movdqu_xmm_mem(assembler_t *assembler, xmm_t xmm, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 10);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char prefix[] = {0xf3};
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+  const int rex_w = 0;
+  const int rex_r = xmm >> 3u;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0xf, 0x6f};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, xmm, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int movdqa_xmm_xmm(assembler_t *assembler, xmm_t xmm, xmm_t rm_xmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char prefix[] = {0x66};
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+  const int rex_w = 0;
+  const int rex_r = xmm >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, (reg_t)rm_xmm);
+
+  static const unsigned char opcode[] = {0xf, 0x6f};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, xmm, (reg_t)rm_xmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int pand_xmm_xmm(assembler_t *assembler, xmm_t xmm, xmm_t rm_xmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char prefix[] = {0x66};
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+  const int rex_w = 0;
+  const int rex_r = xmm >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, (reg_t)rm_xmm);
+
+  static const unsigned char opcode[] = {0xf, 0xdb};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, xmm, (reg_t)rm_xmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int por_xmm_xmm(assembler_t *assembler, xmm_t xmm, xmm_t rm_xmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char prefix[] = {0x66};
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+  const int rex_w = 0;
+  const int rex_r = xmm >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, (reg_t)rm_xmm);
+
+  static const unsigned char opcode[] = {0xf, 0xeb};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, xmm, (reg_t)rm_xmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int pxor_xmm_xmm(assembler_t *assembler, xmm_t xmm, xmm_t rm_xmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char prefix[] = {0x66};
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+  const int rex_w = 0;
+  const int rex_r = xmm >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, (reg_t)rm_xmm);
+
+  static const unsigned char opcode[] = {0xf, 0xef};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, xmm, (reg_t)rm_xmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int pcmpeqb_xmm_xmm(assembler_t *assembler, xmm_t xmm, xmm_t rm_xmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char prefix[] = {0x66};
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+  const int rex_w = 0;
+  const int rex_r = xmm >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, (reg_t)rm_xmm);
+
+  static const unsigned char opcode[] = {0xf, 0x74};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, xmm, (reg_t)rm_xmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int psrlw_xmm_u8(assembler_t *assembler, xmm_t rm_xmm, unsigned char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 6);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char prefix[] = {0x66};
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, (reg_t)rm_xmm);
+
+  static const unsigned char opcode[] = {0xf, 0x71};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x2, (reg_t)rm_xmm);
+
+  serialize_operand_le(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int pmovmskb_reg_xmm(assembler_t *assembler, reg_t reg, xmm_t rm_xmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char prefix[] = {0x66};
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+  const int rex_w = 0;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, (reg_t)rm_xmm);
+
+  static const unsigned char opcode[] = {0xf, 0xd7};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, (reg_t)rm_xmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int pshufb_xmm_xmm(assembler_t *assembler, xmm_t xmm, xmm_t rm_xmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 6);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char prefix[] = {0x66};
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+  const int rex_w = 0;
+  const int rex_r = xmm >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, (reg_t)rm_xmm);
+
+  static const unsigned char opcode[] = {0xf, 0x38, 0x0};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, xmm, (reg_t)rm_xmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int rep_movsb(assembler_t *assembler, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  static const unsigned char prefix[] = {0xf3};
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+  static const unsigned char opcode[] = {0xa4};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp8_mem_u8(assembler_t *assembler, memory_t rm_mem, unsigned char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 9);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0x80};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, 0x7, rm_mem);
+
+  serialize_operand_le(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp32_mem_u32(assembler_t *assembler, memory_t rm_mem, size_t immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 12);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0x81};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, 0x7, rm_mem);
+
+  serialize_operand_le(code, immediate, 4);
+
+  code += 4;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int cmp32_mem_i8(assembler_t *assembler, memory_t rm_mem, char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 9);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0x83};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, 0x7, rm_mem);
+
+  copy_displacement(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int bsf64_reg_reg(assembler_t *assembler, reg_t reg, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xf, 0xbc};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int movsxd64_reg_mem(assembler_t *assembler, reg_t reg, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 8);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 1;
+  const int rex_r = reg >> 3u;
+
+  code += encode_rex_m(code, rex_w, rex_r, rm_mem);
+
+  static const unsigned char opcode[] = {0x63};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m(code, reg, rm_mem);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int jmp_reg(assembler_t *assembler, reg_t rm_reg, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 3);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_w = 0;
+  const int rex_r = 0;
+
+  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+
+  static const unsigned char opcode[] = {0xff};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x4, rm_reg);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vzeroupper(assembler_t *assembler, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 4);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = 0;
+
+  code += encode_vex_r(code, 0, rex_r, 1, 0, 0, 0, 0);
+
+  static const unsigned char opcode[] = {0x77};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vmovdqu_ymm_mem(assembler_t *assembler, ymm_t ymm, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 10);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = ymm >> 3u;
+
+  code += encode_vex_m(code, 0, rex_r, 1, 0, 1, 2, rm_mem);
+
+  static const unsigned char opcode[] = {0x6f};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m_scaled(code, ymm, rm_mem, 1);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vbroadcasti128_ymm_mem(assembler_t *assembler, ymm_t ymm, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 10);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = ymm >> 3u;
+
+  code += encode_vex_m(code, 0, rex_r, 2, 0, 1, 1, rm_mem);
+
+  static const unsigned char opcode[] = {0x5a};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m_scaled(code, ymm, rm_mem, 1);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpand_ymm_ymm_ymm(assembler_t *assembler, ymm_t ymm, ymm_t nds_ymm, ymm_t rm_ymm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = ymm >> 3u;
+
+  code += encode_vex_r(code, 0, rex_r, 1, (size_t)nds_ymm, 1, 1, (reg_t)rm_ymm);
+
+  static const unsigned char opcode[] = {0xdb};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, ymm, (reg_t)rm_ymm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpor_ymm_ymm_ymm(assembler_t *assembler, ymm_t ymm, ymm_t nds_ymm, ymm_t rm_ymm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = ymm >> 3u;
+
+  code += encode_vex_r(code, 0, rex_r, 1, (size_t)nds_ymm, 1, 1, (reg_t)rm_ymm);
+
+  static const unsigned char opcode[] = {0xeb};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, ymm, (reg_t)rm_ymm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpxor_ymm_ymm_ymm(assembler_t *assembler, ymm_t ymm, ymm_t nds_ymm, ymm_t rm_ymm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = ymm >> 3u;
+
+  code += encode_vex_r(code, 0, rex_r, 1, (size_t)nds_ymm, 1, 1, (reg_t)rm_ymm);
+
+  static const unsigned char opcode[] = {0xef};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, ymm, (reg_t)rm_ymm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpcmpeqb_ymm_ymm_ymm(assembler_t *assembler, ymm_t ymm, ymm_t nds_ymm, ymm_t rm_ymm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = ymm >> 3u;
+
+  code += encode_vex_r(code, 0, rex_r, 1, (size_t)nds_ymm, 1, 1, (reg_t)rm_ymm);
+
+  static const unsigned char opcode[] = {0x74};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, ymm, (reg_t)rm_ymm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpshufb_ymm_ymm_ymm(assembler_t *assembler, ymm_t ymm, ymm_t nds_ymm, ymm_t rm_ymm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = ymm >> 3u;
+
+  code += encode_vex_r(code, 0, rex_r, 2, (size_t)nds_ymm, 1, 1, (reg_t)rm_ymm);
+
+  static const unsigned char opcode[] = {0x0};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, ymm, (reg_t)rm_ymm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpsrlw_ymm_ymm_u8(assembler_t *assembler, ymm_t nds_ymm, ymm_t rm_ymm, unsigned char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 6);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = 0;
+
+  code += encode_vex_r(code, 0, rex_r, 1, (size_t)nds_ymm, 1, 1, (reg_t)rm_ymm);
+
+  static const unsigned char opcode[] = {0x71};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x2, (reg_t)rm_ymm);
+
+  serialize_operand_le(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpmovmskb_reg_ymm(assembler_t *assembler, reg_t reg, ymm_t rm_ymm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = reg >> 3u;
+
+  code += encode_vex_r(code, 0, rex_r, 1, 0, 1, 1, (reg_t)rm_ymm);
+
+  static const unsigned char opcode[] = {0xd7};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, (reg_t)rm_ymm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vptest_ymm_ymm(assembler_t *assembler, ymm_t ymm, ymm_t rm_ymm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = ymm >> 3u;
+
+  code += encode_vex_r(code, 0, rex_r, 2, 0, 1, 1, (reg_t)rm_ymm);
+
+  static const unsigned char opcode[] = {0x17};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, ymm, (reg_t)rm_ymm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vmovdqu8_zmm_mem(assembler_t *assembler, zmm_t zmm, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 11);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = zmm >> 3u;
+
+  code += encode_evex_m(code, 0, rex_r, 1, 0, 2, 3, rm_mem);
+
+  static const unsigned char opcode[] = {0x6f};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m_scaled(code, zmm, rm_mem, 64);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vbroadcasti32x4_zmm_mem(assembler_t *assembler, zmm_t zmm, memory_t rm_mem, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 11);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = zmm >> 3u;
+
+  code += encode_evex_m(code, 0, rex_r, 2, 0, 2, 1, rm_mem);
+
+  static const unsigned char opcode[] = {0x5a};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_m_scaled(code, zmm, rm_mem, 16);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpandd_zmm_zmm_zmm(assembler_t *assembler, zmm_t zmm, zmm_t nds_zmm, zmm_t rm_zmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 6);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = zmm >> 3u;
+
+  code += encode_evex_r(code, 0, rex_r, 1, (size_t)nds_zmm, 2, 1, (reg_t)rm_zmm);
+
+  static const unsigned char opcode[] = {0xdb};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, zmm, (reg_t)rm_zmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpord_zmm_zmm_zmm(assembler_t *assembler, zmm_t zmm, zmm_t nds_zmm, zmm_t rm_zmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 6);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = zmm >> 3u;
+
+  code += encode_evex_r(code, 0, rex_r, 1, (size_t)nds_zmm, 2, 1, (reg_t)rm_zmm);
+
+  static const unsigned char opcode[] = {0xeb};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, zmm, (reg_t)rm_zmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpxord_zmm_zmm_zmm(assembler_t *assembler, zmm_t zmm, zmm_t nds_zmm, zmm_t rm_zmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 6);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = zmm >> 3u;
+
+  code += encode_evex_r(code, 0, rex_r, 1, (size_t)nds_zmm, 2, 1, (reg_t)rm_zmm);
+
+  static const unsigned char opcode[] = {0xef};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, zmm, (reg_t)rm_zmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpshufb_zmm_zmm_zmm(assembler_t *assembler, zmm_t zmm, zmm_t nds_zmm, zmm_t rm_zmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 6);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = zmm >> 3u;
+
+  code += encode_evex_r(code, 0, rex_r, 2, (size_t)nds_zmm, 2, 1, (reg_t)rm_zmm);
+
+  static const unsigned char opcode[] = {0x0};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, zmm, (reg_t)rm_zmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vpsrlw_zmm_zmm_u8(assembler_t *assembler, zmm_t nds_zmm, zmm_t rm_zmm, unsigned char immediate, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 7);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = 0;
+
+  code += encode_evex_r(code, 0, rex_r, 1, (size_t)nds_zmm, 2, 1, (reg_t)rm_zmm);
+
+  static const unsigned char opcode[] = {0x71};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, 0x2, (reg_t)rm_zmm);
+
+  serialize_operand_le(code, immediate, 1);
+
+  code += 1;
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int vptestmb_k_zmm_zmm(assembler_t *assembler, kreg_t k, zmm_t nds_zmm, zmm_t rm_zmm, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 6);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = k >> 3u;
+
+  code += encode_evex_r(code, 0, rex_r, 2, (size_t)nds_zmm, 2, 1, (reg_t)rm_zmm);
+
+  static const unsigned char opcode[] = {0x26};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, k, (reg_t)rm_zmm);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int kortestq_k_k(assembler_t *assembler, kreg_t k, kreg_t rm_k, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = k >> 3u;
+
+  code += encode_vex_r(code, 1, rex_r, 1, 0, 0, 0, (reg_t)rm_k);
+
+  static const unsigned char opcode[] = {0x98};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, k, (reg_t)rm_k);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
+
+MU static int kmovq_reg_k(assembler_t *assembler, reg_t reg, kreg_t rm_k, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char* code = reserve_assembler_space(assembler, 5);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  const int rex_r = reg >> 3u;
+
+  code += encode_vex_r(code, 1, rex_r, 1, 0, 0, 3, (reg_t)rm_k);
+
+  static const unsigned char opcode[] = {0x93};
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+  code += encode_mod_reg_rm_r(code, reg, (reg_t)rm_k);
+
+  resize_assembler(assembler, code);
+
+  return 1;
+}
@@ -30,10 +30,10 @@ typedef struct {
 } execution_engine_t;
 
 #define CREX_ALLOC(allocator, size)                                                                \
-  ((crex_allocator_t *)allocator)->alloc(((crex_allocator_t *)allocator)->data, (size))
+  ((crex_allocator_t *)allocator)->alloc(((crex_allocator_t *)allocator)->context, (size))
 
 #define CREX_FREE(allocator, pointer)                                                              \
-  ((crex_allocator_t *)allocator)->free(((crex_allocator_t *)allocator)->data, (pointer))
+  ((crex_allocator_t *)allocator)->free(((crex_allocator_t *)allocator)->context, (pointer))
 
 #define PCRE_ALLOC(allocator, size)                                                                \
   ((pcre_allocator_t *)allocator)->alloc((size), ((pcre_allocator_t *)allocator)->data)
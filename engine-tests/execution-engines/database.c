@@ -0,0 +1,83 @@
+#undef NDEBUG
+
+#include <assert.h>
+
+#include "../execution-engine.h"
+
+typedef struct {
+  unsigned char *buffer;
+  crex_database_t *database;
+  const crex_regex_t *regex;
+} database_regex_t;
+
+static void *create(void *allocator) {
+  crex_context_t *context = crex_create_context_with_allocator(NULL, allocator);
+  assert(context != NULL);
+
+  return context;
+}
+
+static void destroy(void *context, void *allocator) {
+  (void)allocator;
+
+  crex_destroy_context(context);
+}
+
+// Dumps the regex to a database of its own, and runs it in place from there
+static void *compile_regex(
+    void *context, const char *pattern, size_t size, size_t n_capturing_groups, void *allocator) {
+  (void)context;
+
+  database_regex_t *regex = CREX_ALLOC(allocator, sizeof(database_regex_t));
+  assert(regex != NULL);
+
+  crex_regex_t *compiled_regex = crex_compile_with_allocator(NULL, pattern, size, allocator);
+  assert(compiled_regex != NULL);
+
+  size_t buffer_size;
+  const crex_regex_t *const regexes[] = {compiled_regex};
+
+  regex->buffer = crex_dump_database_with_allocator(NULL, &buffer_size, regexes, 1, allocator);
+  assert(regex->buffer != NULL);
+
+  crex_destroy_regex(compiled_regex);
+
+  regex->database = crex_open_database_with_allocator(NULL, regex->buffer, buffer_size, allocator);
+  assert(regex->database != NULL);
+
+  assert(crex_database_n_regexes(regex->database) == 1);
+
+  crex_status_t status;
+  regex->regex = crex_database_regex(&status, regex->database, 0);
+  assert(regex->regex != NULL && status == CREX_OK);
+
+  assert(crex_regex_n_capturing_groups(regex->regex) == n_capturing_groups);
+
+  return regex;
+}
+
+static void destroy_regex(void *context, void *regex, void *allocator) {
+  (void)context;
+
+  database_regex_t *database_regex = regex;
+
+  crex_close_database(database_regex->database);
+  CREX_FREE(allocator, database_regex->buffer);
+  CREX_FREE(allocator, database_regex);
+}
+
+static int
+run(void *context, void *matches, void *regex, const char *str, size_t size, void *allocator) {
+  (void)allocator;
+
+  const database_regex_t *database_regex = regex;
+
+  const crex_status_t status =
+      crex_match_groups(matches, context, database_regex->regex, str, size);
+  assert(status == CREX_OK);
+
+  return 1;
+}
+
+const execution_engine_t ex_database = {
+    "database", 0, 1, create, destroy, compile_regex, destroy_regex, run};
@@ -0,0 +1,63 @@
+#undef NDEBUG
+
+#include <assert.h>
+
+#include "../execution-engine.h"
+
+static void *create(void *allocator) {
+  crex_context_t *context = crex_create_context_with_allocator(NULL, allocator);
+  assert(context != NULL);
+
+  return context;
+}
+
+static void destroy(void *context, void *allocator) {
+  (void)allocator;
+
+  crex_destroy_context(context);
+}
+
+// Round-trips the regex through a dump including its native code, which is loaded as-is
+static void *compile_regex(
+    void *context, const char *pattern, size_t size, size_t n_capturing_groups, void *allocator) {
+  (void)context;
+
+  crex_regex_t *regex = crex_compile_with_allocator(NULL, pattern, size, allocator);
+  assert(regex != NULL);
+
+  size_t dump_size;
+  unsigned char *dump = crex_dump_regex_with_native_code(NULL, &dump_size, regex, allocator);
+  assert(dump != NULL);
+
+  crex_destroy_regex(regex);
+
+  crex_status_t status;
+  regex = crex_load_trusted_regex_with_native_code(&status, dump, dump_size, allocator);
+  assert(regex != NULL && status == CREX_OK);
+
+  CREX_FREE(allocator, dump);
+
+  assert(crex_regex_n_capturing_groups(regex) == n_capturing_groups);
+
+  return regex;
+}
+
+static void destroy_regex(void *context, void *regex, void *allocator) {
+  (void)allocator;
+  (void)context;
+
+  crex_destroy_regex(regex);
+}
+
+static int
+run(void *context, void *matches, void *regex, const char *str, size_t size, void *allocator) {
+  (void)allocator;
+
+  const crex_status_t status = crex_match_groups(matches, context, regex, str, size);
+  assert(status == CREX_OK);
+
+  return 1;
+}
+
+const execution_engine_t ex_dump_native = {
+    "dump-native", 0, 1, create, destroy, compile_regex, destroy_regex, run};
@@ -0,0 +1,76 @@
+#undef NDEBUG
+
+#include <assert.h>
+
+#include "../execution-engine.h"
+
+static void *create(void *allocator) {
+  crex_context_t *context = crex_create_context_with_allocator(NULL, allocator);
+  assert(context != NULL);
+
+  return context;
+}
+
+static void destroy(void *context, void *allocator) {
+  (void)allocator;
+
+  crex_destroy_context(context);
+}
+
+static void *compile_regex(
+    void *context, const char *pattern, size_t size, size_t n_capturing_groups, void *allocator) {
+  (void)context;
+
+  crex_regex_t *regex = crex_compile_with_allocator(NULL, pattern, size, allocator);
+  assert(regex != NULL);
+
+  assert(crex_regex_n_capturing_groups(regex) == n_capturing_groups);
+
+  return regex;
+}
+
+static void destroy_regex(void *context, void *regex, void *allocator) {
+  (void)allocator;
+  (void)context;
+
+  crex_destroy_regex(regex);
+}
+
+// The first match of the iteration is the one the suite expects. The rest of the matches are run
+// through too, and must be in order and not overlap; nor may an empty match immediately follow the
+// previous match
+static int
+run(void *context, void *matches, void *regex, const char *str, size_t size, void *allocator) {
+  (void)allocator;
+
+  crex_find_all(context, regex, str, size);
+
+  crex_status_t status = crex_next_match_groups(matches, context);
+  assert(status == CREX_OK);
+
+  crex_match_t prev_match = *(crex_match_t *)matches;
+  int ok = 1;
+
+  while (prev_match.begin != NULL) {
+    crex_match_t match;
+
+    status = crex_next_match(&match, context);
+    assert(status == CREX_OK);
+
+    if (match.begin == NULL) {
+      break;
+    }
+
+    const int empty = match.begin == match.end;
+
+    ok &= match.begin >= prev_match.end && match.end <= str + size;
+    ok &= !(empty && match.begin == prev_match.end);
+
+    prev_match = match;
+  }
+
+  return ok;
+}
+
+const execution_engine_t ex_find_all = {
+    "find-all", 0, 1, create, destroy, compile_regex, destroy_regex, run};
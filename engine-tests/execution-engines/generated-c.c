@@ -0,0 +1,118 @@
+#undef NDEBUG
+
+#include <assert.h>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../execution-engine.h"
+
+// Each regex is generated as C with crex_generate_c, compiled to a shared library with the C
+// compiler named by $CC (or cc), and loaded with dlopen. This takes a while per pattern
+
+#define GENERATED_NAME "generated"
+
+typedef int (*generated_match_groups_t)(const char **groups, const char *str, size_t size);
+
+typedef struct {
+  void *library;
+  generated_match_groups_t match_groups;
+} generated_regex_t;
+
+static void *compile_regex(
+    void *self, const char *pattern, size_t size, size_t n_capturing_groups, void *allocator) {
+  (void)self;
+
+  crex_regex_t *regex = crex_compile_with_allocator(NULL, pattern, size, allocator);
+  assert(regex != NULL);
+
+  assert(crex_regex_n_capturing_groups(regex) == n_capturing_groups);
+
+  crex_output_t output = {NULL, 0, 0};
+
+  crex_status_t status = crex_generate_c(&output, regex, GENERATED_NAME);
+  assert(status == CREX_OK);
+
+  crex_destroy_regex(regex);
+
+  char directory[] = "/tmp/crex-generated-XXXXXX";
+  const char *mkdtemp_result = mkdtemp(directory);
+  assert(mkdtemp_result != NULL);
+
+  char source_path[sizeof(directory) + 32];
+  char library_path[sizeof(directory) + 32];
+
+  snprintf(source_path, sizeof(source_path), "%s/%s.c", directory, GENERATED_NAME);
+  snprintf(library_path, sizeof(library_path), "%s/%s.so", directory, GENERATED_NAME);
+
+  FILE *source = fopen(source_path, "w");
+  assert(source != NULL);
+
+  const size_t n_written = fwrite(output.buffer, 1, output.size, source);
+  assert(n_written == output.size);
+
+  const int close_status = fclose(source);
+  assert(close_status == 0);
+
+  CREX_FREE(allocator, output.buffer);
+
+  const char *cc = getenv("CC");
+
+  char command[256 + 2 * sizeof(directory)];
+
+  snprintf(command,
+           sizeof(command),
+           "%s -std=c99 -shared -fPIC -o %s %s",
+           (cc == NULL || *cc == 0) ? "cc" : cc,
+           library_path,
+           source_path);
+
+  const int command_status = system(command);
+  assert(command_status == 0);
+
+  generated_regex_t *generated_regex = CREX_ALLOC(allocator, sizeof(generated_regex_t));
+  assert(generated_regex != NULL);
+
+  generated_regex->library = dlopen(library_path, RTLD_NOW | RTLD_LOCAL);
+  assert(generated_regex->library != NULL);
+
+  // ISO C has no conversion from an object pointer to a function pointer, so copy the bits
+  void *symbol = dlsym(generated_regex->library, GENERATED_NAME "_match_groups");
+  assert(symbol != NULL);
+
+  memcpy(&generated_regex->match_groups, &symbol, sizeof(symbol));
+
+  // The library stays mapped after its file is gone
+  unlink(source_path);
+  unlink(library_path);
+  rmdir(directory);
+
+  return generated_regex;
+}
+
+static void destroy_regex(void *self, void *regex, void *allocator) {
+  (void)self;
+
+  generated_regex_t *generated_regex = regex;
+
+  dlclose(generated_regex->library);
+  CREX_FREE(allocator, generated_regex);
+}
+
+static int
+run(void *self, void *matches, void *regex, const char *str, size_t size, void *allocator) {
+  (void)self;
+  (void)allocator;
+
+  const generated_regex_t *generated_regex = regex;
+
+  // A crex_match_t is a pair of pointers, which is what the generated code expects for each group
+  const int is_match = generated_regex->match_groups(matches, str, size);
+
+  return is_match == (((crex_match_t *)matches)[0].begin != NULL);
+}
+
+const execution_engine_t ex_generated_c = {
+    "generated-c", 0, 1, NULL, NULL, compile_regex, destroy_regex, run};
@@ -0,0 +1,81 @@
+#undef NDEBUG
+
+#include <assert.h>
+
+#include "../execution-engine.h"
+
+typedef struct {
+  crex_regex_t *regex;
+  crex_regex_set_t *set;
+} set_regex_t;
+
+static void *create(void *allocator) {
+  crex_context_t *context = crex_create_context_with_allocator(NULL, allocator);
+  assert(context != NULL);
+
+  return context;
+}
+
+static void destroy(void *context, void *allocator) {
+  (void)allocator;
+
+  crex_destroy_context(context);
+}
+
+static void *compile_regex(
+    void *context, const char *pattern, size_t size, size_t n_capturing_groups, void *allocator) {
+  (void)context;
+
+  set_regex_t *regex = CREX_ALLOC(allocator, sizeof(set_regex_t));
+  assert(regex != NULL);
+
+  regex->regex = crex_compile_with_allocator(NULL, pattern, size, allocator);
+  assert(regex->regex != NULL);
+
+  assert(crex_regex_n_capturing_groups(regex->regex) == n_capturing_groups);
+
+  regex->set = crex_compile_regex_set_with_allocator(NULL, &pattern, &size, 1, allocator);
+  assert(regex->set != NULL);
+
+  return regex;
+}
+
+static void destroy_regex(void *context, void *regex, void *allocator) {
+  (void)context;
+
+  set_regex_t *set_regex = regex;
+
+  crex_destroy_regex(set_regex->regex);
+  crex_destroy_regex_set(set_regex->set);
+  CREX_FREE(allocator, set_regex);
+}
+
+// A regex set only says which of its patterns match, so the groups come from the regex itself; the
+// set of one pattern must agree with them as to whether there's a match
+static int
+run(void *context, void *matches, void *regex, const char *str, size_t size, void *allocator) {
+  (void)allocator;
+
+  set_regex_t *set_regex = regex;
+
+  crex_status_t status = crex_match_groups(matches, context, set_regex->regex, str, size);
+  assert(status == CREX_OK);
+
+  const int is_match = ((crex_match_t *)matches)[0].begin != NULL;
+
+  unsigned char set_is_match;
+
+  status = crex_regex_set_is_match(&set_is_match, context, set_regex->set, str, size);
+  assert(status == CREX_OK);
+
+  size_t index;
+  size_t n_matches;
+
+  status = crex_regex_set_match_indices(&index, &n_matches, context, set_regex->set, str, size);
+  assert(status == CREX_OK);
+
+  return set_is_match == is_match && n_matches == (size_t)is_match && (!is_match || index == 0);
+}
+
+const execution_engine_t ex_regex_set = {
+    "regex-set", 0, 1, create, destroy, compile_regex, destroy_regex, run};
@@ -0,0 +1,96 @@
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdint.h>
+
+#include "../execution-engine.h"
+
+typedef struct {
+  crex_regex_t *regex;
+  size_t n_capturing_groups;
+  crex_span_t *spans;
+} stream_regex_t;
+
+static void *create(void *allocator) {
+  crex_context_t *context = crex_create_context_with_allocator(NULL, allocator);
+  assert(context != NULL);
+
+  return context;
+}
+
+static void destroy(void *context, void *allocator) {
+  (void)allocator;
+
+  crex_destroy_context(context);
+}
+
+static void *compile_regex(
+    void *context, const char *pattern, size_t size, size_t n_capturing_groups, void *allocator) {
+  (void)context;
+
+  stream_regex_t *regex = CREX_ALLOC(allocator, sizeof(stream_regex_t));
+  assert(regex != NULL);
+
+  regex->regex = crex_compile_with_allocator(NULL, pattern, size, allocator);
+  assert(regex->regex != NULL);
+
+  assert(crex_regex_n_capturing_groups(regex->regex) == n_capturing_groups);
+
+  regex->n_capturing_groups = n_capturing_groups;
+  regex->spans = CREX_ALLOC(allocator, sizeof(crex_span_t) * n_capturing_groups);
+  assert(regex->spans != NULL);
+
+  return regex;
+}
+
+static void destroy_regex(void *context, void *regex, void *allocator) {
+  (void)context;
+
+  stream_regex_t *stream_regex = regex;
+
+  crex_destroy_regex(stream_regex->regex);
+  CREX_FREE(allocator, stream_regex->spans);
+  CREX_FREE(allocator, stream_regex);
+}
+
+// Feeds the string to a stream one byte at a time, which is the hardest case for carrying state
+// across chunks
+static int
+run(void *context, void *matches, void *regex, const char *str, size_t size, void *allocator) {
+  (void)allocator;
+
+  stream_regex_t *stream_regex = regex;
+
+  crex_status_t status = crex_stream_begin(context, stream_regex->regex, CREX_STREAM_GROUPS);
+  assert(status == CREX_OK);
+
+  for (size_t i = 0; i < size; i++) {
+    status = crex_stream_feed(context, str + i, 1);
+    assert(status == CREX_OK);
+  }
+
+  int is_match;
+
+  status = crex_stream_end(&is_match, stream_regex->spans, context);
+  assert(status == CREX_OK);
+
+  crex_match_t *groups = matches;
+
+  for (size_t i = 0; i < stream_regex->n_capturing_groups; i++) {
+    const crex_span_t *span = &stream_regex->spans[i];
+
+    if (span->begin == SIZE_MAX) {
+      assert(span->end == SIZE_MAX);
+      groups[i].begin = NULL;
+      groups[i].end = NULL;
+    } else {
+      groups[i].begin = str + span->begin;
+      groups[i].end = str + span->end;
+    }
+  }
+
+  return is_match == (groups[0].begin != NULL);
+}
+
+const execution_engine_t ex_stream = {
+    "stream", 0, 1, create, destroy, compile_regex, destroy_regex, run};
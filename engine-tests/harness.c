@@ -181,6 +181,7 @@ size_t parse_size(char *str) {
     size_t digit = *str - '0';
     assert(digit <= 9 && value <= (SIZE_MAX - digit) / 10);
     value = 10 * value + digit;
+    str++;
   }
 
   return value;
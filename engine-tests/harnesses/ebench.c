@@ -1,3 +1,614 @@
-int main(void) {
+#define PCRE2_CODE_UNIT_WIDTH 8
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pcre2.h>
+
+#include "../execution-engine.h"
+#include "../harness.h"
+#include "../suite.h"
+
+extern const execution_engine_t ex_default;
+extern const execution_engine_t ex_alloc_hygiene;
+extern const execution_engine_t ex_pcre_default;
+extern const execution_engine_t ex_pcre_jit;
+extern const execution_engine_t ex_dump;
+extern const execution_engine_t ex_dump_native;
+extern const execution_engine_t ex_find_all;
+extern const execution_engine_t ex_stream;
+extern const execution_engine_t ex_regex_set;
+extern const execution_engine_t ex_database;
+extern const execution_engine_t ex_generated_c;
+
+#define N_ENGINES 11
+
+static const execution_engine_t *all_engines[N_ENGINES] = {
+    &ex_default, &ex_alloc_hygiene, &ex_pcre_default, &ex_pcre_jit, &ex_dump, &ex_dump_native,
+    &ex_find_all, &ex_stream, &ex_regex_set, &ex_database, &ex_generated_c};
+
+#define DEFAULT_N_ITERATIONS 5
+#define DEFAULT_N_WARMUP_ITERATIONS 1
+
+typedef struct {
+  size_t n_iterations;
+  size_t n_warmup_iterations;
+  int per_pattern;
+} bench_options_t;
+
+// Match latencies are recorded in nanoseconds in an HDR-style histogram. Values below
+// HISTOGRAM_SUB_BUCKETS have a bucket each; above that, each power of 2 is split into
+// HISTOGRAM_SUB_BUCKETS / 2 buckets, so a bucket spans under 1/64 of its values. Values beyond the
+// last power of 2 (about 9 minutes) land in the last bucket
+#define HISTOGRAM_SUB_BUCKET_BITS 7
+#define HISTOGRAM_SUB_BUCKETS (1u << HISTOGRAM_SUB_BUCKET_BITS)
+#define HISTOGRAM_MAX_SHIFT 32
+#define HISTOGRAM_SIZE (HISTOGRAM_SUB_BUCKETS + HISTOGRAM_MAX_SHIFT * (HISTOGRAM_SUB_BUCKETS / 2))
+
+typedef struct {
+  uint64_t counts[HISTOGRAM_SIZE];
+  uint64_t n_values;
+  uint64_t max_value;
+} latency_histogram_t;
+
+// The measurements for one suite on one engine. Times are in seconds; compile_time and match_time
+// are means over the timed iterations, and the sizes and counts are per iteration
+typedef struct {
+  size_t n_patterns;
+  size_t n_testcases;
+  size_t n_bytes;
+  size_t n_matches;
+
+  double compile_time;
+  double match_time;
+  double best_match_time;
+
+  bm_alloc_stats_t match_allocations;
+
+  latency_histogram_t latencies;
+
+  // One histogram per pattern if options->per_pattern, and NULL otherwise
+  latency_histogram_t *pattern_latencies;
+} bench_result_t;
+
+static void bench_suite_with_engine(bench_result_t *result,
+                                    const execution_engine_t *engine,
+                                    void *self,
+                                    suite_t *suite,
+                                    allocator_t *allocator,
+                                    const bench_options_t *options);
+
+static double compile_patterns(void **regexes,
+                               const execution_engine_t *engine,
+                               void *self,
+                               suite_t *suite,
+                               allocator_t *allocator);
+
+static void destroy_patterns(void **regexes,
+                             const execution_engine_t *engine,
+                             void *self,
+                             suite_t *suite,
+                             allocator_t *allocator);
+
+static double run_testcases(const execution_engine_t *engine,
+                            void *self,
+                            void *matches,
+                            void **regexes,
+                            suite_t *suite,
+                            allocator_t *allocator);
+
+static void record_latencies(latency_histogram_t *latencies,
+                             latency_histogram_t *pattern_latencies,
+                             const execution_engine_t *engine,
+                             void *self,
+                             void *matches,
+                             void **regexes,
+                             suite_t *suite,
+                             allocator_t *allocator);
+
+static void record_latency(latency_histogram_t *histogram, uint64_t value);
+static void merge_histograms(latency_histogram_t *histogram, const latency_histogram_t *other);
+static uint64_t histogram_percentile(const latency_histogram_t *histogram, double percentile);
+
+static void
+print_result(const char *engine_name, const char *suite_name, const bench_result_t *result);
+
+static void print_pattern_latencies(const char *engine_name,
+                                    const char *suite_name,
+                                    const suite_t *suite,
+                                    const latency_histogram_t *pattern_latencies);
+
+static void print_latencies(const latency_histogram_t *histogram);
+
+static void usage(char **argv);
+
+int main(int argc, char **argv) {
+  bench_options_t options = {DEFAULT_N_ITERATIONS, DEFAULT_N_WARMUP_ITERATIONS, 0};
+
+  int arg = 1;
+
+  for (; arg < argc; arg++) {
+    if (strcmp(argv[arg], "-p") == 0) {
+      options.per_pattern = 1;
+    } else if (strcmp(argv[arg], "-n") == 0 && arg + 1 < argc) {
+      options.n_iterations = parse_size(argv[++arg]);
+    } else if (strcmp(argv[arg], "-w") == 0 && arg + 1 < argc) {
+      options.n_warmup_iterations = parse_size(argv[++arg]);
+    } else {
+      break;
+    }
+  }
+
+  size_t n_engine_names;
+  char **engine_names = argv + arg;
+
+  for (n_engine_names = 0; n_engine_names < (size_t)(argc - arg); n_engine_names++) {
+    if (strcmp(engine_names[n_engine_names], "--") == 0) {
+      break;
+    }
+  }
+
+  if (options.n_iterations == 0 || n_engine_names + 1 >= (size_t)(argc - arg)) {
+    // No suites given, missing -- seperator, or nothing to time
+    usage(argv);
+    return EXIT_FAILURE;
+  }
+
+  char **suite_paths = engine_names + n_engine_names + 1;
+  const size_t n_suites = (argv + argc) - suite_paths;
+
+  size_t n_engines = N_ENGINES;
+  const execution_engine_t **engines =
+      load_engines(&n_engines, all_engines, engine_names, n_engine_names, &ex_default);
+
+  if (engines == NULL) {
+    usage(argv);
+    return EXIT_FAILURE;
+  }
+
+  suite_t *suites = load_suites(suite_paths, n_suites);
+  assert(suites);
+
+  bench_result_t *results = malloc(sizeof(bench_result_t) * n_suites);
+  assert(results != NULL);
+
+  bench_result_t *total = malloc(sizeof(bench_result_t));
+  assert(total != NULL);
+
+  printf("%zu iteration(s) after %zu warmup iteration(s)\n",
+         options.n_iterations,
+         options.n_warmup_iterations);
+
+  for (size_t i = 0; i < n_engines; i++) {
+    const execution_engine_t *engine = engines[i];
+
+    // Allocations are counted whether or not the engine takes the allocator, so as to report
+    // allocations per match
+    allocator_t allocator;
+    reset_allocator(&allocator, engine->convention, 1);
+
+    void *self = (engine->create == NULL) ? NULL : engine->create(&allocator);
+
+    memset(total, 0, sizeof(bench_result_t));
+
+    for (size_t j = 0; j < n_suites; j++) {
+      bench_suite_with_engine(&results[j], engine, self, &suites[j], &allocator, &options);
+      print_result(engine->name, suite_paths[j], &results[j]);
+
+      if (results[j].pattern_latencies != NULL) {
+        print_pattern_latencies(
+            engine->name, suite_paths[j], &suites[j], results[j].pattern_latencies);
+
+        free(results[j].pattern_latencies);
+      }
+
+      total->n_patterns += results[j].n_patterns;
+      total->n_testcases += results[j].n_testcases;
+      total->n_bytes += results[j].n_bytes;
+      total->n_matches += results[j].n_matches;
+      total->compile_time += results[j].compile_time;
+      total->match_time += results[j].match_time;
+      total->best_match_time += results[j].best_match_time;
+      total->match_allocations.n_allocations += results[j].match_allocations.n_allocations;
+      total->match_allocations.total_size += results[j].match_allocations.total_size;
+      merge_histograms(&total->latencies, &results[j].latencies);
+    }
+
+    if (self != NULL) {
+      assert(engine->destroy != NULL);
+      engine->destroy(self, &allocator);
+    }
+
+    if (n_suites > 1) {
+      print_result(engine->name, "total", total);
+    }
+  }
+
+  free(total);
+  free(results);
+  destroy_engines(engines);
+  destroy_suites(suites, n_suites);
+
   return 0;
 }
+
+static void usage(char **argv) {
+  const char *fmt = "usage:\n"
+                    "  %s [<option>] [...] <engine> [...] -- <suite> [...]\n"
+                    "  %s [<option>] [...] -- <suite> [...]\n"
+                    "  %s [<option>] [...] all -- <suite> [...]\n"
+                    "options:\n"
+                    "  -n <iterations>  timed iterations per suite (default %d)\n"
+                    "  -w <iterations>  untimed warmup iterations per suite (default %d)\n"
+                    "  -p               also report match latencies per pattern\n"
+                    "available engines:\n";
+
+  fprintf(stderr,
+          fmt,
+          argv[0],
+          argv[0],
+          argv[0],
+          DEFAULT_N_ITERATIONS,
+          DEFAULT_N_WARMUP_ITERATIONS);
+
+  for (size_t i = 0; i < N_ENGINES; i++) {
+    fprintf(stderr, "  %s\n", all_engines[i]->name);
+  }
+}
+
+static void bench_suite_with_engine(bench_result_t *result,
+                                    const execution_engine_t *engine,
+                                    void *self,
+                                    suite_t *suite,
+                                    allocator_t *allocator,
+                                    const bench_options_t *options) {
+  memset(result, 0, sizeof(bench_result_t));
+
+  result->n_patterns = suite->n_patterns;
+  result->n_testcases = suite->n_testcases;
+
+  size_t max_groups = 0;
+
+  for (size_t i = 0; i < suite->n_patterns; i++) {
+    size_t size;
+    size_t n_capturing_groups;
+    suite_get_pattern(&size, &n_capturing_groups, suite, i);
+
+    if (n_capturing_groups > max_groups) {
+      max_groups = n_capturing_groups;
+    }
+  }
+
+  // Every engine agrees with the suite's expected matches (or etest would say otherwise), so the
+  // number of matches needn't be recovered from the engine's output
+  for (size_t i = 0; i < suite->n_testcases; i++) {
+    size_t pattern_index;
+    size_t size;
+    suite_get_testcase_str(&pattern_index, &size, suite, i);
+
+    result->n_bytes += size;
+    result->n_matches += suite_get_testcase_matches_pcre(suite, i)[0] != SIZE_MAX;
+  }
+
+  void **regexes = malloc(sizeof(void *) * suite->n_patterns);
+  assert(regexes != NULL || suite->n_patterns == 0);
+
+  // The regexes from the last compile iteration are kept for the match iterations
+  for (size_t i = 0; i < options->n_warmup_iterations + options->n_iterations; i++) {
+    if (i != 0) {
+      destroy_patterns(regexes, engine, self, suite, allocator);
+    }
+
+    const double time = compile_patterns(regexes, engine, self, suite, allocator);
+
+    if (i >= options->n_warmup_iterations) {
+      result->compile_time += time;
+    }
+  }
+
+  result->compile_time /= options->n_iterations;
+
+  // If engine->convention == CONVENTION_CREX, matches is an array of crex_match_t; otherwise, it's
+  // a pcre_match_data
+  void *matches;
+
+  if (engine->convention == CONVENTION_PCRE) {
+    matches = pcre2_match_data_create((max_groups == 0) ? 1 : max_groups, NULL);
+  } else {
+    matches = malloc(sizeof(crex_match_t) * ((max_groups == 0) ? 1 : max_groups));
+  }
+
+  assert(matches != NULL);
+
+  // The warmup iterations also give the engines a chance to do any deferred work (like crex's
+  // deferred native compilation) before the timed iterations
+  for (size_t i = 0; i < options->n_warmup_iterations; i++) {
+    run_testcases(engine, self, matches, regexes, suite, allocator);
+  }
+
+  const bm_alloc_stats_t stats_before = allocator->stats;
+
+  for (size_t i = 0; i < options->n_iterations; i++) {
+    const double time = run_testcases(engine, self, matches, regexes, suite, allocator);
+
+    result->match_time += time;
+
+    if (i == 0 || time < result->best_match_time) {
+      result->best_match_time = time;
+    }
+  }
+
+  result->match_time /= options->n_iterations;
+
+  result->match_allocations.n_allocations =
+      (allocator->stats.n_allocations - stats_before.n_allocations) / options->n_iterations;
+
+  result->match_allocations.total_size =
+      (allocator->stats.total_size - stats_before.total_size) / options->n_iterations;
+
+  // Latencies are recorded in iterations of their own, so that reading the clock around each
+  // testcase doesn't weigh on the throughput
+  if (options->per_pattern) {
+    result->pattern_latencies = calloc(suite->n_patterns, sizeof(latency_histogram_t));
+    assert(result->pattern_latencies != NULL || suite->n_patterns == 0);
+  }
+
+  for (size_t i = 0; i < options->n_iterations; i++) {
+    record_latencies(&result->latencies,
+                     result->pattern_latencies,
+                     engine,
+                     self,
+                     matches,
+                     regexes,
+                     suite,
+                     allocator);
+  }
+
+  if (engine->convention == CONVENTION_PCRE) {
+    pcre2_match_data_free(matches);
+  } else {
+    free(matches);
+  }
+
+  destroy_patterns(regexes, engine, self, suite, allocator);
+  free(regexes);
+}
+
+static double compile_patterns(void **regexes,
+                               const execution_engine_t *engine,
+                               void *self,
+                               suite_t *suite,
+                               allocator_t *allocator) {
+  bench_timer_t timer;
+  start_timer(&timer);
+
+  for (size_t i = 0; i < suite->n_patterns; i++) {
+    size_t size;
+    size_t n_capturing_groups;
+
+    const char *pattern = suite_get_pattern(&size, &n_capturing_groups, suite, i);
+
+    regexes[i] = engine->compile_regex(self, pattern, size, n_capturing_groups, allocator);
+  }
+
+  return stop_timer(&timer);
+}
+
+static void destroy_patterns(void **regexes,
+                             const execution_engine_t *engine,
+                             void *self,
+                             suite_t *suite,
+                             allocator_t *allocator) {
+  for (size_t i = 0; i < suite->n_patterns; i++) {
+    if (regexes[i] != NULL) {
+      engine->destroy_regex(self, regexes[i], allocator);
+    }
+  }
+}
+
+static double run_testcases(const execution_engine_t *engine,
+                            void *self,
+                            void *matches,
+                            void **regexes,
+                            suite_t *suite,
+                            allocator_t *allocator) {
+  bench_timer_t timer;
+  start_timer(&timer);
+
+  for (size_t i = 0; i < suite->n_testcases; i++) {
+    size_t pattern_index;
+    size_t size;
+
+    const char *str = suite_get_testcase_str(&pattern_index, &size, suite, i);
+
+    void *regex = regexes[pattern_index];
+
+    if (regex != NULL) {
+      engine->run(self, matches, regex, str, size, allocator);
+    }
+  }
+
+  return stop_timer(&timer);
+}
+
+static void record_latencies(latency_histogram_t *latencies,
+                             latency_histogram_t *pattern_latencies,
+                             const execution_engine_t *engine,
+                             void *self,
+                             void *matches,
+                             void **regexes,
+                             suite_t *suite,
+                             allocator_t *allocator) {
+  for (size_t i = 0; i < suite->n_testcases; i++) {
+    size_t pattern_index;
+    size_t size;
+
+    const char *str = suite_get_testcase_str(&pattern_index, &size, suite, i);
+
+    void *regex = regexes[pattern_index];
+
+    if (regex == NULL) {
+      continue;
+    }
+
+    bench_timer_t timer;
+    start_timer(&timer);
+
+    engine->run(self, matches, regex, str, size, allocator);
+
+    const uint64_t latency = (uint64_t)(1e9 * stop_timer(&timer) + 0.5);
+
+    record_latency(latencies, latency);
+
+    if (pattern_latencies != NULL) {
+      record_latency(&pattern_latencies[pattern_index], latency);
+    }
+  }
+}
+
+static void record_latency(latency_histogram_t *histogram, uint64_t value) {
+  size_t shift = 0;
+
+  while ((value >> shift) >= HISTOGRAM_SUB_BUCKETS) {
+    shift++;
+  }
+
+  // With a nonzero shift, value >> shift is in the upper half of the sub-buckets
+  size_t index = value;
+
+  if (shift != 0) {
+    index = HISTOGRAM_SUB_BUCKETS + (shift - 1) * (HISTOGRAM_SUB_BUCKETS / 2) +
+            ((value >> shift) - HISTOGRAM_SUB_BUCKETS / 2);
+  }
+
+  if (index >= HISTOGRAM_SIZE) {
+    index = HISTOGRAM_SIZE - 1;
+  }
+
+  histogram->counts[index]++;
+  histogram->n_values++;
+
+  if (value > histogram->max_value) {
+    histogram->max_value = value;
+  }
+}
+
+static void merge_histograms(latency_histogram_t *histogram, const latency_histogram_t *other) {
+  for (size_t i = 0; i < HISTOGRAM_SIZE; i++) {
+    histogram->counts[i] += other->counts[i];
+  }
+
+  histogram->n_values += other->n_values;
+
+  if (other->max_value > histogram->max_value) {
+    histogram->max_value = other->max_value;
+  }
+}
+
+// Yields the greatest value in the bucket containing the given percentile, which is never less
+// than the true value, but (except in the last bucket) exceeds it by less than 1/64
+static uint64_t histogram_percentile(const latency_histogram_t *histogram, double percentile) {
+  const double exact_rank = percentile / 100 * histogram->n_values;
+
+  uint64_t rank = (uint64_t)exact_rank;
+  rank += (rank < exact_rank || rank == 0);
+
+  uint64_t n_values = 0;
+
+  for (size_t i = 0; i < HISTOGRAM_SIZE; i++) {
+    n_values += histogram->counts[i];
+
+    if (n_values < rank) {
+      continue;
+    }
+
+    if (i < HISTOGRAM_SUB_BUCKETS) {
+      return i;
+    }
+
+    const size_t shift = (i - HISTOGRAM_SUB_BUCKETS) / (HISTOGRAM_SUB_BUCKETS / 2) + 1;
+    const uint64_t sub_bucket =
+        (i - HISTOGRAM_SUB_BUCKETS) % (HISTOGRAM_SUB_BUCKETS / 2) + HISTOGRAM_SUB_BUCKETS / 2;
+
+    const uint64_t value = ((sub_bucket + 1) << shift) - 1;
+
+    return (value < histogram->max_value) ? value : histogram->max_value;
+  }
+
+  return histogram->max_value;
+}
+
+static void
+print_result(const char *engine_name, const char *suite_name, const bench_result_t *result) {
+  const double megabytes = result->n_bytes / 1e6;
+
+  printf("%s: suite %s: compiled %zu pattern(s) in %0.4fs (%0.2fus/pattern)\n",
+         engine_name,
+         suite_name,
+         result->n_patterns,
+         result->compile_time,
+         (result->n_patterns == 0) ? 0.0 : 1e6 * result->compile_time / result->n_patterns);
+
+  printf("%s: suite %s: matched %zu test(s) (%0.2fMB, %zu match(es)) in %0.4fs: "
+         "%0.2fMB/s, %0.0f match(es)/s (best %0.2fMB/s), %0.2f allocation(s)/test\n",
+         engine_name,
+         suite_name,
+         result->n_testcases,
+         megabytes,
+         result->n_matches,
+         result->match_time,
+         megabytes / result->match_time,
+         result->n_matches / result->match_time,
+         megabytes / result->best_match_time,
+         (result->n_testcases == 0)
+             ? 0.0
+             : (double)result->match_allocations.n_allocations / result->n_testcases);
+
+  printf("%s: suite %s: match latency ", engine_name, suite_name);
+  print_latencies(&result->latencies);
+}
+
+static void print_pattern_latencies(const char *engine_name,
+                                    const char *suite_name,
+                                    const suite_t *suite,
+                                    const latency_histogram_t *pattern_latencies) {
+  // Patterns are shown escaped, and cut short if need be
+  const size_t max_shown = 40;
+
+  for (size_t i = 0; i < suite->n_patterns; i++) {
+    if (pattern_latencies[i].n_values == 0) {
+      continue;
+    }
+
+    size_t size;
+    size_t n_capturing_groups;
+    const char *pattern = suite_get_pattern(&size, &n_capturing_groups, suite, i);
+
+    printf("%s: suite %s: pattern %zu (", engine_name, suite_name, i);
+
+    for (size_t j = 0; j < size && j < max_shown; j++) {
+      const unsigned char c = pattern[j];
+
+      if (c >= 0x20 && c < 0x7f) {
+        putchar(c);
+      } else {
+        printf("\\x%02x", c);
+      }
+    }
+
+    printf("%s) latency ", (size > max_shown) ? "..." : "");
+    print_latencies(&pattern_latencies[i]);
+  }
+}
+
+static void print_latencies(const latency_histogram_t *histogram) {
+  printf("p50 %0.3fus, p90 %0.3fus, p99 %0.3fus, p99.9 %0.3fus, max %0.3fus\n",
+         histogram_percentile(histogram, 50) / 1e3,
+         histogram_percentile(histogram, 90) / 1e3,
+         histogram_percentile(histogram, 99) / 1e3,
+         histogram_percentile(histogram, 99.9) / 1e3,
+         histogram->max_value / 1e3);
+}
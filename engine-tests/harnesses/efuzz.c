@@ -0,0 +1,178 @@
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/crex.h"
+#include "../str-builder.h"
+
+// Differential tester: compiles random patterns twice, once to run on the VM only and once to run
+// on native code, and checks that the two agree on is_match for random strings. On x86-64, native
+// is_match (and a regex set's is_match) run on the DFA whenever the DFA can be built, so this
+// checks the DFA against the VM
+
+#define DEFAULT_N_PATTERNS 10000
+#define N_STRINGS_PER_PATTERN 32
+
+// Nesting any deeper turns up the occasional pattern on which native code (sans DFA) runs out of
+// memory, which is a separate problem from the one this checks for
+#define MAX_DEPTH 2
+
+#define MAX_STRING_SIZE 6
+#define STRING_CHARACTERS "abc"
+
+static void cat_random_regex(str_builder_t *sb, int depth);
+static void cat_random_term(str_builder_t *sb, int depth);
+
+static crex_regex_t *compile_with_threshold(const char *pattern, const char *threshold);
+
+static int check_pattern(const char *pattern, crex_context_t *context);
+
+static void usage(char **argv);
+
+int main(int argc, char **argv) {
+  if (argc > 3) {
+    usage(argv);
+    return EXIT_FAILURE;
+  }
+
+  const size_t n_patterns = (argc > 1) ? strtoul(argv[1], NULL, 10) : DEFAULT_N_PATTERNS;
+  const unsigned int seed = (argc > 2) ? strtoul(argv[2], NULL, 10) : 0;
+
+  if (n_patterns == 0) {
+    usage(argv);
+    return EXIT_FAILURE;
+  }
+
+  srand(seed);
+
+  crex_context_t *context = crex_create_context(NULL);
+  assert(context != NULL);
+
+  str_builder_t *sb = create_str_builder();
+
+  size_t n_failed = 0;
+
+  for (size_t i = 0; i < n_patterns; i++) {
+    sb_clear(sb);
+    cat_random_regex(sb, 0);
+
+    if (!check_pattern(sb2str(sb), context)) {
+      n_failed++;
+    }
+  }
+
+  destroy_str_builder(sb);
+  crex_destroy_context(context);
+
+  printf("%zu / %zu patterns consistent (seed %u)\n", n_patterns - n_failed, n_patterns, seed);
+
+  return (n_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void cat_random_regex(str_builder_t *sb, int depth) {
+  const int n_alternatives = (depth < MAX_DEPTH && rand() % 4 == 0) ? 2 + rand() % 2 : 1;
+
+  for (int i = 0; i < n_alternatives; i++) {
+    if (i > 0) {
+      sb_putchar(sb, '|');
+    }
+
+    const int n_terms = rand() % 4;
+
+    for (int j = 0; j < n_terms; j++) {
+      cat_random_term(sb, depth);
+    }
+  }
+}
+
+static void cat_random_term(str_builder_t *sb, int depth) {
+  static const char *const atoms[] = {"a", "b", "c", ".", "[ab]", "^", "$", "\\b", "\\B", "x"};
+
+  static const char *const quantifiers[] = {
+      "*", "+", "?", "*?", "+?", "??", "{0}", "{2}", "{0,2}", "{1,}", "{2,}", "{2,3}"};
+
+  const size_t n_atoms = sizeof(atoms) / sizeof(*atoms);
+  const size_t n_quantifiers = sizeof(quantifiers) / sizeof(*quantifiers);
+
+  if (depth < MAX_DEPTH && rand() % 3 == 0) {
+    sb_strcat(sb, (rand() % 2 == 0) ? "(" : "(?:");
+    cat_random_regex(sb, depth + 1);
+    sb_putchar(sb, ')');
+  } else {
+    sb_strcat(sb, atoms[rand() % n_atoms]);
+  }
+
+  if (rand() % 2 == 0) {
+    sb_strcat(sb, quantifiers[rand() % n_quantifiers]);
+  }
+}
+
+static crex_regex_t *compile_with_threshold(const char *pattern, const char *threshold) {
+  // The threshold is read when the regex is compiled
+  setenv("CREX_NATIVE_COMPILATION_THRESHOLD", threshold, 1);
+
+  crex_status_t status;
+  crex_regex_t *regex = crex_compile_str(&status, pattern);
+  assert(regex != NULL);
+
+  return regex;
+}
+
+static int check_pattern(const char *pattern, crex_context_t *context) {
+  crex_regex_t *vm_regex = compile_with_threshold(pattern, "18446744073709551615");
+  crex_regex_t *native_regex = compile_with_threshold(pattern, "0");
+
+  crex_regex_set_t *set = crex_compile_regex_set_str(NULL, &pattern, 1);
+  assert(set != NULL);
+
+  str_builder_t *sb = create_str_builder();
+
+  int ok = 1;
+
+  for (size_t i = 0; i < N_STRINGS_PER_PATTERN && ok; i++) {
+    sb_clear(sb);
+    sb_cat_random(sb, 0, MAX_STRING_SIZE, STRING_CHARACTERS);
+
+    const char *str = sb2str(sb);
+    const size_t size = sb_size(sb);
+
+    int vm_is_match, native_is_match;
+    unsigned char set_is_match;
+
+    crex_status_t status = crex_is_match(&vm_is_match, context, vm_regex, str, size);
+    assert(status == CREX_OK);
+
+    status = crex_is_match(&native_is_match, context, native_regex, str, size);
+    assert(status == CREX_OK);
+
+    status = crex_regex_set_is_match(&set_is_match, context, set, str, size);
+    assert(status == CREX_OK);
+
+    if (native_is_match != vm_is_match || set_is_match != vm_is_match) {
+      fprintf(stderr,
+              "Mismatch for /%s/ on \"%.*s\": VM %d, native %d, regex set %d\n",
+              pattern,
+              (int)size,
+              str,
+              vm_is_match,
+              native_is_match,
+              set_is_match);
+
+      ok = 0;
+    }
+  }
+
+  destroy_str_builder(sb);
+  crex_destroy_regex_set(set);
+  crex_destroy_regex(native_regex);
+  crex_destroy_regex(vm_regex);
+
+  return ok;
+}
+
+static void usage(char **argv) {
+  fprintf(stderr, "Usage: %s [n-patterns] [seed]\n", argv[0]);
+}
@@ -0,0 +1,180 @@
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/crex.h"
+#include "../harness.h"
+
+// Checks that iterating over all the matches of a regex in a string (with crex_find_all and
+// crex_next_match{,_groups}) takes time linear in the size of the string, on the VM and on native
+// code alike. Each pattern is iterated over a small string and a string SCALE times larger; the
+// latter must not take more than MAX_SLOWDOWN times as long. Most of the patterns match the empty
+// string, which is where a search that runs on past the match it's going to report costs the most
+
+#define SMALL_SIZE (16 * 1024)
+#define SCALE 8
+
+// Generous, so as not to trip over timing noise. A quadratic iteration is slower by about SCALE^2
+#define MAX_SLOWDOWN (4 * SCALE)
+
+// Below this, timings are mostly noise
+#define MIN_TIME 1e-3
+
+#define N_REPETITIONS 3
+
+#define STRING_CHARACTERS "ab  \n"
+
+static const char *const patterns[] = {
+    "x*", "", "\\b", "$", "a*?", "(?:a|b)*?", "[^\\n]*", "(a)|b", "a+", "(?:ab|b)*x?"};
+
+#define N_PATTERNS (sizeof(patterns) / sizeof(*patterns))
+
+static crex_regex_t *compile_with_threshold(const char *pattern, const char *threshold);
+
+static double time_iteration(crex_context_t *context,
+                             const crex_regex_t *regex,
+                             const char *str,
+                             size_t size,
+                             int groups,
+                             double budget);
+
+static int check_pattern(crex_context_t *context, const char *pattern, const char *str);
+
+int main(int argc, char **argv) {
+  if (argc != 1) {
+    fprintf(stderr, "Usage: %s\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const size_t size = SCALE * SMALL_SIZE;
+  char *str = malloc(size + 1);
+  assert(str != NULL);
+
+  srand(0);
+
+  for (size_t i = 0; i < size; i++) {
+    str[i] = STRING_CHARACTERS[rand() % strlen(STRING_CHARACTERS)];
+  }
+
+  str[size] = 0;
+
+  crex_context_t *context = crex_create_context(NULL);
+  assert(context != NULL);
+
+  size_t n_passed = 0;
+
+  for (size_t i = 0; i < N_PATTERNS; i++) {
+    n_passed += check_pattern(context, patterns[i], str);
+  }
+
+  crex_destroy_context(context);
+  free(str);
+
+  printf("%zu / %zu patterns iterate in linear time\n", n_passed, N_PATTERNS);
+
+  return (n_passed == N_PATTERNS) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static crex_regex_t *compile_with_threshold(const char *pattern, const char *threshold) {
+  // The threshold is read when the regex is compiled
+  setenv("CREX_NATIVE_COMPILATION_THRESHOLD", threshold, 1);
+
+  crex_status_t status;
+  crex_regex_t *regex = crex_compile_str(&status, pattern);
+  assert(regex != NULL);
+
+  return regex;
+}
+
+// Returns the time taken, or a negative number if the iteration was abandoned for exceeding the
+// budget
+static double time_iteration(crex_context_t *context,
+                             const crex_regex_t *regex,
+                             const char *str,
+                             size_t size,
+                             int groups,
+                             double budget) {
+  const size_t n_groups = crex_regex_n_capturing_groups(regex);
+
+  crex_match_t *matches = malloc(sizeof(crex_match_t) * n_groups);
+  assert(matches != NULL);
+
+  bench_timer_t timer;
+  start_timer(&timer);
+
+  double elapsed = 0;
+
+  crex_find_all(context, regex, str, size);
+
+  for (size_t i = 0;; i++) {
+    const crex_status_t status =
+        groups ? crex_next_match_groups(matches, context) : crex_next_match(matches, context);
+
+    assert(status == CREX_OK);
+
+    if (matches[0].begin == NULL) {
+      break;
+    }
+
+    if (i % 256 == 0 && stop_timer(&timer) > budget) {
+      elapsed = -1;
+      break;
+    }
+  }
+
+  if (elapsed == 0) {
+    elapsed = stop_timer(&timer);
+  }
+
+  free(matches);
+
+  return elapsed;
+}
+
+static int check_pattern(crex_context_t *context, const char *pattern, const char *str) {
+  static const char *const thresholds[] = {"18446744073709551615", "0"};
+  static const char *const engine_names[] = {"VM", "native"};
+
+  int ok = 1;
+
+  for (size_t i = 0; i < 2; i++) {
+    crex_regex_t *regex = compile_with_threshold(pattern, thresholds[i]);
+
+    for (int groups = 0; groups <= 1; groups++) {
+      double small_time = -1;
+
+      for (size_t j = 0; j < N_REPETITIONS; j++) {
+        const double time = time_iteration(context, regex, str, SMALL_SIZE, groups, 1e9);
+
+        if (small_time < 0 || time < small_time) {
+          small_time = time;
+        }
+      }
+
+      const double budget = MAX_SLOWDOWN * ((small_time < MIN_TIME) ? MIN_TIME : small_time);
+      const double large_time =
+          time_iteration(context, regex, str, SCALE * SMALL_SIZE, groups, budget);
+
+      if (large_time < 0 || large_time > budget) {
+        fprintf(stderr,
+                "/%s/ (%s, %s): %d KiB in %.4fs, but %d KiB in over %.4fs\n",
+                pattern,
+                engine_names[i],
+                groups ? "groups" : "find",
+                SMALL_SIZE / 1024,
+                small_time,
+                SCALE * SMALL_SIZE / 1024,
+                budget);
+
+        ok = 0;
+      }
+    }
+
+    crex_destroy_regex(regex);
+  }
+
+  return ok;
+}
@@ -16,11 +16,19 @@ extern const execution_engine_t ex_default;
 extern const execution_engine_t ex_alloc_hygiene;
 extern const execution_engine_t ex_pcre_default;
 extern const execution_engine_t ex_pcre_jit;
+extern const execution_engine_t ex_dump;
+extern const execution_engine_t ex_dump_native;
+extern const execution_engine_t ex_find_all;
+extern const execution_engine_t ex_stream;
+extern const execution_engine_t ex_regex_set;
+extern const execution_engine_t ex_database;
+extern const execution_engine_t ex_generated_c;
 
-#define N_ENGINES 4
+#define N_ENGINES 11
 
 static const execution_engine_t *all_engines[N_ENGINES] = {
-    &ex_default, &ex_alloc_hygiene, &ex_pcre_default, &ex_pcre_jit};
+    &ex_default, &ex_alloc_hygiene, &ex_pcre_default, &ex_pcre_jit, &ex_dump, &ex_dump_native,
+    &ex_find_all, &ex_stream, &ex_regex_set, &ex_database, &ex_generated_c};
 
 static size_t execute_suite_with_engine(const execution_engine_t *engine,
                                         void *self,
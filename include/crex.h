@@ -20,13 +20,27 @@ typedef enum {
   CREX_E_BAD_CHARACTER_CLASS,
   CREX_E_BAD_REPETITION,
   CREX_E_UNMATCHED_OPEN_PAREN,
-  CREX_E_UNMATCHED_CLOSE_PAREN
+  CREX_E_UNMATCHED_CLOSE_PAREN,
+  CREX_E_BAD_DUMP,
+  CREX_E_BAD_TEMPLATE
 } crex_status_t;
 
 typedef struct crex_regex crex_regex_t;
 
+typedef struct crex_regex_set crex_regex_set_t;
+
 typedef struct crex_context crex_context_t;
 
+typedef struct crex_template crex_template_t;
+
+typedef struct crex_cache crex_cache_t;
+
+typedef struct crex_context_pool crex_context_pool_t;
+
+typedef struct crex_database crex_database_t;
+
+// Used for all memory owned by a regex, context, etc., except for the bookkeeping of the
+// process-wide arena holding native code, which is shared between regexes and always uses malloc
 typedef struct {
   void *context;
   void *(*alloc)(void *, size_t);
@@ -38,6 +52,38 @@ typedef struct {
   const char *end;
 } crex_match_t;
 
+typedef struct {
+  size_t begin;
+  size_t end;
+} crex_span_t;
+
+typedef struct {
+  const char *str;
+  size_t size;
+} crex_input_t;
+
+typedef struct {
+  char *buffer;
+  size_t size;
+  size_t capacity;
+} crex_output_t;
+
+typedef struct {
+  size_t n_acquisitions;
+  size_t n_thread_hits;
+  size_t n_shared_hits;
+  size_t n_creations;
+  size_t n_trims;
+  size_t n_discards;
+  size_t n_shared;
+} crex_context_pool_stats_t;
+
+typedef int (*crex_split_callback_t)(void *, const crex_match_t *);
+
+typedef int (*crex_line_callback_t)(void *, const crex_match_t *);
+
+typedef enum { CREX_STREAM_IS_MATCH, CREX_STREAM_FIND, CREX_STREAM_GROUPS } crex_stream_mode_t;
+
 CREX_WARN_UNUSED_RESULT crex_regex_t *
 crex_compile(crex_status_t *status, const char *pattern, size_t size);
 
@@ -51,6 +97,24 @@ CREX_WARN_UNUSED_RESULT crex_context_t *crex_create_context(crex_status_t *statu
 CREX_WARN_UNUSED_RESULT crex_context_t *
 crex_create_context_with_allocator(crex_status_t *status, const crex_allocator_t *allocator);
 
+CREX_WARN_UNUSED_RESULT crex_context_pool_t *
+crex_create_context_pool(crex_status_t *status, size_t max_shared, size_t max_buffer_size);
+
+CREX_WARN_UNUSED_RESULT crex_context_pool_t *
+crex_create_context_pool_with_allocator(crex_status_t *status,
+                                        size_t max_shared,
+                                        size_t max_buffer_size,
+                                        const crex_allocator_t *allocator);
+
+void crex_destroy_context_pool(crex_context_pool_t *pool);
+
+CREX_WARN_UNUSED_RESULT crex_context_t *crex_acquire_context(crex_status_t *status,
+                                                             crex_context_pool_t *pool);
+
+void crex_release_context(crex_context_pool_t *pool, crex_context_t *context);
+
+void crex_context_pool_stats(crex_context_pool_stats_t *stats, crex_context_pool_t *pool);
+
 CREX_WARN_UNUSED_RESULT size_t crex_regex_n_capturing_groups(const crex_regex_t *regex);
 
 void crex_destroy_regex(crex_regex_t *regex);
@@ -90,6 +154,197 @@ CREX_WARN_UNUSED_RESULT crex_status_t crex_match_groups_str(crex_match_t *matche
                                                             const crex_regex_t *regex,
                                                             const char *str);
 
+CREX_WARN_UNUSED_RESULT crex_status_t crex_is_match_batch(int *is_match,
+                                                          crex_context_t *context,
+                                                          const crex_regex_t *regex,
+                                                          const crex_input_t *inputs,
+                                                          size_t n_inputs);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_find_batch(crex_match_t *matches,
+                                                      crex_context_t *context,
+                                                      const crex_regex_t *regex,
+                                                      const crex_input_t *inputs,
+                                                      size_t n_inputs);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_is_match_parallel(int *is_match,
+                                                             crex_context_t *context,
+                                                             const crex_regex_t *regex,
+                                                             const char *str,
+                                                             size_t size,
+                                                             size_t n_threads);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_find_parallel(crex_match_t *match,
+                                                         crex_context_t *context,
+                                                         const crex_regex_t *regex,
+                                                         const char *str,
+                                                         size_t size,
+                                                         size_t n_threads);
+
+void crex_find_all(crex_context_t *context,
+                   const crex_regex_t *regex,
+                   const char *str,
+                   size_t size);
+
+void crex_find_all_str(crex_context_t *context, const crex_regex_t *regex, const char *str);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_next_match(crex_match_t *match,
+                                                      crex_context_t *context);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_next_match_groups(crex_match_t *matches,
+                                                             crex_context_t *context);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_split(crex_match_t *fields,
+                                                 size_t *n_fields,
+                                                 size_t max_fields,
+                                                 crex_context_t *context,
+                                                 const crex_regex_t *regex,
+                                                 const char *str,
+                                                 size_t size);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_split_str(crex_match_t *fields,
+                                                     size_t *n_fields,
+                                                     size_t max_fields,
+                                                     crex_context_t *context,
+                                                     const crex_regex_t *regex,
+                                                     const char *str);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_split_each(crex_context_t *context,
+                                                      const crex_regex_t *regex,
+                                                      const char *str,
+                                                      size_t size,
+                                                      crex_split_callback_t callback,
+                                                      void *callback_context);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_split_each_str(crex_context_t *context,
+                                                          const crex_regex_t *regex,
+                                                          const char *str,
+                                                          crex_split_callback_t callback,
+                                                          void *callback_context);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_match_lines(crex_context_t *context,
+                                                       const crex_regex_t *regex,
+                                                       const char *str,
+                                                       size_t size,
+                                                       crex_line_callback_t callback,
+                                                       void *callback_context);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_match_lines_str(crex_context_t *context,
+                                                           const crex_regex_t *regex,
+                                                           const char *str,
+                                                           crex_line_callback_t callback,
+                                                           void *callback_context);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_stream_begin(crex_context_t *context,
+                                                        const crex_regex_t *regex,
+                                                        crex_stream_mode_t mode);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_stream_feed(crex_context_t *context,
+                                                       const char *chunk,
+                                                       size_t size);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_stream_end(int *is_match,
+                                                      crex_span_t *spans,
+                                                      crex_context_t *context);
+
+CREX_WARN_UNUSED_RESULT crex_regex_set_t *crex_compile_regex_set(crex_status_t *status,
+                                                                  const char *const *patterns,
+                                                                  const size_t *sizes,
+                                                                  size_t n_patterns);
+
+CREX_WARN_UNUSED_RESULT crex_regex_set_t *
+crex_compile_regex_set_str(crex_status_t *status, const char *const *patterns, size_t n_patterns);
+
+CREX_WARN_UNUSED_RESULT crex_regex_set_t *
+crex_compile_regex_set_with_allocator(crex_status_t *status,
+                                      const char *const *patterns,
+                                      const size_t *sizes,
+                                      size_t n_patterns,
+                                      const crex_allocator_t *allocator);
+
+CREX_WARN_UNUSED_RESULT size_t crex_regex_set_n_patterns(const crex_regex_set_t *set);
+
+void crex_destroy_regex_set(crex_regex_set_t *set);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_regex_set_is_match(unsigned char *is_match,
+                                                              crex_context_t *context,
+                                                              const crex_regex_set_t *set,
+                                                              const char *str,
+                                                              size_t size);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_regex_set_is_match_str(unsigned char *is_match,
+                                                                  crex_context_t *context,
+                                                                  const crex_regex_set_t *set,
+                                                                  const char *str);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_regex_set_match_indices(size_t *indices,
+                                                                   size_t *n_matches,
+                                                                   crex_context_t *context,
+                                                                   const crex_regex_set_t *set,
+                                                                   const char *str,
+                                                                   size_t size);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_regex_set_match_indices_str(size_t *indices,
+                                                                       size_t *n_matches,
+                                                                       crex_context_t *context,
+                                                                       const crex_regex_set_t *set,
+                                                                       const char *str);
+
+CREX_WARN_UNUSED_RESULT crex_cache_t *crex_create_cache(crex_status_t *status, size_t capacity);
+
+CREX_WARN_UNUSED_RESULT crex_cache_t *crex_create_cache_with_allocator(
+    crex_status_t *status, size_t capacity, const crex_allocator_t *allocator);
+
+void crex_destroy_cache(crex_cache_t *cache);
+
+CREX_WARN_UNUSED_RESULT const crex_regex_t *
+crex_cache_get(crex_status_t *status, crex_cache_t *cache, const char *pattern, size_t size);
+
+CREX_WARN_UNUSED_RESULT const crex_regex_t *
+crex_cache_get_str(crex_status_t *status, crex_cache_t *cache, const char *pattern);
+
+void crex_cache_release(crex_cache_t *cache, const crex_regex_t *regex);
+
+CREX_WARN_UNUSED_RESULT crex_template_t *
+crex_compile_template(crex_status_t *status, const char *tmpl, size_t size);
+
+CREX_WARN_UNUSED_RESULT crex_template_t *crex_compile_template_str(crex_status_t *status,
+                                                                    const char *tmpl);
+
+CREX_WARN_UNUSED_RESULT crex_template_t *crex_compile_template_with_allocator(
+    crex_status_t *status, const char *tmpl, size_t size, const crex_allocator_t *allocator);
+
+void crex_destroy_template(crex_template_t *tmpl);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_replace(crex_output_t *output,
+                                                   crex_context_t *context,
+                                                   const crex_regex_t *regex,
+                                                   const crex_template_t *tmpl,
+                                                   const char *str,
+                                                   size_t size);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_replace_str(crex_output_t *output,
+                                                       crex_context_t *context,
+                                                       const crex_regex_t *regex,
+                                                       const crex_template_t *tmpl,
+                                                       const char *str);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_replace_all(crex_output_t *output,
+                                                       crex_context_t *context,
+                                                       const crex_regex_t *regex,
+                                                       const crex_template_t *tmpl,
+                                                       const char *str,
+                                                       size_t size);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_replace_all_str(crex_output_t *output,
+                                                           crex_context_t *context,
+                                                           const crex_regex_t *regex,
+                                                           const crex_template_t *tmpl,
+                                                           const char *str);
+
+CREX_WARN_UNUSED_RESULT crex_status_t crex_generate_c(crex_output_t *output,
+                                                      const crex_regex_t *regex,
+                                                      const char *name);
+
 CREX_WARN_UNUSED_RESULT unsigned char *
 crex_dump_regex(crex_status_t *status, size_t *size, const crex_regex_t *regex);
 
@@ -99,12 +354,49 @@ crex_dump_regex_with_allocator(crex_status_t *status,
                                const crex_regex_t *regex,
                                const crex_allocator_t *allocator);
 
+CREX_WARN_UNUSED_RESULT unsigned char *
+crex_dump_regex_with_native_code(crex_status_t *status,
+                                 size_t *size,
+                                 const crex_regex_t *regex,
+                                 const crex_allocator_t *allocator);
+
 CREX_WARN_UNUSED_RESULT crex_regex_t *
 crex_load_regex(crex_status_t *status, unsigned char *buffer, size_t size);
 
 CREX_WARN_UNUSED_RESULT crex_regex_t *crex_load_regex_with_allocator(
     crex_status_t *status, unsigned char *buffer, size_t size, const crex_allocator_t *allocator);
 
+CREX_WARN_UNUSED_RESULT crex_regex_t *
+crex_load_trusted_regex_with_native_code(crex_status_t *status,
+                                         unsigned char *buffer,
+                                         size_t size,
+                                         const crex_allocator_t *allocator);
+
+CREX_WARN_UNUSED_RESULT unsigned char *crex_dump_database(crex_status_t *status,
+                                                          size_t *size,
+                                                          const crex_regex_t *const *regexes,
+                                                          size_t n_regexes);
+
+CREX_WARN_UNUSED_RESULT unsigned char *
+crex_dump_database_with_allocator(crex_status_t *status,
+                                  size_t *size,
+                                  const crex_regex_t *const *regexes,
+                                  size_t n_regexes,
+                                  const crex_allocator_t *allocator);
+
+CREX_WARN_UNUSED_RESULT crex_database_t *
+crex_open_database(crex_status_t *status, const void *buffer, size_t size);
+
+CREX_WARN_UNUSED_RESULT crex_database_t *crex_open_database_with_allocator(
+    crex_status_t *status, const void *buffer, size_t size, const crex_allocator_t *allocator);
+
+void crex_close_database(crex_database_t *database);
+
+size_t crex_database_n_regexes(const crex_database_t *database);
+
+CREX_WARN_UNUSED_RESULT const crex_regex_t *
+crex_database_regex(crex_status_t *status, crex_database_t *database, size_t index);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,11 +8,12 @@
 #define MAP_ANONYMOUS MAP_ANON
 #endif
 
+#include "code-arena.c"
 #include "x64-encoding.c"
 
 typedef size_t label_t;
 
-typedef enum { LU_CALL, LU_DEFINITION, LU_JCC, LU_JMP, LU_LEA } label_use_type_t;
+typedef enum { LU_CALL, LU_DEFINITION, LU_JCC, LU_JMP, LU_LEA, LU_OFFSET } label_use_type_t;
 
 typedef enum {
   JCC_JO,
@@ -71,6 +72,9 @@ typedef struct {
 
   size_t n_labels;
 
+  // Final offsets of the labels, once resolved by finalize_assembler
+  size_t *label_values;
+
   struct {
     size_t size;
     size_t capacity;
@@ -92,6 +96,7 @@ static void create_assembler(assembler_t *as) {
   as->code = NULL;
 
   as->n_labels = 0;
+  as->label_values = NULL;
 
   as->label_uses.size = 0;
   as->label_uses.capacity = 0;
@@ -102,37 +107,23 @@ static void create_assembler(assembler_t *as) {
 }
 
 static void destroy_assembler(assembler_t *as, const allocator_t *allocator) {
+  FREE(allocator, as->label_values);
   FREE(allocator, as->label_uses.uses);
   munmap(as->code, as->capacity);
 }
 
-WUR static unsigned char *
-finalize_assembler(size_t *size, assembler_t *as, const allocator_t *allocator) {
-
+// Resolve all label uses. The finished code remains in the assembler's buffer, and label_offset may
+// be used, until the assembler is destroyed
+WUR static int finalize_assembler(assembler_t *as, const allocator_t *allocator) {
   assert(as->size <= as->capacity);
-  assert(as->capacity % as->page_size == 0);
-
-  if (!resolve_assembler_labels(as, allocator)) {
-    FREE(allocator, as->label_uses.uses);
-    return NULL;
-  }
-
-  FREE(allocator, as->label_uses.uses);
-
-  const size_t unused_pages = (as->capacity - as->size) / as->page_size;
-
-  if (unused_pages > 0) {
-    const size_t unused_size = as->page_size * unused_pages;
-    munmap(as->code + as->capacity - unused_size, unused_size);
-  }
-
-  if (mprotect(as->code, as->size, PROT_READ | PROT_EXEC)) {
-    munmap(as->code, as->size);
-    return NULL;
-  }
+  return resolve_assembler_labels(as, allocator);
+}
 
-  *size = as->size;
-  return as->code;
+// Offset of a defined label in the finalized code
+static size_t label_offset(const assembler_t *as, label_t label) {
+  assert(as->label_values != NULL && label < as->n_labels);
+  assert(as->label_values[label] != SIZE_MAX);
+  return as->label_values[label];
 }
 
 WUR static int grow_assembler(assembler_t *as) {
@@ -163,7 +154,7 @@ WUR static int grow_assembler(assembler_t *as) {
   munmap(next, capacity - as->capacity);
   unsigned char *code = mmap(NULL, capacity, prot, flags, -1, 0);
 
-  if (next == MAP_FAILED) {
+  if (code == MAP_FAILED) {
     return 0;
   }
 
@@ -193,6 +184,23 @@ static void resize_assembler(assembler_t *as, unsigned char *end) {
   as->size = end - as->code;
 }
 
+// Copy raw data (e.g. constant tables for vector code) into the instruction stream
+WUR static int
+emit_assembler_data(assembler_t *as, const void *data, size_t size, const allocator_t *allocator) {
+  (void)allocator;
+
+  unsigned char *code = reserve_assembler_space(as, size);
+
+  if (code == NULL) {
+    return 0;
+  }
+
+  memcpy(code, data, size);
+  resize_assembler(as, code + size);
+
+  return 1;
+}
+
 #include "../build/x64.h"
 
 WUR static label_t create_label(assembler_t *as) {
@@ -320,6 +328,28 @@ jcc_label(assembler_t *as, jcc_type_t jcc_type, label_t label, const allocator_t
   return 1;
 }
 
+// Emit a signed 32-bit displacement from the emitted data itself to the label (e.g. an entry in a
+// jump table)
+WUR static int emit_label_offset(assembler_t *as, label_t label, const allocator_t *allocator) {
+  if (reserve_assembler_space(as, 4) == NULL) {
+    return 0;
+  }
+
+  label_use_t *use = push_label_use(as, allocator);
+
+  if (use == NULL) {
+    return 0;
+  }
+
+  use->type = LU_OFFSET;
+  use->offset = as->size;
+  use->label = label;
+
+  as->size += 4;
+
+  return 1;
+}
+
 WUR static int resolve_assembler_labels(assembler_t *as, const allocator_t *allocator) {
   size_t *label_values = ALLOC(allocator, sizeof(size_t) * as->n_labels);
 
@@ -410,9 +440,10 @@ WUR static int resolve_assembler_labels(assembler_t *as, const allocator_t *allo
 
       case LU_LEA:
       case LU_CALL:
+      case LU_OFFSET:
         // lea reg [rip + disp] is exactly 7 bytes irrespective of the magnitude of disp;
-        // call foo is exactly 5 bytes when encoded as a rip-relative call. Neither is subject to
-        // optimization
+        // call foo is exactly 5 bytes when encoded as a rip-relative call; offsets are always 4
+        // bytes. None is subject to optimization
         break;
 
       default:
@@ -530,6 +561,19 @@ WUR static int resolve_assembler_labels(assembler_t *as, const allocator_t *allo
       break;
     }
 
+    case LU_OFFSET: {
+      assert(DISPLACEMENT_IS_REPRESENTABLE(code, target));
+
+      const long displacement = target - code;
+
+      copy_displacement(code, displacement, 4);
+      code += 4;
+
+      reserved_size = 4;
+
+      break;
+    }
+
     default:
       assert(0);
     }
@@ -545,7 +589,7 @@ WUR static int resolve_assembler_labels(assembler_t *as, const allocator_t *allo
     code += end - begin;
   }
 
-  FREE(allocator, label_values);
+  as->label_values = label_values;
 
   // Truncate the assembler to the correct size
   resize_assembler(as, code);
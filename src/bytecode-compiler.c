@@ -11,6 +11,13 @@ WUR static int compile_parsetree(bytecode_t *bytecode,
                                  parsetree_t *tree,
                                  const allocator_t *allocator);
 
+WUR static int compile_set_pattern(bytecode_t *bytecode,
+                                   size_t *n_flags,
+                                   parsetree_t *tree,
+                                   size_t index,
+                                   int is_last,
+                                   const allocator_t *allocator);
+
 WUR static unsigned char *
 emit_bytecode(unsigned char *code, unsigned char opcode, size_t operand, size_t operand_size);
 
@@ -39,6 +46,63 @@ WUR static unsigned char *compile_to_bytecode(size_t *size,
   return code;
 }
 
+// The program for a regex set tries each of its patterns in turn, and marks a pattern as having
+// matched with a VM_ACCEPT rather than by reaching the end of the program:
+//
+//   VM_SPLIT_PASSIVE next
+//   <pattern 0>
+//   VM_ACCEPT 0
+// next:
+//   VM_SPLIT_PASSIVE next
+//   <pattern 1>
+//   VM_ACCEPT 1
+// next:
+//   ...
+//   <pattern n - 1>
+//   VM_ACCEPT n - 1
+//
+// Each call appends the code for one pattern. The patterns share the counter of flags (and the
+// character classes), so that their flags don't collide
+static int compile_set_pattern(bytecode_t *bytecode,
+                               size_t *n_flags,
+                               parsetree_t *tree,
+                               size_t index,
+                               int is_last,
+                               const allocator_t *allocator) {
+  bytecode_t child;
+  create_bytecode(&child);
+
+  if (!compile_parsetree(&child, n_flags, tree, allocator)) {
+    destroy_bytecode(&child, allocator);
+    return 0;
+  }
+
+  const size_t index_size = size_for_operand(index);
+
+  const size_t split_delta = child.size + 1 + index_size;
+  const size_t split_delta_size = size_for_operand(split_delta);
+
+  unsigned char *code = bytecode_reserve(bytecode, (1 + 4) + child.size + (1 + 4), allocator);
+
+  if (code == NULL) {
+    destroy_bytecode(&child, allocator);
+    return 0;
+  }
+
+  if (!is_last) {
+    code = emit_bytecode(code, VM_SPLIT_PASSIVE, split_delta, split_delta_size);
+  }
+
+  code = emit_bytecode_copy(code, &child);
+  code = emit_bytecode(code, VM_ACCEPT, index, index_size);
+
+  destroy_bytecode(&child, allocator);
+
+  bytecode_extend(bytecode, code);
+
+  return 1;
+}
+
 WUR static int compile_parsetree(bytecode_t *bytecode,
                                  size_t *n_flags,
                                  parsetree_t *tree,
@@ -0,0 +1,721 @@
+// Generation of standalone C source for a regex, for targets without a native compiler (or which
+// can't map executable memory). The generated code is a Pike VM specialized to the regex: each
+// instruction becomes a case of a switch, with its operand folded in, and each character class
+// becomes a few range comparisons (or, for a class with many ranges, a lookup in a constant table).
+// It needs nothing but the C standard library, and doesn't allocate.
+//
+// Like the VM, the generated code runs the threads in priority order at each position, but where
+// the VM relies on the flags alone to keep the number of threads down, the generated code also
+// drops a thread that reaches an instruction already reached at the same position by a thread of
+// higher priority (whose future is the same, but preferred). So there's at most one thread per
+// instruction, and the thread lists can be sized at generation time
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// The number of ranges beyond which a class is tested with a table lookup
+#define GENERATED_MAX_RANGES 4
+
+// Marks a stack entry which is a pointer to restore, rather than a state to visit
+#define GENERATED_RESTORE "((size_t)-1)"
+
+WUR static int
+output_format(output_t *output, const allocator_t *allocator, const char *format, ...) {
+  va_list args;
+
+  va_start(args, format);
+  const int length = vsnprintf(NULL, 0, format, args);
+  va_end(args);
+
+  if (length < 0) {
+    return 0;
+  }
+
+  char *buffer = ALLOC(allocator, length + 1);
+
+  if (buffer == NULL) {
+    return 0;
+  }
+
+  va_start(args, format);
+  vsnprintf(buffer, length + 1, format, args);
+  va_end(args);
+
+  const int success = output_append(output, buffer, length, allocator);
+
+  FREE(allocator, buffer);
+
+  return success;
+}
+
+// Yields the number of maximal ranges of characters in the class, storing up to max_ranges of them
+static size_t
+char_class_ranges(unsigned char (*ranges)[2], size_t max_ranges, const unsigned char *char_class) {
+  size_t n_ranges = 0;
+
+  for (size_t c = 0; c <= 255; c++) {
+    if (!bitmap_test(char_class, c) || (c != 0 && bitmap_test(char_class, c - 1))) {
+      continue;
+    }
+
+    size_t end = c;
+
+    while (end != 255 && bitmap_test(char_class, end + 1)) {
+      end++;
+    }
+
+    if (n_ranges < max_ranges) {
+      ranges[n_ranges][0] = c;
+      ranges[n_ranges][1] = end;
+    }
+
+    n_ranges++;
+  }
+
+  return n_ranges;
+}
+
+// Emits a C expression that's nonzero iff the given variable (an int, which is -1 beyond either end
+// of the input) is in the class. table is the index of the class's lookup table, if it needs one
+WUR static int emit_char_class_test(output_t *output,
+                                    const unsigned char *char_class,
+                                    const char *variable,
+                                    const char *name,
+                                    size_t table,
+                                    const allocator_t *allocator) {
+  unsigned char ranges[GENERATED_MAX_RANGES][2];
+  const size_t n_ranges = char_class_ranges(ranges, GENERATED_MAX_RANGES, char_class);
+
+  if (n_ranges > GENERATED_MAX_RANGES) {
+    return output_format(output,
+                         allocator,
+                         "(%s >= 0 && (%s_tables[%zu][%s >> 3] >> (%s & 7)) & 1)",
+                         variable,
+                         name,
+                         table,
+                         variable,
+                         variable);
+  }
+
+  if (n_ranges == 0) {
+    return output_format(output, allocator, "0");
+  }
+
+  for (size_t i = 0; i < n_ranges; i++) {
+    const unsigned int begin = ranges[i][0];
+    const unsigned int end = ranges[i][1];
+
+    int success = output_format(output, allocator, (i == 0) ? "(" : " || ");
+
+    // Casting to unsigned int means that -1 is never in range
+    if (begin == end) {
+      success = success && output_format(output, allocator, "%s == %u", variable, begin);
+    } else {
+      success = success && output_format(output,
+                                         allocator,
+                                         "(unsigned int)(%s - %u) <= %u",
+                                         variable,
+                                         begin,
+                                         end - begin);
+    }
+
+    if (!success) {
+      return 0;
+    }
+  }
+
+  return output_format(output, allocator, ")");
+}
+
+// The class tested by a consuming instruction, or NULL for VM_CHARACTER
+static const unsigned char *
+instruction_char_class(const regex_t *regex, unsigned char opcode, size_t operand) {
+  switch (opcode) {
+  case VM_CHAR_CLASS:
+    return regex->classes[operand];
+
+  case VM_BUILTIN_CHAR_CLASS:
+    return builtin_classes[operand];
+
+  default:
+    return NULL;
+  }
+}
+
+WUR static status_t generate_c(output_t *output, const regex_t *regex, const char *name) {
+  const allocator_t *allocator = &regex->allocator;
+
+  const unsigned char *code = regex->bytecode.code;
+  const size_t size = regex->bytecode.size;
+
+  // The state of each instruction is its index, and the end of the program is the last state
+  size_t *states = ALLOC(allocator, sizeof(size_t) * (size + 1));
+
+  // The lookup table of each class (the regex's, then the builtin classes, then the class of first
+  // characters) which needs one, or SIZE_MAX
+  const size_t n_class_slots = regex->n_classes + N_BUILTIN_CLASSES + 1;
+  size_t *tables = ALLOC(allocator, sizeof(size_t) * n_class_slots);
+
+  if (states == NULL || tables == NULL) {
+    FREE(allocator, states);
+    FREE(allocator, tables);
+    return CREX_E_NOMEM;
+  }
+
+  size_t n_states = 0;
+  size_t n_consumers = 0;
+  size_t n_tables = 0;
+
+  int uses_character = 0;
+  int uses_prev_character = 0;
+
+  for (size_t i = 0; i < n_class_slots; i++) {
+    tables[i] = SIZE_MAX;
+  }
+
+  char_class_t first_class;
+  const int has_first_class = first_char_class(first_class, regex, allocator);
+
+  for (size_t index = 0; index < size;) {
+    states[index] = n_states++;
+
+    const unsigned char byte = code[index++];
+
+    const unsigned char opcode = VM_OPCODE(byte);
+    const size_t operand_size = VM_OPERAND_SIZE(byte);
+
+    const size_t operand = deserialize_operand(code + index, operand_size);
+    index += operand_size;
+
+    switch (opcode) {
+    case VM_CHARACTER:
+    case VM_CHAR_CLASS:
+    case VM_BUILTIN_CHAR_CLASS: {
+      n_consumers++;
+      uses_character = 1;
+
+      const unsigned char *char_class = instruction_char_class(regex, opcode, operand);
+      const size_t table = operand + ((opcode == VM_CHAR_CLASS) ? 0 : regex->n_classes);
+
+      if (char_class != NULL && tables[table] == SIZE_MAX &&
+          char_class_ranges(NULL, 0, char_class) > GENERATED_MAX_RANGES) {
+        tables[table] = n_tables++;
+      }
+
+      break;
+    }
+
+    case VM_ANCHOR_BOF:
+    case VM_ANCHOR_BOL:
+      uses_prev_character = 1;
+      break;
+
+    case VM_ANCHOR_EOF:
+    case VM_ANCHOR_EOL:
+      uses_character = 1;
+      break;
+
+    case VM_ANCHOR_WORD_BOUNDARY:
+    case VM_ANCHOR_NOT_WORD_BOUNDARY: {
+      uses_character = 1;
+      uses_prev_character = 1;
+
+      const size_t table = regex->n_classes + BCC_WORD;
+
+      if (tables[table] == SIZE_MAX &&
+          char_class_ranges(NULL, 0, builtin_classes[BCC_WORD]) > GENERATED_MAX_RANGES) {
+        tables[table] = n_tables++;
+      }
+
+      break;
+    }
+
+    default:
+      break;
+    }
+  }
+
+  states[size] = n_states++;
+
+  if (has_first_class && char_class_ranges(NULL, 0, first_class) > GENERATED_MAX_RANGES) {
+    tables[n_class_slots - 1] = n_tables++;
+  }
+
+  int first_character = -1;
+
+  for (size_t c = 0; has_first_class && c <= 255; c++) {
+    if (bitmap_test(first_class, c)) {
+      first_character = (first_character == -1) ? (int)c : -2;
+    }
+  }
+
+  const size_t n_pointers = 2 * regex->n_capturing_groups;
+
+  int success = output_format(
+      output,
+      allocator,
+      "// Generated by crex. %s_is_match, %s_find and %s_match_groups behave as\n"
+      "// crex_is_match, crex_find and crex_match_groups do for the regex from which this was\n"
+      "// generated, with a pair of pointers in place of each crex_match_t (both NULL for a group\n"
+      "// that didn't participate)\n"
+      "\n"
+      "#include <stddef.h>\n"
+      "#include <string.h>\n"
+      "\n"
+      "#define %s_N_CAPTURING_GROUPS %zu\n"
+      "\n",
+      name,
+      name,
+      name,
+      name,
+      regex->n_capturing_groups);
+
+  // The lookup tables
+  if (success && n_tables != 0) {
+    success = output_format(
+        output, allocator, "static const unsigned char %s_tables[%zu][32] = {\n", name, n_tables);
+
+    for (size_t i = 0; success && i < n_class_slots; i++) {
+      if (tables[i] == SIZE_MAX) {
+        continue;
+      }
+
+      const unsigned char *char_class;
+
+      if (i < regex->n_classes) {
+        char_class = regex->classes[i];
+      } else if (i < n_class_slots - 1) {
+        char_class = builtin_classes[i - regex->n_classes];
+      } else {
+        char_class = first_class;
+      }
+
+      // Bit k of byte j is set iff the class contains 8 * j + k
+      for (size_t j = 0; success && j < 32; j++) {
+        unsigned int byte = 0;
+
+        for (size_t k = 0; k < 8; k++) {
+          byte |= (unsigned int)bitmap_test(char_class, 8 * j + k) << k;
+        }
+
+        if (j == 0) {
+          success = output_format(output, allocator, "    [%zu] = {", tables[i]);
+        } else {
+          success = output_format(output, allocator, (j % 8 == 0) ? ",\n           " : ", ");
+        }
+
+        success = success && output_format(output, allocator, "0x%02x", byte);
+      }
+
+      success = success && output_format(output, allocator, "},\n");
+    }
+
+    success = success && output_format(output, allocator, "};\n\n");
+  }
+
+  // The body, up to the dispatch
+  success = success &&
+            output_format(output,
+                          allocator,
+                          "static int %s_run(const char **pointers, size_t n_pointers, const char "
+                          "*str, size_t size) {\n"
+                          "  const char *working[%zu];\n"
+                          "\n"
+                          "  // The threads at the current and next positions, each waiting at a "
+                          "consuming instruction\n"
+                          "  struct {\n"
+                          "    size_t state;\n"
+                          "    const char *pointers[%zu];\n"
+                          "  } threads[2][%zu];\n"
+                          "\n"
+                          "  size_t n_current = 0;\n"
+                          "\n"
+                          "  // States yet to be visited, interleaved with pointers to be restored "
+                          "on backtracking\n"
+                          "  struct {\n"
+                          "    size_t state;\n"
+                          "    size_t slot;\n"
+                          "    const char *value;\n"
+                          "  } stack[%zu];\n"
+                          "\n"
+                          "  // One more than the position at which each state was last visited\n"
+                          "  size_t visited[%zu];\n"
+                          "  memset(visited, 0, sizeof(visited));\n"
+                          "\n"
+                          "  int is_match = 0;\n"
+                          "\n"
+                          "  for (size_t i = 0; i <= size; i++) {\n",
+                          name,
+                          n_pointers,
+                          n_pointers,
+                          (n_consumers == 0) ? 1 : n_consumers,
+                          n_states,
+                          n_states);
+
+  // With no threads left, skip ahead to the next position at which a match could begin
+  if (success && has_first_class) {
+    success = output_format(output, allocator, "    if (n_current == 0) {\n");
+
+    if (first_character >= 0) {
+      success = success &&
+                output_format(output,
+                              allocator,
+                              "      const char *candidate = memchr(str + i, %d, size - i);\n"
+                              "\n"
+                              "      if (candidate == NULL) {\n"
+                              "        return 0;\n"
+                              "      }\n"
+                              "\n"
+                              "      i = (size_t)(candidate - str);\n",
+                              first_character);
+    } else {
+      success = success && output_format(output,
+                                         allocator,
+                                         "      for (; i < size; i++) {\n"
+                                         "        const int c = (unsigned char)str[i];\n"
+                                         "\n"
+                                         "        if (");
+
+      const size_t table = tables[n_class_slots - 1];
+      success = success && emit_char_class_test(output, first_class, "c", name, table, allocator);
+
+      success = success && output_format(output,
+                                         allocator,
+                                         ") {\n"
+                                         "          break;\n"
+                                         "        }\n"
+                                         "      }\n"
+                                         "\n"
+                                         "      if (i == size) {\n"
+                                         "        return 0;\n"
+                                         "      }\n");
+    }
+
+    success = success && output_format(output, allocator, "    }\n\n");
+  }
+
+  success = success && output_format(output, allocator, "    const size_t current = i %% 2;\n");
+
+  // Without consuming instructions, there are never any next threads
+  if (success && n_consumers != 0) {
+    success = output_format(output, allocator, "    const size_t next = 1 - current;\n");
+  }
+
+  success = success && output_format(output, allocator, "    size_t n_next = 0;\n");
+
+  if (success && uses_character) {
+    success = output_format(
+        output, allocator, "    const int c = (i < size) ? (unsigned char)str[i] : -1;\n");
+  }
+
+  if (success && uses_prev_character) {
+    success = output_format(
+        output, allocator, "    const int prev = (i == 0) ? -1 : (unsigned char)str[i - 1];\n");
+  }
+
+  if (success && regex->n_flags != 0) {
+    success = output_format(output,
+                            allocator,
+                            "    unsigned char flags[%zu];\n"
+                            "    memset(flags, 0, sizeof(flags));\n",
+                            (regex->n_flags + 7) / 8);
+  }
+
+  success = success &&
+            output_format(output,
+                          allocator,
+                          "\n"
+                          "    // Run each thread in priority order, and then (if there's no match "
+                          "yet) a new thread\n"
+                          "    for (size_t t = 0; t <= n_current; t++) {\n"
+                          "      size_t state = 0;\n"
+                          "      size_t sp = 0;\n"
+                          "\n"
+                          "      if (t < n_current) {\n"
+                          "        state = threads[current][t].state;\n"
+                          "        memcpy(working, threads[current][t].pointers, sizeof(const char "
+                          "*) * n_pointers);\n"
+                          "      } else if (is_match) {\n"
+                          "        break;\n"
+                          "      } else {\n"
+                          "        for (size_t j = 0; j < n_pointers; j++) {\n"
+                          "          working[j] = NULL;\n"
+                          "        }\n"
+                          "      }\n"
+                          "\n"
+                          "      goto dispatch;\n"
+                          "\n"
+                          "    pop:\n"
+                          "      if (sp == 0) {\n"
+                          "        continue;\n"
+                          "      }\n"
+                          "\n"
+                          "      sp--;\n"
+                          "\n"
+                          "      if (stack[sp].state == " GENERATED_RESTORE ") {\n"
+                          "        working[stack[sp].slot] = stack[sp].value;\n"
+                          "        goto pop;\n"
+                          "      }\n"
+                          "\n"
+                          "      state = stack[sp].state;\n"
+                          "\n"
+                          "    dispatch:\n"
+                          "      if (visited[state] == i + 1) {\n"
+                          "        goto pop;\n"
+                          "      }\n"
+                          "\n"
+                          "      visited[state] = i + 1;\n"
+                          "\n"
+                          "      switch (state) {\n");
+
+  for (size_t index = 0; success && index < size;) {
+    const size_t state = states[index];
+
+    const unsigned char byte = code[index++];
+
+    const unsigned char opcode = VM_OPCODE(byte);
+    const size_t operand_size = VM_OPERAND_SIZE(byte);
+
+    const size_t operand = deserialize_operand(code + index, operand_size);
+    index += operand_size;
+
+    const size_t next = states[index];
+
+    success = output_format(output, allocator, "      case %zu:\n", state);
+
+    switch (opcode) {
+    case VM_CHARACTER:
+    case VM_CHAR_CLASS:
+    case VM_BUILTIN_CHAR_CLASS: {
+      success = success && output_format(output, allocator, "        if (");
+
+      if (opcode == VM_CHARACTER) {
+        success = success && output_format(output, allocator, "c == %zu", operand);
+      } else {
+        const unsigned char *char_class = instruction_char_class(regex, opcode, operand);
+        const size_t table = operand + ((opcode == VM_CHAR_CLASS) ? 0 : regex->n_classes);
+
+        success = success &&
+                  emit_char_class_test(output, char_class, "c", name, tables[table], allocator);
+      }
+
+      success = success && output_format(output,
+                                         allocator,
+                                         ") {\n"
+                                         "          threads[next][n_next].state = %zu;\n"
+                                         "          memcpy(threads[next][n_next].pointers, "
+                                         "working, sizeof(const char *) * n_pointers);\n"
+                                         "          n_next++;\n"
+                                         "        }\n"
+                                         "\n"
+                                         "        goto pop;\n",
+                                         next);
+
+      break;
+    }
+
+    case VM_ANCHOR_BOF:
+    case VM_ANCHOR_BOL:
+    case VM_ANCHOR_EOF:
+    case VM_ANCHOR_EOL:
+    case VM_ANCHOR_WORD_BOUNDARY:
+    case VM_ANCHOR_NOT_WORD_BOUNDARY: {
+      const char *condition = NULL;
+
+      switch (opcode) {
+      case VM_ANCHOR_BOF:
+        condition = "prev == -1";
+        break;
+
+      case VM_ANCHOR_BOL:
+        condition = "prev == -1 || prev == '\\n'";
+        break;
+
+      case VM_ANCHOR_EOF:
+        condition = "c == -1";
+        break;
+
+      case VM_ANCHOR_EOL:
+        condition = "c == -1 || c == '\\n'";
+        break;
+
+      default:
+        break;
+      }
+
+      if (condition != NULL) {
+        success = success && output_format(output, allocator, "        if (!(%s)) {\n", condition);
+      } else {
+        // A word boundary is where exactly one of the characters either side is a word character
+        const size_t table = tables[regex->n_classes + BCC_WORD];
+
+        success = success && output_format(output, allocator, "        if ((");
+
+        const unsigned char *word = builtin_classes[BCC_WORD];
+
+        success = success && emit_char_class_test(output, word, "prev", name, table, allocator);
+
+        success = success && output_format(output,
+                                           allocator,
+                                           " != 0) %s (",
+                                           (opcode == VM_ANCHOR_WORD_BOUNDARY) ? "==" : "!=");
+
+        success = success && emit_char_class_test(output, word, "c", name, table, allocator);
+
+        success = success && output_format(output, allocator, " != 0)) {\n");
+      }
+
+      success = success && output_format(output,
+                                         allocator,
+                                         "          goto pop;\n"
+                                         "        }\n"
+                                         "\n"
+                                         "        state = %zu;\n"
+                                         "        goto dispatch;\n",
+                                         next);
+
+      break;
+    }
+
+    case VM_JUMP: {
+      success =
+          success && output_format(output,
+                                   allocator,
+                                   "        state = %zu;\n"
+                                   "        goto dispatch;\n",
+                                   states[index + operand]);
+      break;
+    }
+
+    case VM_SPLIT_PASSIVE:
+    case VM_SPLIT_EAGER:
+    case VM_SPLIT_BACKWARDS_PASSIVE:
+    case VM_SPLIT_BACKWARDS_EAGER: {
+      const int backwards =
+          opcode == VM_SPLIT_BACKWARDS_PASSIVE || opcode == VM_SPLIT_BACKWARDS_EAGER;
+      const int eager = opcode == VM_SPLIT_EAGER || opcode == VM_SPLIT_BACKWARDS_EAGER;
+
+      const size_t target = states[backwards ? index - operand : index + operand];
+
+      // The preferred state is visited first; the other is stacked for later
+      success = success && output_format(output,
+                                         allocator,
+                                         "        stack[sp].state = %zu;\n"
+                                         "        sp++;\n"
+                                         "\n"
+                                         "        state = %zu;\n"
+                                         "        goto dispatch;\n",
+                                         eager ? next : target,
+                                         eager ? target : next);
+
+      break;
+    }
+
+    case VM_WRITE_POINTER: {
+      success = success && output_format(output,
+                                         allocator,
+                                         "        if (%zu < n_pointers) {\n"
+                                         "          stack[sp].state = " GENERATED_RESTORE ";\n"
+                                         "          stack[sp].slot = %zu;\n"
+                                         "          stack[sp].value = working[%zu];\n"
+                                         "          sp++;\n"
+                                         "\n"
+                                         "          working[%zu] = str + i;\n"
+                                         "        }\n"
+                                         "\n"
+                                         "        state = %zu;\n"
+                                         "        goto dispatch;\n",
+                                         operand,
+                                         operand,
+                                         operand,
+                                         operand,
+                                         next);
+      break;
+    }
+
+    case VM_TEST_AND_SET_FLAG: {
+      success = success && output_format(output,
+                                         allocator,
+                                         "        if (flags[%zu] & %uu) {\n"
+                                         "          goto pop;\n"
+                                         "        }\n"
+                                         "\n"
+                                         "        flags[%zu] |= %uu;\n"
+                                         "        state = %zu;\n"
+                                         "        goto dispatch;\n",
+                                         operand / 8,
+                                         1u << (operand % 8),
+                                         operand / 8,
+                                         1u << (operand % 8),
+                                         next);
+      break;
+    }
+
+    default:
+      UNREACHABLE();
+    }
+
+    success = success && output_format(output, allocator, "\n");
+  }
+
+  // The end of the program, and the rest of the body
+  success = success &&
+            output_format(output,
+                          allocator,
+                          "      case %zu:\n"
+                          "        // A match; any threads of lower priority can be discarded\n"
+                          "        is_match = 1;\n"
+                          "\n"
+                          "        if (n_pointers == 0) {\n"
+                          "          return 1;\n"
+                          "        }\n"
+                          "\n"
+                          "        memcpy(pointers, working, sizeof(const char *) * n_pointers);\n"
+                          "        goto advance;\n"
+                          "      }\n"
+                          "    }\n"
+                          "\n"
+                          "  advance:\n"
+                          "    if (n_next == 0 && is_match) {\n"
+                          "      break;\n"
+                          "    }\n"
+                          "\n"
+                          "    n_current = n_next;\n"
+                          "  }\n"
+                          "\n"
+                          "  return is_match;\n"
+                          "}\n"
+                          "\n"
+                          "int %s_is_match(const char *str, size_t size) {\n"
+                          "  return %s_run(NULL, 0, str, size);\n"
+                          "}\n"
+                          "\n"
+                          "int %s_find(const char **match, const char *str, size_t size) {\n"
+                          "  match[0] = NULL;\n"
+                          "  match[1] = NULL;\n"
+                          "  return %s_run(match, 2, str, size);\n"
+                          "}\n"
+                          "\n"
+                          "int %s_match_groups(const char **groups, const char *str, size_t size) "
+                          "{\n"
+                          "  for (size_t i = 0; i < %zu; i++) {\n"
+                          "    groups[i] = NULL;\n"
+                          "  }\n"
+                          "\n"
+                          "  return %s_run(groups, %zu, str, size);\n"
+                          "}\n",
+                          states[size],
+                          name,
+                          name,
+                          name,
+                          name,
+                          name,
+                          n_pointers,
+                          name,
+                          n_pointers);
+
+  FREE(allocator, states);
+  FREE(allocator, tables);
+
+  return success ? CREX_OK : CREX_E_NOMEM;
+}
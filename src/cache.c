@@ -0,0 +1,348 @@
+// A cache of compiled regexes, keyed on their patterns. The cache is split into stripes by the hash
+// of the pattern, each with its own lock, hash table, and LRU list, so that lookups of different
+// patterns rarely contend. A regex is compiled outside of its stripe's lock, so a slow compilation
+// doesn't hold up other lookups; if two threads race to compile the same pattern, the loser's regex
+// is discarded in favour of the winner's.
+//
+// Each regex yielded by the cache holds a reference to its entry until it's released. Once a stripe
+// is over capacity, its least recently used entries are evicted. An evicted entry which is still
+// referenced is merely unlinked from its stripe, and is destroyed once its last reference goes
+
+#include <pthread.h>
+
+#define N_CACHE_STRIPES 16
+
+// Bounds the number of buckets in each stripe, so that a huge capacity doesn't mean a huge table
+#define MAX_CACHE_BUCKETS (64 * 1024)
+
+typedef struct cache_entry cache_entry_t;
+typedef struct cache_stripe cache_stripe_t;
+
+struct cache_entry {
+  cache_stripe_t *stripe;
+
+  size_t hash;
+  char *pattern;
+  size_t size;
+
+  regex_t *regex;
+
+  size_t n_references;
+  int evicted;
+
+  // The next entry in the same bucket
+  cache_entry_t *next_in_bucket;
+
+  // Neighbours in the LRU list, whose head is the most recently used
+  cache_entry_t *prev;
+  cache_entry_t *next;
+};
+
+struct cache_stripe {
+  pthread_mutex_t mutex;
+
+  size_t n_buckets;
+  cache_entry_t **buckets;
+
+  size_t n_entries;
+  cache_entry_t *head;
+  cache_entry_t *tail;
+};
+
+struct crex_cache {
+  // The maximum number of entries in each stripe
+  size_t stripe_capacity;
+
+  cache_stripe_t stripes[N_CACHE_STRIPES];
+
+  allocator_t allocator;
+};
+
+// FNV-1a
+static size_t hash_pattern(const char *pattern, size_t size) {
+  uint64_t hash = 0xcbf29ce484222325u;
+
+  for (size_t i = 0; i < size; i++) {
+    hash ^= (unsigned char)pattern[i];
+    hash *= 0x100000001b3u;
+  }
+
+  return (size_t)hash;
+}
+
+WUR static cache_t *create_cache(status_t *status, size_t capacity, const allocator_t *allocator) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  cache_t *cache = ALLOC(allocator, sizeof(cache_t));
+
+  if (cache == NULL) {
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  cache->stripe_capacity = capacity / N_CACHE_STRIPES + (capacity % N_CACHE_STRIPES != 0);
+  cache->allocator = *allocator;
+
+  // Enough buckets for a full stripe, rounded up to a power of two
+  size_t n_buckets = 1;
+
+  while (n_buckets < cache->stripe_capacity && n_buckets < MAX_CACHE_BUCKETS) {
+    n_buckets *= 2;
+  }
+
+  for (size_t i = 0; i < N_CACHE_STRIPES; i++) {
+    cache_stripe_t *stripe = &cache->stripes[i];
+
+    stripe->n_buckets = n_buckets;
+    stripe->buckets = ALLOC(allocator, sizeof(cache_entry_t *) * n_buckets);
+
+    if (stripe->buckets == NULL) {
+      for (size_t j = 0; j < i; j++) {
+        FREE(allocator, cache->stripes[j].buckets);
+        pthread_mutex_destroy(&cache->stripes[j].mutex);
+      }
+
+      FREE(allocator, cache);
+      *status = CREX_E_NOMEM;
+      return NULL;
+    }
+
+    for (size_t j = 0; j < n_buckets; j++) {
+      stripe->buckets[j] = NULL;
+    }
+
+    stripe->n_entries = 0;
+    stripe->head = NULL;
+    stripe->tail = NULL;
+
+    pthread_mutex_init(&stripe->mutex, NULL);
+  }
+
+  *status = CREX_OK;
+
+  return cache;
+}
+
+static void destroy_cache_entry(cache_entry_t *entry, const allocator_t *allocator) {
+  crex_destroy_regex(entry->regex);
+  FREE(allocator, entry->pattern);
+  FREE(allocator, entry);
+}
+
+// Every regex yielded by the cache must have been released
+static void destroy_cache(cache_t *cache) {
+  const allocator_t *allocator = &cache->allocator;
+
+  for (size_t i = 0; i < N_CACHE_STRIPES; i++) {
+    cache_stripe_t *stripe = &cache->stripes[i];
+
+    for (cache_entry_t *entry = stripe->head; entry != NULL;) {
+      cache_entry_t *next = entry->next;
+      assert(entry->n_references == 0);
+      destroy_cache_entry(entry, allocator);
+      entry = next;
+    }
+
+    FREE(allocator, stripe->buckets);
+    pthread_mutex_destroy(&stripe->mutex);
+  }
+
+  FREE(allocator, cache);
+}
+
+static void cache_unlink(cache_stripe_t *stripe, cache_entry_t *entry) {
+  if (entry->prev == NULL) {
+    stripe->head = entry->next;
+  } else {
+    entry->prev->next = entry->next;
+  }
+
+  if (entry->next == NULL) {
+    stripe->tail = entry->prev;
+  } else {
+    entry->next->prev = entry->prev;
+  }
+}
+
+static void cache_push_front(cache_stripe_t *stripe, cache_entry_t *entry) {
+  entry->prev = NULL;
+  entry->next = stripe->head;
+
+  if (stripe->head == NULL) {
+    stripe->tail = entry;
+  } else {
+    stripe->head->prev = entry;
+  }
+
+  stripe->head = entry;
+}
+
+// The stripe's lock must be held
+static cache_entry_t *
+cache_lookup(cache_stripe_t *stripe, size_t hash, const char *pattern, size_t size) {
+  cache_entry_t *entry = stripe->buckets[hash & (stripe->n_buckets - 1)];
+
+  for (; entry != NULL; entry = entry->next_in_bucket) {
+    if (entry->hash == hash && entry->size == size && memcmp(entry->pattern, pattern, size) == 0) {
+      return entry;
+    }
+  }
+
+  return NULL;
+}
+
+// Evicts least recently used entries until the stripe is within capacity. The stripe's lock must be
+// held. Yields a list (linked through next) of the evicted entries which can be destroyed, which
+// the caller should do once the lock is released
+WUR static cache_entry_t *cache_evict(cache_stripe_t *stripe, size_t capacity) {
+  cache_entry_t *destroyed = NULL;
+
+  while (stripe->n_entries > capacity) {
+    cache_entry_t *entry = stripe->tail;
+
+    cache_unlink(stripe, entry);
+
+    cache_entry_t **link = &stripe->buckets[entry->hash & (stripe->n_buckets - 1)];
+
+    while (*link != entry) {
+      link = &(*link)->next_in_bucket;
+    }
+
+    *link = entry->next_in_bucket;
+
+    stripe->n_entries--;
+    entry->evicted = 1;
+
+    if (entry->n_references == 0) {
+      entry->next = destroyed;
+      destroyed = entry;
+    }
+  }
+
+  return destroyed;
+}
+
+WUR static const regex_t *
+cache_get(status_t *status, cache_t *cache, const char *pattern, size_t size) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  const allocator_t *allocator = &cache->allocator;
+
+  const size_t hash = hash_pattern(pattern, size);
+
+  // The low bits of the hash pick the bucket, so use the high bits to pick the stripe
+  cache_stripe_t *stripe = &cache->stripes[(hash >> (8 * sizeof(size_t) - 4)) % N_CACHE_STRIPES];
+
+  pthread_mutex_lock(&stripe->mutex);
+
+  cache_entry_t *entry = cache_lookup(stripe, hash, pattern, size);
+
+  if (entry != NULL) {
+    entry->n_references++;
+
+    cache_unlink(stripe, entry);
+    cache_push_front(stripe, entry);
+
+    pthread_mutex_unlock(&stripe->mutex);
+
+    *status = CREX_OK;
+    return entry->regex;
+  }
+
+  pthread_mutex_unlock(&stripe->mutex);
+
+  regex_t *regex = crex_compile_with_allocator(status, pattern, size, allocator);
+
+  if (regex == NULL) {
+    return NULL;
+  }
+
+  entry = ALLOC(allocator, sizeof(cache_entry_t));
+  char *pattern_copy = ALLOC(allocator, size + 1);
+
+  if (entry == NULL || pattern_copy == NULL) {
+    FREE(allocator, entry);
+    FREE(allocator, pattern_copy);
+    crex_destroy_regex(regex);
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  safe_memcpy(pattern_copy, pattern, size);
+
+  entry->stripe = stripe;
+  entry->hash = hash;
+  entry->pattern = pattern_copy;
+  entry->size = size;
+  entry->regex = regex;
+  entry->n_references = 1;
+  entry->evicted = 0;
+
+  regex->cache_entry = entry;
+
+  pthread_mutex_lock(&stripe->mutex);
+
+  // Another thread may have compiled the same pattern in the meantime
+  cache_entry_t *existing = cache_lookup(stripe, hash, pattern, size);
+
+  if (existing != NULL) {
+    existing->n_references++;
+
+    cache_unlink(stripe, existing);
+    cache_push_front(stripe, existing);
+
+    pthread_mutex_unlock(&stripe->mutex);
+
+    destroy_cache_entry(entry, allocator);
+
+    *status = CREX_OK;
+    return existing->regex;
+  }
+
+  cache_entry_t **bucket = &stripe->buckets[hash & (stripe->n_buckets - 1)];
+  entry->next_in_bucket = *bucket;
+  *bucket = entry;
+
+  cache_push_front(stripe, entry);
+  stripe->n_entries++;
+
+  cache_entry_t *destroyed = cache_evict(stripe, cache->stripe_capacity);
+
+  pthread_mutex_unlock(&stripe->mutex);
+
+  while (destroyed != NULL) {
+    cache_entry_t *next = destroyed->next;
+    destroy_cache_entry(destroyed, allocator);
+    destroyed = next;
+  }
+
+  *status = CREX_OK;
+
+  return regex;
+}
+
+static void cache_release(cache_t *cache, const regex_t *regex) {
+  cache_entry_t *entry = regex->cache_entry;
+  assert(entry != NULL);
+
+  cache_stripe_t *stripe = entry->stripe;
+
+  pthread_mutex_lock(&stripe->mutex);
+
+  assert(entry->n_references != 0);
+  const int destroy = --entry->n_references == 0 && entry->evicted;
+
+  pthread_mutex_unlock(&stripe->mutex);
+
+  if (destroy) {
+    destroy_cache_entry(entry, &cache->allocator);
+  }
+}
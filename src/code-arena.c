@@ -0,0 +1,341 @@
+// Native code for all regexes is packed into a process-wide arena of slabs, rather than giving each
+// regex its own (mostly empty) pages. Each slab is a memfd mapped twice: once read-write, through
+// which code is copied in, and once read-execute, from which it is run; no page is ever both
+// writable and executable. Slabs are carved into CODE_BLOCK_SIZE blocks tracked by a bitmap, and a
+// slab is released once all the code in it has been freed.
+//
+// After a fork, parent and child share the contents of every slab, so either could clobber code
+// still in use by the other by reusing a freed block. Thus, on fork, the blocks in use are marked
+// as shared, and a shared block is never reused even once freed. The child also seals all extant
+// slabs, as its writable views aren't inherited; sealed slabs are never allocated from again. In
+// either process, a slab is released once all the code in it has been freed.
+//
+// Slab metadata is always allocated with the default allocator, since a slab holds code for any
+// number of regexes, and may outlive the regex whose allocator it was created for.
+//
+// Where memfds aren't available, each piece of native code gets its own private mapping instead
+
+#define CODE_BLOCK_SIZE 64
+#define CODE_SLAB_SIZE (1024 * 1024)
+
+#if defined(__linux__) && defined(MFD_CLOEXEC)
+#define CODE_ARENA
+#endif
+
+#ifdef CODE_ARENA
+
+#include <pthread.h>
+
+typedef struct code_slab {
+  struct code_slab *next;
+
+  // Executable view
+  unsigned char *code;
+
+  // Writable view, or NULL if the slab is sealed
+  unsigned char *data;
+
+  size_t size;
+
+  size_t n_blocks;
+  size_t n_free_blocks;
+
+  // Blocks holding code not yet freed by this process. Shared blocks count as neither free nor live
+  // once freed
+  size_t n_live_blocks;
+
+  // No block preceding this one is free
+  size_t first_free_block;
+
+  // Blocks in use at the time of a fork; points just past used_blocks
+  unsigned char *shared_blocks;
+
+  unsigned char used_blocks[];
+} code_slab_t;
+
+static struct {
+  pthread_mutex_t mutex;
+  code_slab_t *slabs;
+  int registered_fork_handlers;
+} code_arena = {PTHREAD_MUTEX_INITIALIZER, NULL, 0};
+
+static void destroy_code_slab(code_slab_t *slab) {
+  munmap(slab->code, slab->size);
+
+  if (slab->data != NULL) {
+    munmap(slab->data, slab->size);
+  }
+
+  FREE(&default_allocator, slab);
+}
+
+WUR static code_slab_t *create_code_slab(size_t size) {
+  const size_t n_blocks = size / CODE_BLOCK_SIZE;
+  const size_t bitmap_size = bitmap_size_for_bits(n_blocks);
+
+  code_slab_t *slab = ALLOC(&default_allocator, sizeof(code_slab_t) + 2 * bitmap_size);
+
+  if (slab == NULL) {
+    return NULL;
+  }
+
+  const int fd = memfd_create("crex", MFD_CLOEXEC);
+
+  if (fd == -1) {
+    FREE(&default_allocator, slab);
+    return NULL;
+  }
+
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    FREE(&default_allocator, slab);
+    return NULL;
+  }
+
+  slab->code = mmap(NULL, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+  slab->data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  // The mappings keep the memfd alive
+  close(fd);
+
+  if (slab->code == MAP_FAILED || slab->data == MAP_FAILED) {
+    if (slab->code != MAP_FAILED) {
+      munmap(slab->code, size);
+    }
+
+    if (slab->data != MAP_FAILED) {
+      munmap(slab->data, size);
+    }
+
+    FREE(&default_allocator, slab);
+    return NULL;
+  }
+
+  // The writable view is for this process's use only; see above
+  madvise(slab->data, size, MADV_DONTFORK);
+
+  slab->next = NULL;
+  slab->size = size;
+  slab->n_blocks = n_blocks;
+  slab->n_free_blocks = n_blocks;
+  slab->n_live_blocks = 0;
+  slab->first_free_block = 0;
+  slab->shared_blocks = slab->used_blocks + bitmap_size;
+  bitmap_clear(slab->used_blocks, bitmap_size);
+  bitmap_clear(slab->shared_blocks, bitmap_size);
+
+  return slab;
+}
+
+// Yields the index of the first run of n_blocks free blocks in slab, or SIZE_MAX if there is none
+static size_t find_free_code_blocks(const code_slab_t *slab, size_t n_blocks) {
+  size_t run = 0;
+
+  for (size_t i = slab->first_free_block; i < slab->n_blocks; i++) {
+    if (bitmap_test(slab->used_blocks, i)) {
+      run = 0;
+      continue;
+    }
+
+    if (++run == n_blocks) {
+      return i + 1 - n_blocks;
+    }
+  }
+
+  return SIZE_MAX;
+}
+
+static void share_code_blocks(void) {
+  for (code_slab_t *slab = code_arena.slabs; slab != NULL; slab = slab->next) {
+    // A block that is shared stays in use, so the blocks in use are exactly the ones to share
+    memcpy(slab->shared_blocks, slab->used_blocks, bitmap_size_for_bits(slab->n_blocks));
+  }
+}
+
+static void seal_code_slabs(void) {
+  for (code_slab_t *slab = code_arena.slabs; slab != NULL; slab = slab->next) {
+    // The writable view was never inherited, so there is nothing to unmap
+    slab->data = NULL;
+  }
+}
+
+static void lock_code_arena(void) {
+  pthread_mutex_lock(&code_arena.mutex);
+}
+
+static void unlock_code_arena(void) {
+  pthread_mutex_unlock(&code_arena.mutex);
+}
+
+static void lock_and_share_code_arena(void) {
+  lock_code_arena();
+  share_code_blocks();
+}
+
+static void seal_and_unlock_code_arena(void) {
+  seal_code_slabs();
+  unlock_code_arena();
+}
+
+WUR static unsigned char *allocate_code_in_arena(const void *code, size_t size) {
+  const size_t n_blocks = (size + CODE_BLOCK_SIZE - 1) / CODE_BLOCK_SIZE;
+
+  lock_code_arena();
+
+  if (!code_arena.registered_fork_handlers) {
+    if (pthread_atfork(lock_and_share_code_arena, unlock_code_arena, seal_and_unlock_code_arena) !=
+        0) {
+      unlock_code_arena();
+      return NULL;
+    }
+
+    code_arena.registered_fork_handlers = 1;
+  }
+
+  code_slab_t *slab;
+  size_t block = SIZE_MAX;
+
+  for (slab = code_arena.slabs; slab != NULL; slab = slab->next) {
+    if (slab->data == NULL || slab->n_free_blocks < n_blocks) {
+      continue;
+    }
+
+    block = find_free_code_blocks(slab, n_blocks);
+
+    if (block != SIZE_MAX) {
+      break;
+    }
+  }
+
+  if (slab == NULL) {
+    const long page_size = sysconf(_SC_PAGESIZE);
+    const size_t granularity = (page_size <= 0) ? 4096 : page_size;
+
+    size_t slab_size = n_blocks * CODE_BLOCK_SIZE;
+    slab_size = (slab_size < CODE_SLAB_SIZE) ? CODE_SLAB_SIZE : slab_size;
+    slab_size = (slab_size + granularity - 1) / granularity * granularity;
+
+    slab = create_code_slab(slab_size);
+
+    if (slab == NULL) {
+      unlock_code_arena();
+      return NULL;
+    }
+
+    slab->next = code_arena.slabs;
+    code_arena.slabs = slab;
+
+    block = 0;
+  }
+
+  for (size_t i = block; i < block + n_blocks; i++) {
+    bitmap_set(slab->used_blocks, i);
+  }
+
+  slab->n_free_blocks -= n_blocks;
+  slab->n_live_blocks += n_blocks;
+
+  if (block == slab->first_free_block) {
+    slab->first_free_block = block + n_blocks;
+  }
+
+  memcpy(slab->data + CODE_BLOCK_SIZE * block, code, size);
+
+  unlock_code_arena();
+
+  return slab->code + CODE_BLOCK_SIZE * block;
+}
+
+// Yields 0 if code wasn't allocated in the arena
+WUR static int free_code_in_arena(void *code, size_t size) {
+  unsigned char *pointer = code;
+  const size_t n_blocks = (size + CODE_BLOCK_SIZE - 1) / CODE_BLOCK_SIZE;
+
+  lock_code_arena();
+
+  code_slab_t **link = &code_arena.slabs;
+
+  while (*link != NULL && !((*link)->code <= pointer && pointer < (*link)->code + (*link)->size)) {
+    link = &(*link)->next;
+  }
+
+  code_slab_t *slab = *link;
+
+  if (slab == NULL) {
+    unlock_code_arena();
+    return 0;
+  }
+
+  const size_t block = (pointer - slab->code) / CODE_BLOCK_SIZE;
+
+  for (size_t i = block; i < block + n_blocks; i++) {
+    assert(bitmap_test(slab->used_blocks, i));
+
+    // The other process may still be running the code in a shared block
+    if (bitmap_test(slab->shared_blocks, i)) {
+      continue;
+    }
+
+    bitmap_unset(slab->used_blocks, i);
+    slab->n_free_blocks++;
+
+    if (i < slab->first_free_block) {
+      slab->first_free_block = i;
+    }
+  }
+
+  slab->n_live_blocks -= n_blocks;
+
+  // Hang on to the newest slab if it's wholly free, so as to avoid churn when regexes are
+  // repeatedly created and destroyed
+  if (slab->n_live_blocks == 0 &&
+      (slab != code_arena.slabs || slab->data == NULL || slab->n_free_blocks != slab->n_blocks)) {
+    *link = slab->next;
+    destroy_code_slab(slab);
+  }
+
+  unlock_code_arena();
+
+  return 1;
+}
+
+#endif
+
+// Copy assembled (position-independent) code into executable memory
+WUR static unsigned char *allocate_native_code(const void *code, size_t size) {
+  assert(size != 0);
+
+#ifdef CODE_ARENA
+  unsigned char *arena_code = allocate_code_in_arena(code, size);
+
+  if (arena_code != NULL) {
+    return arena_code;
+  }
+#endif
+
+  unsigned char *mapping =
+      mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+
+  if (mapping == MAP_FAILED) {
+    return NULL;
+  }
+
+  memcpy(mapping, code, size);
+
+  if (mprotect(mapping, size, PROT_READ | PROT_EXEC)) {
+    munmap(mapping, size);
+    return NULL;
+  }
+
+  return mapping;
+}
+
+static void free_native_code(void *code, size_t size) {
+#ifdef CODE_ARENA
+  if (free_code_in_arena(code, size)) {
+    return;
+  }
+#endif
+
+  munmap(code, size);
+}
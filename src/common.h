@@ -14,11 +14,18 @@
 #define NATIVE_COMPILER
 #endif
 
+// Deferring native compilation requires atomics to publish the native code
+#if defined(NATIVE_COMPILER) && (defined(__GNUC__) || defined(__clang__))
+#define DEFERRED_NATIVE_COMPILER
+#endif
+
 #if (defined(__GNUC__) || defined(__clang__))
 
 // Maybe Unused
 #define MU __attribute__((unused))
 
+#define PREFETCH(address) __builtin_prefetch(address)
+
 #define UNREACHABLE()                                                                              \
   do {                                                                                             \
     assert(0);                                                                                     \
@@ -28,6 +35,7 @@
 #else
 
 #define MU
+#define PREFETCH(address) ((void)(address))
 #define UNREACHABLE() assert(0)
 
 #endif
@@ -35,10 +43,21 @@
 #define WUR CREX_WARN_UNUSED_RESULT
 
 typedef crex_allocator_t allocator_t;
+typedef crex_cache_t cache_t;
 typedef crex_context_t context_t;
+typedef crex_context_pool_t context_pool_t;
+typedef crex_context_pool_stats_t context_pool_stats_t;
+typedef crex_database_t database_t;
+typedef crex_input_t input_t;
+typedef crex_output_t output_t;
+typedef crex_template_t template_t;
 typedef crex_match_t match_t;
 typedef crex_status_t status_t;
 typedef crex_regex_t regex_t;
+typedef crex_regex_set_t regex_set_t;
+typedef crex_span_t span_t;
+typedef crex_split_callback_t split_callback_t;
+typedef crex_line_callback_t line_callback_t;
 
 #define ALLOC(allocator, size) ((allocator)->alloc)((allocator)->context, size)
 #define FREE(allocator, pointer) ((allocator)->free)((allocator)->context, pointer)
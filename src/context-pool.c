@@ -0,0 +1,296 @@
+// A pool of contexts, for servers which search on many threads. Each thread has a slot in the pool,
+// which caches one idle context, so that a thread which acquires and releases a context per request
+// never takes a lock; contexts beyond that go to (and come from) a shared list, under the pool's
+// lock. A thread's slot is created on its first use of the pool, and its context is destroyed when
+// the thread exits.
+//
+// A context's buffer only ever grows, so a released context whose buffer has grown beyond the
+// pool's limit has the buffer freed, to be reallocated by its next search as needed. Statistics are
+// kept in each slot, by its thread alone, and are summed on request
+
+#include <pthread.h>
+
+#if defined(__GNUC__) || defined(__clang__)
+#define POOL_STAT_INCREMENT(stat) __atomic_store_n(&(stat), (stat) + 1, __ATOMIC_RELAXED)
+#define POOL_STAT_LOAD(stat) __atomic_load_n(&(stat), __ATOMIC_RELAXED)
+#else
+#define POOL_STAT_INCREMENT(stat) ((stat)++)
+#define POOL_STAT_LOAD(stat) (stat)
+#endif
+
+typedef struct context_pool_slot context_pool_slot_t;
+
+struct context_pool_slot {
+  context_pool_t *pool;
+
+  // The thread's idle context, if any
+  context_t *context;
+
+  context_pool_stats_t stats;
+
+  // Neighbours in the pool's list of slots
+  context_pool_slot_t *prev;
+  context_pool_slot_t *next;
+};
+
+struct crex_context_pool {
+  pthread_key_t key;
+  pthread_mutex_t mutex;
+
+  context_pool_slot_t *slots;
+
+  // Idle contexts beyond those cached in the slots
+  size_t n_shared;
+  size_t max_shared;
+  context_t **shared;
+
+  size_t max_buffer_size;
+
+  // The statistics of the slots of threads which have exited
+  context_pool_stats_t retired_stats;
+
+  allocator_t allocator;
+};
+
+static void add_context_pool_stats(context_pool_stats_t *stats, const context_pool_stats_t *other) {
+  stats->n_acquisitions += POOL_STAT_LOAD(other->n_acquisitions);
+  stats->n_thread_hits += POOL_STAT_LOAD(other->n_thread_hits);
+  stats->n_shared_hits += POOL_STAT_LOAD(other->n_shared_hits);
+  stats->n_creations += POOL_STAT_LOAD(other->n_creations);
+  stats->n_trims += POOL_STAT_LOAD(other->n_trims);
+  stats->n_discards += POOL_STAT_LOAD(other->n_discards);
+}
+
+static void destroy_context_pool_slot(void *value) {
+  context_pool_slot_t *slot = value;
+  context_pool_t *pool = slot->pool;
+
+  pthread_mutex_lock(&pool->mutex);
+
+  add_context_pool_stats(&pool->retired_stats, &slot->stats);
+
+  if (slot->prev == NULL) {
+    pool->slots = slot->next;
+  } else {
+    slot->prev->next = slot->next;
+  }
+
+  if (slot->next != NULL) {
+    slot->next->prev = slot->prev;
+  }
+
+  pthread_mutex_unlock(&pool->mutex);
+
+  crex_destroy_context(slot->context);
+  FREE(&pool->allocator, slot);
+}
+
+WUR static context_pool_t *create_context_pool(status_t *status,
+                                               size_t max_shared,
+                                               size_t max_buffer_size,
+                                               const allocator_t *allocator) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  context_pool_t *pool = ALLOC(allocator, sizeof(context_pool_t));
+  context_t **shared = ALLOC(allocator, sizeof(context_t *) * max_shared);
+
+  if (pool == NULL || (shared == NULL && max_shared != 0)) {
+    FREE(allocator, pool);
+    FREE(allocator, shared);
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  // Failing to create a key means running out of keys, which is as good as running out of memory
+  if (pthread_key_create(&pool->key, destroy_context_pool_slot) != 0) {
+    FREE(allocator, pool);
+    FREE(allocator, shared);
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  pthread_mutex_init(&pool->mutex, NULL);
+
+  pool->slots = NULL;
+
+  pool->n_shared = 0;
+  pool->max_shared = max_shared;
+  pool->shared = shared;
+
+  pool->max_buffer_size = max_buffer_size;
+
+  memset(&pool->retired_stats, 0, sizeof(context_pool_stats_t));
+
+  pool->allocator = *allocator;
+
+  *status = CREX_OK;
+
+  return pool;
+}
+
+// Every context acquired from the pool must have been released, and no other thread may be using
+// the pool. Other threads' slots are destroyed here, rather than when they exit
+static void destroy_context_pool(context_pool_t *pool) {
+  const allocator_t *allocator = &pool->allocator;
+
+  pthread_key_delete(pool->key);
+
+  for (context_pool_slot_t *slot = pool->slots; slot != NULL;) {
+    context_pool_slot_t *next = slot->next;
+    crex_destroy_context(slot->context);
+    FREE(allocator, slot);
+    slot = next;
+  }
+
+  for (size_t i = 0; i < pool->n_shared; i++) {
+    crex_destroy_context(pool->shared[i]);
+  }
+
+  pthread_mutex_destroy(&pool->mutex);
+
+  FREE(allocator, pool->shared);
+  FREE(allocator, pool);
+}
+
+// Yields the calling thread's slot, creating it if need be, or NULL on allocation failure
+WUR static context_pool_slot_t *context_pool_slot(context_pool_t *pool) {
+  context_pool_slot_t *slot = pthread_getspecific(pool->key);
+
+  if (slot != NULL) {
+    return slot;
+  }
+
+  slot = ALLOC(&pool->allocator, sizeof(context_pool_slot_t));
+
+  if (slot == NULL) {
+    return NULL;
+  }
+
+  if (pthread_setspecific(pool->key, slot) != 0) {
+    FREE(&pool->allocator, slot);
+    return NULL;
+  }
+
+  slot->pool = pool;
+  slot->context = NULL;
+
+  memset(&slot->stats, 0, sizeof(context_pool_stats_t));
+
+  pthread_mutex_lock(&pool->mutex);
+
+  slot->prev = NULL;
+  slot->next = pool->slots;
+
+  if (pool->slots != NULL) {
+    pool->slots->prev = slot;
+  }
+
+  pool->slots = slot;
+
+  pthread_mutex_unlock(&pool->mutex);
+
+  return slot;
+}
+
+WUR static context_t *acquire_context(status_t *status, context_pool_t *pool) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  context_pool_slot_t *slot = context_pool_slot(pool);
+
+  if (slot == NULL) {
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  POOL_STAT_INCREMENT(slot->stats.n_acquisitions);
+
+  context_t *context = slot->context;
+
+  if (context != NULL) {
+    slot->context = NULL;
+    POOL_STAT_INCREMENT(slot->stats.n_thread_hits);
+    *status = CREX_OK;
+    return context;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+
+  if (pool->n_shared != 0) {
+    context = pool->shared[--pool->n_shared];
+  }
+
+  pthread_mutex_unlock(&pool->mutex);
+
+  if (context != NULL) {
+    POOL_STAT_INCREMENT(slot->stats.n_shared_hits);
+    *status = CREX_OK;
+    return context;
+  }
+
+  context = crex_create_context_with_allocator(status, &pool->allocator);
+
+  if (context != NULL) {
+    POOL_STAT_INCREMENT(slot->stats.n_creations);
+  }
+
+  return context;
+}
+
+static void release_context(context_pool_t *pool, context_t *context) {
+  context_pool_slot_t *slot = context_pool_slot(pool);
+
+  if (context->capacity > pool->max_buffer_size) {
+    FREE(&context->allocator, context->buffer);
+    context->buffer = NULL;
+    context->capacity = 0;
+
+    if (slot != NULL) {
+      POOL_STAT_INCREMENT(slot->stats.n_trims);
+    }
+  }
+
+  if (slot != NULL && slot->context == NULL) {
+    slot->context = context;
+    return;
+  }
+
+  pthread_mutex_lock(&pool->mutex);
+
+  const int retained = pool->n_shared < pool->max_shared;
+
+  if (retained) {
+    pool->shared[pool->n_shared++] = context;
+  }
+
+  pthread_mutex_unlock(&pool->mutex);
+
+  if (!retained) {
+    if (slot != NULL) {
+      POOL_STAT_INCREMENT(slot->stats.n_discards);
+    }
+
+    crex_destroy_context(context);
+  }
+}
+
+static void context_pool_stats(context_pool_stats_t *stats, context_pool_t *pool) {
+  pthread_mutex_lock(&pool->mutex);
+
+  *stats = pool->retired_stats;
+
+  for (const context_pool_slot_t *slot = pool->slots; slot != NULL; slot = slot->next) {
+    add_context_pool_stats(stats, &slot->stats);
+  }
+
+  stats->n_shared = pool->n_shared;
+
+  pthread_mutex_unlock(&pool->mutex);
+}
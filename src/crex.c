@@ -9,18 +9,60 @@ static void safe_memcpy(void *destination, const void *source, size_t size) {
 }
 
 #include "bytecode-compiler.h"
+#include "vm.h"
 
 struct crex_context {
   unsigned char *buffer;
   size_t capacity;
   allocator_t allocator;
+
+  // The character preceding the string being searched, or -1 if the string is at the beginning of
+  // the input. Native code reads this from here rather than taking it as a parameter
+  int prev_character;
+
+  // For crex_find_all and crex_next_match. position is where the next search begins, or NULL once
+  // the matches are exhausted
+  struct {
+    const regex_t *regex;
+    const char *str;
+    const char *eof;
+    const char *position;
+    const char *last_match_end;
+  } iterator;
+
+  // For crex_stream_*. The stream's threads live in buffer, as for any other query on the VM
+  struct {
+    vm_t vm;
+    size_t offset;
+    int prev_character;
+    int done;
+  } stream;
+
+  // For regex sets, the bitmap of the set's patterns which have matched (see run_regex_set). It
+  // lives outside buffer because native code might reallocate buffer while writing to it
+  struct {
+    unsigned char *accepts;
+    size_t capacity;
+  } set;
 };
 
+#ifdef NATIVE_COMPILER
+
+// The native code for a regex has a separate entry point for each kind of query, specialized for
+// the number of pointers that kind of query yields
+typedef enum { NM_IS_MATCH, NM_FIND, NM_GROUPS, N_NATIVE_MODES } native_mode_t;
+
+#endif
+
 struct crex_regex {
   size_t n_capturing_groups;
   size_t n_classes;
   size_t n_flags;
 
+  // If this is the combined program of a regex set, the number of patterns in the set (see
+  // compile_set_pattern); otherwise 0
+  size_t n_patterns;
+
   char_class_t *classes;
 
   struct {
@@ -32,16 +74,34 @@ struct crex_regex {
   struct {
     size_t size;
     void *code;
+
+    // Offset of the entry point for each native_mode_t within code
+    size_t entry_points[N_NATIVE_MODES];
+
+    // NF_* bitmask of optional CPU features used by code
+    unsigned int features;
+
+    // If threshold is nonzero, native compilation is deferred until the regex has been executed
+    // threshold times on the VM; until then, code is NULL. Because a regex may be shared between
+    // threads, code is published atomically, and compiling ensures that only one thread compiles
+    size_t threshold;
+    size_t n_executions;
+    int compiling;
   } native_code;
 #endif
 
-  // For crex_destroy_regex
-  struct {
-    void *context;
-    void (*free)(void *, void *);
-  } allocator;
+  // For crex_destroy_regex and deferred native compilation
+  allocator_t allocator;
+
+  // If the regex belongs to a cache, its entry there (see cache.c); otherwise NULL
+  struct cache_entry *cache_entry;
+
+  // The DFA for parallel searches (see parallel.c), built on the first one; NULL until then
+  struct parallel_dfa *parallel_dfa;
 };
 
+static void destroy_parallel_dfa(struct parallel_dfa *parallel_dfa, const allocator_t *allocator);
+
 // FIXME: put this somewhere smart
 #define NON_CAPTURING_GROUP SIZE_MAX
 
@@ -138,6 +198,10 @@ static void bitmap_set(unsigned char *bitmap, size_t index) {
   bitmap[index >> 3u] |= 1u << (index & 7u);
 }
 
+MU static void bitmap_unset(unsigned char *bitmap, size_t index) {
+  bitmap[index >> 3u] &= ~(1u << (index & 7u));
+}
+
 static void bitmap_clear(unsigned char *bitmap, size_t size) {
   memset(bitmap, 0, size);
 }
@@ -166,11 +230,83 @@ MU static size_t bitmap_size_for_bits(size_t bits) {
 
 #include "allocator.c"
 #include "bytecode-compiler.c"
+#include "dfa.c"
 #include "lexer.c"
 #include "native-compiler.c"
 #include "parser.c"
 #include "vm.c"
 
+/** Deferred native compilation **/
+
+#ifdef NATIVE_COMPILER
+
+// By default, regexes are compiled to native code eagerly. If CREX_NATIVE_COMPILATION_THRESHOLD is
+// set to some positive integer n, regexes are instead executed on the VM for their first n
+// executions, and compiled to native code on the next execution
+static size_t native_compilation_threshold(void) {
+#ifdef DEFERRED_NATIVE_COMPILER
+  const char *value = getenv("CREX_NATIVE_COMPILATION_THRESHOLD");
+
+  if (value == NULL || *value == 0) {
+    return 0;
+  }
+
+  char *end;
+  const unsigned long threshold = strtoul(value, &end, 10);
+
+  return (*end == 0) ? threshold : 0;
+#else
+  return 0;
+#endif
+}
+
+// Set up the native code for a freshly compiled or loaded regex. If code is non-NULL, it's
+// previously-compiled native code for the regex (from a trusted dump), which is mapped as-is.
+// Otherwise, the regex is compiled to native code now, unless native compilation is deferred
+WUR static int initialize_native_code(regex_t *regex,
+                                      const void *code,
+                                      size_t size,
+                                      const size_t *entry_points,
+                                      unsigned int features) {
+  regex->native_code.size = 0;
+  regex->native_code.code = NULL;
+  regex->native_code.features = 0;
+  regex->native_code.threshold = native_compilation_threshold();
+  regex->native_code.n_executions = 0;
+  regex->native_code.compiling = 0;
+
+  if (code != NULL) {
+    regex->native_code.code = allocate_native_code(code, size);
+    regex->native_code.size = size;
+    regex->native_code.features = features;
+    memcpy(regex->native_code.entry_points, entry_points, sizeof(regex->native_code.entry_points));
+
+    if (regex->native_code.code == NULL) {
+      return 0;
+    }
+
+    if (perf_map_enabled()) {
+      write_perf_map(regex->native_code.code, size, regex, NULL, NULL, 0, &regex->allocator);
+    }
+
+    return 1;
+  }
+
+  if (regex->native_code.threshold != 0) {
+    return 1;
+  }
+
+  regex->native_code.code = compile_to_native(&regex->native_code.size,
+                                              regex->native_code.entry_points,
+                                              &regex->native_code.features,
+                                              regex,
+                                              &regex->allocator);
+
+  return regex->native_code.code != NULL;
+}
+
+#endif
+
 /** Public API **/
 
 #if defined(__GNUC__) || defined(__clang__)
@@ -236,21 +372,27 @@ PUBLIC regex_t *crex_compile_with_allocator(status_t *status,
   regex->n_classes = classes.size;
   regex->classes = classes.buffer;
 
-  // Stash the free part of the allocator, so it doesn't need to be passed into crex_regex_destroy
-  regex->allocator.context = allocator->context;
-  regex->allocator.free = allocator->free;
+  regex->n_patterns = 0;
+  regex->cache_entry = NULL;
+  regex->parallel_dfa = NULL;
+
+  // Stash the allocator, so it doesn't need to be passed into crex_regex_destroy
+  regex->allocator = *allocator;
 
 #ifdef NATIVE_COMPILER
-  *status = compile_to_native(regex, allocator);
+  if (!initialize_native_code(regex, NULL, 0, NULL, 0)) {
+    *status = CREX_E_NOMEM;
 
-  if (*status != CREX_OK) {
     FREE(allocator, regex->classes);
     FREE(allocator, regex->bytecode.code);
     FREE(allocator, regex);
+
     return NULL;
   }
 #endif
 
+  *status = CREX_OK;
+
   return regex;
 }
 
@@ -278,6 +420,12 @@ PUBLIC context_t *crex_create_context_with_allocator(crex_status_t *status,
   context->capacity = 0;
   context->allocator = *allocator;
 
+  context->prev_character = -1;
+  context->iterator.regex = NULL;
+
+  context->set.accepts = NULL;
+  context->set.capacity = 0;
+
   if (status != NULL) {
     *status = CREX_OK;
   }
@@ -294,13 +442,14 @@ PUBLIC void crex_destroy_regex(regex_t *regex) {
     return;
   }
 
-  // regex->allocator isn't actually an allocator (it's missing alloc) but our macros don't care
-
   FREE(&regex->allocator, regex->bytecode.code);
   FREE(&regex->allocator, regex->classes);
+  destroy_parallel_dfa(regex->parallel_dfa, &regex->allocator);
 
 #ifdef NATIVE_COMPILER
-  munmap(regex->native_code.code, regex->native_code.size);
+  if (regex->native_code.code != NULL) {
+    free_native_code(regex->native_code.code, regex->native_code.size);
+  }
 #endif
 
   FREE(&regex->allocator, regex);
@@ -313,67 +462,232 @@ PUBLIC void crex_destroy_context(context_t *context) {
 
   const allocator_t *allocator = &context->allocator;
   FREE(allocator, context->buffer);
+  FREE(allocator, context->set.accepts);
   FREE(allocator, context);
 }
 
-#ifndef NATIVE_COMPILER
-
 #include "executor.c"
 
-PUBLIC crex_status_t crex_is_match(int *is_match,
-                                   crex_context_t *context,
-                                   const crex_regex_t *regex,
-                                   const char *str,
-                                   size_t size) {
-  return execute_regex(is_match, context, regex, str, size, 0);
-}
-
-PUBLIC crex_status_t crex_find(crex_match_t *match,
-                               crex_context_t *context,
-                               const crex_regex_t *regex,
-                               const char *str,
-                               size_t size) {
-  return execute_regex(match, context, regex, str, size, 2);
-}
+#ifndef NATIVE_COMPILER
 
-PUBLIC crex_status_t crex_match_groups(crex_match_t *matches,
-                                       crex_context_t *context,
-                                       const crex_regex_t *regex,
-                                       const char *str,
-                                       size_t size) {
-  return execute_regex(matches, context, regex, str, size, 2 * regex->n_capturing_groups);
+WUR static status_t run_regex(void *result,
+                              context_t *context,
+                              const regex_t *regex,
+                              const char *str,
+                              size_t size,
+                              int prev_character,
+                              size_t n_pointers) {
+  return execute_regex(result, context, regex, str, size, prev_character, n_pointers);
 }
 
 #else
 
 typedef status_t (*native_function_t)(
-    void *, context_t *, const char *, const char *, size_t, const unsigned char *);
+    void *, context_t *, const char *, const char *, const unsigned char *, const unsigned char *);
+
+WUR static native_function_t
+native_entry_point(const regex_t *regex, void *code, size_t n_pointers) {
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+  // N.B. if the regex has no explicit capturing groups, a group query yields 2 pointers, and so
+  // is a find
+  const native_mode_t mode =
+      (n_pointers == 0) ? NM_IS_MATCH : ((n_pointers == 2) ? NM_FIND : NM_GROUPS);
+
+  const unsigned char *entry_point = (unsigned char *)code + regex->native_code.entry_points[mode];
+  const native_function_t function = (native_function_t)entry_point;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+  return function;
+}
 
 WUR static status_t call_regex_native_code(void *result,
                                            crex_context_t *context,
                                            const crex_regex_t *regex,
+                                           void *code,
                                            const char *str,
                                            size_t size,
+                                           int prev_character,
                                            size_t n_pointers) {
-#if defined(__GNUC__) || defined(__clang__)
-#pragma GCC diagnostic ignored "-Wpedantic"
+  const native_function_t function = native_entry_point(regex, code, n_pointers);
+
+  context->prev_character = prev_character;
+
+  return (*function)(result,
+                     context,
+                     str,
+                     str + size,
+                     (unsigned char *)regex->classes,
+                     (unsigned char *)builtin_classes);
+}
+
+// Yield the native code for regex, compiling it first if the regex has now been executed often
+// enough. Yields NULL if the regex should (for now) be executed on the VM
+WUR static void *get_native_code(const regex_t *regex) {
+#ifdef DEFERRED_NATIVE_COMPILER
+  // The native code is part of the regex's lazily-computed state rather than its value, so it's
+  // fair game to modify even though the regex is const
+  regex_t *mutable_regex = (regex_t *)regex;
+
+  void *code = __atomic_load_n(&mutable_regex->native_code.code, __ATOMIC_ACQUIRE);
+
+  if (code != NULL) {
+    return code;
+  }
+
+  const size_t n_executions =
+      __atomic_add_fetch(&mutable_regex->native_code.n_executions, 1, __ATOMIC_RELAXED);
+
+  if (n_executions <= regex->native_code.threshold) {
+    return NULL;
+  }
+
+  // Only one thread does the compilation; the others carry on with the VM in the meantime. On
+  // success, compiling is left set so that no other thread tries again
+  if (__atomic_exchange_n(&mutable_regex->native_code.compiling, 1, __ATOMIC_ACQUIRE)) {
+    return NULL;
+  }
+
+  size_t size;
+  size_t entry_points[N_NATIVE_MODES];
+  unsigned int features;
+  code = compile_to_native(&size, entry_points, &features, regex, &regex->allocator);
+
+  if (code == NULL) {
+    // Out of memory; try again after another threshold executions
+    __atomic_store_n(&mutable_regex->native_code.n_executions, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&mutable_regex->native_code.compiling, 0, __ATOMIC_RELEASE);
+    return NULL;
+  }
+
+  mutable_regex->native_code.size = size;
+  memcpy(mutable_regex->native_code.entry_points, entry_points, sizeof(entry_points));
+  mutable_regex->native_code.features = features;
+  __atomic_store_n(&mutable_regex->native_code.code, code, __ATOMIC_RELEASE);
+
+  return code;
+#else
+  return regex->native_code.code;
 #endif
+}
+
+WUR static status_t run_regex(void *result,
+                              context_t *context,
+                              const regex_t *regex,
+                              const char *str,
+                              size_t size,
+                              int prev_character,
+                              size_t n_pointers) {
+  void *code = get_native_code(regex);
+
+  if (code == NULL) {
+    return execute_regex(result, context, regex, str, size, prev_character, n_pointers);
+  }
 
-  const native_function_t function = (native_function_t)(regex->native_code.code);
+  return call_regex_native_code(
+      result, context, regex, code, str, size, prev_character, n_pointers);
+}
 
-#if defined(__GNUC__) || defined(__clang__)
-#pragma GCC diagnostic pop
 #endif
 
-  return (*function)(result, context, str, str + size, n_pointers, (unsigned char *)regex->classes);
+// Run the regex over each input in turn, putting each input's result (of result_size bytes) in
+// results. The VM, or the native code's entry point, is set up once for the whole batch rather than
+// once per input, and each input is prefetched while its predecessor is searched
+WUR static status_t run_regex_batch(void *results,
+                                    size_t result_size,
+                                    context_t *context,
+                                    const regex_t *regex,
+                                    const input_t *inputs,
+                                    size_t n_inputs,
+                                    size_t n_pointers) {
+  unsigned char *result = results;
+
+  vm_t vm;
+  int has_vm = 0;
+
+#ifdef NATIVE_COMPILER
+  native_function_t function = NULL;
+#endif
+
+  for (size_t i = 0; i < n_inputs; i++, result += result_size) {
+    if (i + 1 < n_inputs) {
+      PREFETCH(inputs[i + 1].str);
+    }
+
+    status_t status;
+
+#ifdef NATIVE_COMPILER
+    // Native compilation may be deferred (see get_native_code), in which case it can kick in part
+    // of the way through the batch. The native code might then reallocate the context's buffer,
+    // but the VM is never used again
+    if (function == NULL) {
+      void *code = get_native_code(regex);
+
+      if (code != NULL) {
+        function = native_entry_point(regex, code, n_pointers);
+        context->prev_character = -1;
+      }
+    }
+
+    if (function != NULL) {
+      status = (*function)(result,
+                           context,
+                           inputs[i].str,
+                           inputs[i].str + inputs[i].size,
+                           (unsigned char *)regex->classes,
+                           (unsigned char *)builtin_classes);
+
+      if (status != CREX_OK) {
+        return status;
+      }
+
+      continue;
+    }
+#endif
+
+    if (has_vm) {
+      reset_vm(&vm);
+    } else if (create_vm(&vm, context, regex, n_pointers, 0)) {
+      has_vm = 1;
+    } else {
+      return CREX_E_NOMEM;
+    }
+
+    status = run_vm(result, &vm, inputs[i].str, inputs[i].size, -1);
+
+    if (status != CREX_OK) {
+      return status;
+    }
+  }
+
+  return CREX_OK;
 }
 
+WUR static status_t next_match(match_t *matches, context_t *context, size_t n_pointers);
+
+#include "dump.c"
+#include "regex-set.c"
+#include "stream.c"
+#include "parallel.c"
+#include "replace.c"
+#include "lines.c"
+#include "cache.c"
+#include "context-pool.c"
+#include "database.c"
+#include "c-generator.c"
+
 PUBLIC crex_status_t crex_is_match(int *is_match,
                                    crex_context_t *context,
                                    const crex_regex_t *regex,
                                    const char *str,
                                    size_t size) {
-  return call_regex_native_code(is_match, context, regex, str, size, 0);
+  return run_regex(is_match, context, regex, str, size, -1, 0);
 }
 
 PUBLIC crex_status_t crex_find(crex_match_t *match,
@@ -381,7 +695,7 @@ PUBLIC crex_status_t crex_find(crex_match_t *match,
                                const crex_regex_t *regex,
                                const char *str,
                                size_t size) {
-  return call_regex_native_code(match, context, regex, str, size, 2);
+  return run_regex(match, context, regex, str, size, -1, 2);
 }
 
 PUBLIC crex_status_t crex_match_groups(crex_match_t *matches,
@@ -389,10 +703,48 @@ PUBLIC crex_status_t crex_match_groups(crex_match_t *matches,
                                        const crex_regex_t *regex,
                                        const char *str,
                                        size_t size) {
-  return call_regex_native_code(matches, context, regex, str, size, 2 * regex->n_capturing_groups);
+  return run_regex(matches, context, regex, str, size, -1, 2 * regex->n_capturing_groups);
 }
 
-#endif
+// Batches are equivalent to searching each input in turn, but have less overhead per input. On
+// failure, the results for the inputs before the one that failed are still populated
+
+PUBLIC status_t crex_is_match_batch(int *is_match,
+                                    context_t *context,
+                                    const regex_t *regex,
+                                    const input_t *inputs,
+                                    size_t n_inputs) {
+  return run_regex_batch(is_match, sizeof(int), context, regex, inputs, n_inputs, 0);
+}
+
+PUBLIC status_t crex_find_batch(match_t *matches,
+                                context_t *context,
+                                const regex_t *regex,
+                                const input_t *inputs,
+                                size_t n_inputs) {
+  return run_regex_batch(matches, sizeof(match_t), context, regex, inputs, n_inputs, 2);
+}
+
+// Parallel searches split the input between n_threads threads (or one per processor, if n_threads
+// is 0), but are otherwise equivalent to crex_is_match and crex_find
+
+PUBLIC status_t crex_is_match_parallel(int *is_match,
+                                       context_t *context,
+                                       const regex_t *regex,
+                                       const char *str,
+                                       size_t size,
+                                       size_t n_threads) {
+  return run_regex_parallel(is_match, context, regex, str, size, 0, n_threads);
+}
+
+PUBLIC status_t crex_find_parallel(match_t *match,
+                                   context_t *context,
+                                   const regex_t *regex,
+                                   const char *str,
+                                   size_t size,
+                                   size_t n_threads) {
+  return run_regex_parallel(match, context, regex, str, size, 2, n_threads);
+}
 
 PUBLIC status_t crex_is_match_str(int *is_match,
                                   context_t *context,
@@ -415,6 +767,488 @@ PUBLIC status_t crex_match_groups_str(match_t *matches,
   return crex_match_groups(matches, context, regex, str, strlen(str));
 }
 
+// crex_find_all begins an iteration over the successive non-overlapping matches of a regex in a
+// string, whose state lives in the context; each call to crex_next_match{,_groups} resumes the
+// search where the previous match ended, with that match's last character as the previous
+// character (so that e.g. \b and ^ behave as they would in a single search). An empty match
+// immediately following the previous match isn't reported; instead, the search resumes one
+// character later. Once the matches are exhausted, the result is filled with NULLs
+
+PUBLIC void
+crex_find_all(context_t *context, const regex_t *regex, const char *str, size_t size) {
+  context->iterator.regex = regex;
+  context->iterator.str = str;
+  context->iterator.eof = str + size;
+  context->iterator.position = str;
+  context->iterator.last_match_end = NULL;
+}
+
+PUBLIC void crex_find_all_str(context_t *context, const regex_t *regex, const char *str) {
+  crex_find_all(context, regex, str, strlen(str));
+}
+
+WUR static status_t next_match(match_t *matches, context_t *context, size_t n_pointers) {
+  const regex_t *regex = context->iterator.regex;
+  assert(regex != NULL);
+
+  const char *eof = context->iterator.eof;
+
+  for (;;) {
+    const char *position = context->iterator.position;
+
+    if (position == NULL) {
+      for (size_t i = 0; i < n_pointers / 2; i++) {
+        matches[i].begin = NULL;
+        matches[i].end = NULL;
+      }
+
+      return CREX_OK;
+    }
+
+    const int prev_character =
+        (position == context->iterator.str) ? -1 : (unsigned char)position[-1];
+
+    const status_t status =
+        run_regex(matches, context, regex, position, eof - position, prev_character, n_pointers);
+
+    if (status != CREX_OK) {
+      return status;
+    }
+
+    if (matches[0].begin == NULL) {
+      context->iterator.position = NULL;
+      return CREX_OK;
+    }
+
+    if (matches[0].begin == matches[0].end && matches[0].end == context->iterator.last_match_end) {
+      context->iterator.position = (matches[0].end == eof) ? NULL : matches[0].end + 1;
+      continue;
+    }
+
+    context->iterator.position = matches[0].end;
+    context->iterator.last_match_end = matches[0].end;
+
+    return CREX_OK;
+  }
+}
+
+PUBLIC status_t crex_next_match(match_t *match, context_t *context) {
+  return next_match(match, context, 2);
+}
+
+PUBLIC status_t crex_next_match_groups(match_t *matches, context_t *context) {
+  return next_match(matches, context, 2 * context->iterator.regex->n_capturing_groups);
+}
+
+// Yields the fields between the successive matches of the regex (as found by crex_find_all, whose
+// state in the context this clobbers) to the callback, which returns 0 to stop early. The last of
+// at most max_fields fields runs to the end of the string, whatever it contains
+WUR static status_t split(context_t *context,
+                          const regex_t *regex,
+                          const char *str,
+                          size_t size,
+                          size_t max_fields,
+                          split_callback_t callback,
+                          void *callback_context) {
+  if (max_fields == 0) {
+    return CREX_OK;
+  }
+
+  crex_find_all(context, regex, str, size);
+
+  match_t field;
+  field.begin = str;
+
+  for (size_t n_fields = 1; n_fields < max_fields; n_fields++) {
+    match_t match;
+    const status_t status = next_match(&match, context, 2);
+
+    if (status != CREX_OK) {
+      return status;
+    }
+
+    if (match.begin == NULL) {
+      break;
+    }
+
+    field.end = match.begin;
+
+    if (!(*callback)(callback_context, &field)) {
+      return CREX_OK;
+    }
+
+    field.begin = match.end;
+  }
+
+  field.end = str + size;
+  (*callback)(callback_context, &field);
+
+  return CREX_OK;
+}
+
+typedef struct {
+  match_t *fields;
+  size_t n_fields;
+} split_fields_t;
+
+static int split_into_fields(void *callback_context, const match_t *field) {
+  split_fields_t *fields = callback_context;
+  fields->fields[fields->n_fields++] = *field;
+  return 1;
+}
+
+// crex_split writes at most max_fields fields, so an unlimited split needs room for one more field
+// than there are matches; crex_split_each instead yields every field to a callback
+
+PUBLIC status_t crex_split(match_t *fields,
+                           size_t *n_fields,
+                           size_t max_fields,
+                           context_t *context,
+                           const regex_t *regex,
+                           const char *str,
+                           size_t size) {
+  split_fields_t result = {fields, 0};
+
+  const status_t status =
+      split(context, regex, str, size, max_fields, split_into_fields, &result);
+
+  *n_fields = result.n_fields;
+
+  return status;
+}
+
+PUBLIC status_t crex_split_str(match_t *fields,
+                               size_t *n_fields,
+                               size_t max_fields,
+                               context_t *context,
+                               const regex_t *regex,
+                               const char *str) {
+  return crex_split(fields, n_fields, max_fields, context, regex, str, strlen(str));
+}
+
+PUBLIC status_t crex_split_each(context_t *context,
+                                const regex_t *regex,
+                                const char *str,
+                                size_t size,
+                                split_callback_t callback,
+                                void *callback_context) {
+  return split(context, regex, str, size, SIZE_MAX, callback, callback_context);
+}
+
+PUBLIC status_t crex_split_each_str(context_t *context,
+                                    const regex_t *regex,
+                                    const char *str,
+                                    split_callback_t callback,
+                                    void *callback_context) {
+  return split(context, regex, str, strlen(str), SIZE_MAX, callback, callback_context);
+}
+
+// crex_match_lines yields each line of the string which contains a match (without its '\n') to the
+// callback, which returns 0 to stop early; see lines.c
+
+PUBLIC status_t crex_match_lines(context_t *context,
+                                 const regex_t *regex,
+                                 const char *str,
+                                 size_t size,
+                                 line_callback_t callback,
+                                 void *callback_context) {
+  return match_lines(context, regex, str, size, callback, callback_context);
+}
+
+PUBLIC status_t crex_match_lines_str(context_t *context,
+                                     const regex_t *regex,
+                                     const char *str,
+                                     line_callback_t callback,
+                                     void *callback_context) {
+  return match_lines(context, regex, str, strlen(str), callback, callback_context);
+}
+
+PUBLIC status_t crex_stream_begin(context_t *context,
+                                  const regex_t *regex,
+                                  crex_stream_mode_t mode) {
+  size_t n_pointers;
+
+  switch (mode) {
+  case CREX_STREAM_IS_MATCH:
+    n_pointers = 0;
+    break;
+
+  case CREX_STREAM_FIND:
+    n_pointers = 2;
+    break;
+
+  case CREX_STREAM_GROUPS:
+    n_pointers = 2 * regex->n_capturing_groups;
+    break;
+
+  default:
+    assert(0);
+    n_pointers = 0;
+  }
+
+  return begin_stream(context, regex, n_pointers);
+}
+
+PUBLIC status_t crex_stream_feed(context_t *context, const char *chunk, size_t size) {
+  return feed_stream(context, chunk, size);
+}
+
+PUBLIC status_t crex_stream_end(int *is_match, span_t *spans, context_t *context) {
+  return end_stream(is_match, spans, context);
+}
+
+PUBLIC regex_set_t *crex_compile_regex_set(status_t *status,
+                                           const char *const *patterns,
+                                           const size_t *sizes,
+                                           size_t n_patterns) {
+  return crex_compile_regex_set_with_allocator(
+      status, patterns, sizes, n_patterns, &default_allocator);
+}
+
+PUBLIC regex_set_t *
+crex_compile_regex_set_str(status_t *status, const char *const *patterns, size_t n_patterns) {
+  return compile_regex_set(status, patterns, NULL, n_patterns, &default_allocator);
+}
+
+PUBLIC regex_set_t *crex_compile_regex_set_with_allocator(status_t *status,
+                                                          const char *const *patterns,
+                                                          const size_t *sizes,
+                                                          size_t n_patterns,
+                                                          const allocator_t *allocator) {
+  if (allocator == NULL) {
+    allocator = &default_allocator;
+  }
+
+  assert(sizes != NULL || n_patterns == 0);
+
+  return compile_regex_set(status, patterns, sizes, n_patterns, allocator);
+}
+
+PUBLIC size_t crex_regex_set_n_patterns(const regex_set_t *set) {
+  return set->regex.n_patterns;
+}
+
+PUBLIC void crex_destroy_regex_set(regex_set_t *set) {
+  if (set == NULL) {
+    return;
+  }
+
+  destroy_regex_set(set);
+}
+
+// The result of crex_regex_set_is_match is a bitmap, with one bit per pattern (in the order in
+// which the patterns were given), least significant bit first; crex_regex_set_match_indices instead
+// yields the indices of the patterns which match, in increasing order, and indices must have room
+// for all of the set's patterns
+
+PUBLIC status_t crex_regex_set_is_match(unsigned char *is_match,
+                                        context_t *context,
+                                        const regex_set_t *set,
+                                        const char *str,
+                                        size_t size) {
+  const unsigned char *accepts;
+  const status_t status = run_regex_set(&accepts, context, set, str, size);
+
+  if (status != CREX_OK) {
+    return status;
+  }
+
+  safe_memcpy(is_match, accepts, bitmap_size_for_bits(set->regex.n_patterns));
+
+  return CREX_OK;
+}
+
+PUBLIC status_t crex_regex_set_is_match_str(unsigned char *is_match,
+                                            context_t *context,
+                                            const regex_set_t *set,
+                                            const char *str) {
+  return crex_regex_set_is_match(is_match, context, set, str, strlen(str));
+}
+
+PUBLIC status_t crex_regex_set_match_indices(size_t *indices,
+                                             size_t *n_matches,
+                                             context_t *context,
+                                             const regex_set_t *set,
+                                             const char *str,
+                                             size_t size) {
+  const unsigned char *accepts;
+  const status_t status = run_regex_set(&accepts, context, set, str, size);
+
+  if (status != CREX_OK) {
+    return status;
+  }
+
+  *n_matches = 0;
+
+  for (size_t i = 0; i < set->regex.n_patterns; i++) {
+    if (bitmap_test(accepts, i)) {
+      indices[(*n_matches)++] = i;
+    }
+  }
+
+  return CREX_OK;
+}
+
+PUBLIC status_t crex_regex_set_match_indices_str(size_t *indices,
+                                                 size_t *n_matches,
+                                                 context_t *context,
+                                                 const regex_set_t *set,
+                                                 const char *str) {
+  return crex_regex_set_match_indices(indices, n_matches, context, set, str, strlen(str));
+}
+
+// A pool retains at most max_shared idle contexts beyond the one cached by each thread, and frees
+// the buffer of any released context whose buffer has grown beyond max_buffer_size bytes. Contexts
+// acquired from a pool must be released to it (on any thread), rather than destroyed
+
+PUBLIC context_pool_t *
+crex_create_context_pool(status_t *status, size_t max_shared, size_t max_buffer_size) {
+  return create_context_pool(status, max_shared, max_buffer_size, &default_allocator);
+}
+
+PUBLIC context_pool_t *crex_create_context_pool_with_allocator(status_t *status,
+                                                               size_t max_shared,
+                                                               size_t max_buffer_size,
+                                                               const allocator_t *allocator) {
+  if (allocator == NULL) {
+    allocator = &default_allocator;
+  }
+
+  return create_context_pool(status, max_shared, max_buffer_size, allocator);
+}
+
+PUBLIC void crex_destroy_context_pool(context_pool_t *pool) {
+  if (pool == NULL) {
+    return;
+  }
+
+  destroy_context_pool(pool);
+}
+
+PUBLIC context_t *crex_acquire_context(status_t *status, context_pool_t *pool) {
+  return acquire_context(status, pool);
+}
+
+PUBLIC void crex_release_context(context_pool_t *pool, context_t *context) {
+  if (context == NULL) {
+    return;
+  }
+
+  release_context(pool, context);
+}
+
+PUBLIC void crex_context_pool_stats(context_pool_stats_t *stats, context_pool_t *pool) {
+  context_pool_stats(stats, pool);
+}
+
+// A cache holds at most (roughly) capacity regexes. Each regex yielded by crex_cache_get must be
+// released with crex_cache_release, and must not be destroyed with crex_destroy_regex; all of them
+// must be released before the cache is destroyed. The cache may be shared between threads
+
+PUBLIC cache_t *crex_create_cache(status_t *status, size_t capacity) {
+  return create_cache(status, capacity, &default_allocator);
+}
+
+PUBLIC cache_t *crex_create_cache_with_allocator(status_t *status,
+                                                 size_t capacity,
+                                                 const allocator_t *allocator) {
+  if (allocator == NULL) {
+    allocator = &default_allocator;
+  }
+
+  return create_cache(status, capacity, allocator);
+}
+
+PUBLIC void crex_destroy_cache(cache_t *cache) {
+  if (cache == NULL) {
+    return;
+  }
+
+  destroy_cache(cache);
+}
+
+PUBLIC const regex_t *
+crex_cache_get(status_t *status, cache_t *cache, const char *pattern, size_t size) {
+  return cache_get(status, cache, pattern, size);
+}
+
+PUBLIC const regex_t *crex_cache_get_str(status_t *status, cache_t *cache, const char *pattern) {
+  return cache_get(status, cache, pattern, strlen(pattern));
+}
+
+PUBLIC void crex_cache_release(cache_t *cache, const regex_t *regex) {
+  cache_release(cache, regex);
+}
+
+PUBLIC template_t *crex_compile_template(status_t *status, const char *tmpl, size_t size) {
+  return compile_template(status, tmpl, size, &default_allocator);
+}
+
+PUBLIC template_t *crex_compile_template_str(status_t *status, const char *tmpl) {
+  return compile_template(status, tmpl, strlen(tmpl), &default_allocator);
+}
+
+PUBLIC template_t *crex_compile_template_with_allocator(status_t *status,
+                                                        const char *tmpl,
+                                                        size_t size,
+                                                        const allocator_t *allocator) {
+  if (allocator == NULL) {
+    allocator = &default_allocator;
+  }
+
+  return compile_template(status, tmpl, size, allocator);
+}
+
+PUBLIC void crex_destroy_template(template_t *tmpl) {
+  if (tmpl == NULL) {
+    return;
+  }
+
+  destroy_template(tmpl);
+}
+
+// The result is appended to the output, which may initially be empty ({NULL, 0, 0}). The output's
+// buffer is grown with the context's allocator, and so must be freed with it too. On failure, the
+// output may hold part of the result
+
+PUBLIC status_t crex_replace(output_t *output,
+                             context_t *context,
+                             const regex_t *regex,
+                             const template_t *tmpl,
+                             const char *str,
+                             size_t size) {
+  return replace(output, context, regex, tmpl, str, size, 0);
+}
+
+PUBLIC status_t crex_replace_str(output_t *output,
+                                 context_t *context,
+                                 const regex_t *regex,
+                                 const template_t *tmpl,
+                                 const char *str) {
+  return replace(output, context, regex, tmpl, str, strlen(str), 0);
+}
+
+PUBLIC status_t crex_replace_all(output_t *output,
+                                 context_t *context,
+                                 const regex_t *regex,
+                                 const template_t *tmpl,
+                                 const char *str,
+                                 size_t size) {
+  return replace(output, context, regex, tmpl, str, size, 1);
+}
+
+PUBLIC status_t crex_replace_all_str(output_t *output,
+                                     context_t *context,
+                                     const regex_t *regex,
+                                     const template_t *tmpl,
+                                     const char *str) {
+  return replace(output, context, regex, tmpl, str, strlen(str), 1);
+}
+
+PUBLIC status_t crex_generate_c(output_t *output, const regex_t *regex, const char *name) {
+  return generate_c(output, regex, name);
+}
+
 PUBLIC unsigned char *crex_dump_regex(status_t *status, size_t *size, const regex_t *regex) {
   return crex_dump_regex_with_allocator(status, size, regex, &default_allocator);
 }
@@ -423,12 +1257,22 @@ PUBLIC unsigned char *crex_dump_regex_with_allocator(status_t *status,
                                                      size_t *size,
                                                      const regex_t *regex,
                                                      const allocator_t *allocator) {
-  // FIXME: reimplement this later
-  (void)status;
-  (void)size;
-  (void)regex;
-  (void)allocator;
-  return NULL;
+  if (allocator == NULL) {
+    allocator = &default_allocator;
+  }
+
+  return dump_regex(status, size, regex, 0, allocator);
+}
+
+PUBLIC unsigned char *crex_dump_regex_with_native_code(status_t *status,
+                                                       size_t *size,
+                                                       const regex_t *regex,
+                                                       const allocator_t *allocator) {
+  if (allocator == NULL) {
+    allocator = &default_allocator;
+  }
+
+  return dump_regex(status, size, regex, 1, allocator);
 }
 
 PUBLIC regex_t *crex_load_regex(status_t *status, unsigned char *buffer, size_t size) {
@@ -439,12 +1283,75 @@ PUBLIC regex_t *crex_load_regex_with_allocator(status_t *status,
                                                unsigned char *buffer,
                                                size_t size,
                                                const allocator_t *allocator) {
-  // FIXME: reimplement this later
-  (void)status;
-  (void)buffer;
-  (void)size;
-  (void)allocator;
-  return NULL;
+  if (allocator == NULL) {
+    allocator = &default_allocator;
+  }
+
+  return load_regex(status, buffer, size, 0, allocator);
+}
+
+// Like crex_load_regex_with_allocator, but uses any native code in the dump (see
+// crex_dump_regex_with_native_code) rather than compiling the regex anew. The native code is run
+// as-is, so the buffer must come from a trusted source: a crafted dump could run arbitrary code
+PUBLIC regex_t *crex_load_trusted_regex_with_native_code(status_t *status,
+                                                         unsigned char *buffer,
+                                                         size_t size,
+                                                         const allocator_t *allocator) {
+  if (allocator == NULL) {
+    allocator = &default_allocator;
+  }
+
+  return load_regex(status, buffer, size, 1, allocator);
+}
+
+PUBLIC unsigned char *crex_dump_database(status_t *status,
+                                         size_t *size,
+                                         const regex_t *const *regexes,
+                                         size_t n_regexes) {
+  return crex_dump_database_with_allocator(status, size, regexes, n_regexes, &default_allocator);
+}
+
+PUBLIC unsigned char *crex_dump_database_with_allocator(status_t *status,
+                                                        size_t *size,
+                                                        const regex_t *const *regexes,
+                                                        size_t n_regexes,
+                                                        const allocator_t *allocator) {
+  if (allocator == NULL) {
+    allocator = &default_allocator;
+  }
+
+  return dump_database(status, size, regexes, n_regexes, allocator);
+}
+
+PUBLIC database_t *crex_open_database(status_t *status, const void *buffer, size_t size) {
+  return crex_open_database_with_allocator(status, buffer, size, &default_allocator);
+}
+
+PUBLIC database_t *crex_open_database_with_allocator(status_t *status,
+                                                     const void *buffer,
+                                                     size_t size,
+                                                     const allocator_t *allocator) {
+  if (allocator == NULL) {
+    allocator = &default_allocator;
+  }
+
+  return open_database(status, buffer, size, allocator);
+}
+
+PUBLIC void crex_close_database(database_t *database) {
+  if (database == NULL) {
+    return;
+  }
+
+  close_database(database);
+}
+
+PUBLIC size_t crex_database_n_regexes(const database_t *database) {
+  return database->n_regexes;
+}
+
+PUBLIC const regex_t *crex_database_regex(status_t *status, database_t *database, size_t index) {
+  return database_regex(status, database, index);
 }
 
 #include "debug.c"
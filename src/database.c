@@ -0,0 +1,370 @@
+// A database of many regexes, laid out so that it can be executed in place, e.g. from a read-only
+// mapping of a file shared by several processes. A database is encoded as:
+// - the magic string "crxd"
+// - DB_N_FIELDS little-endian 32-bit header fields, as enumerated below
+// - an index, with DBI_N_FIELDS little-endian 32-bit fields for each regex
+// - the regexes' character classes, beginning on a DATABASE_CLASS_ALIGNMENT boundary
+// - the regexes' bytecode, each beginning on a DATABASE_BYTECODE_ALIGNMENT boundary
+//
+// All offsets are from the beginning of the database, so it can be mapped anywhere (though the
+// alignment of the sections is only meaningful if the database itself is suitably aligned, as a
+// mapping is). Bytecode operands are in the byte order of the host that dumped the database, and
+// since executing in place means they can't be swapped, only a host of the same byte order can open
+// it.
+//
+// Opening a database only checks its header and allocates a pointer for each regex, so it touches
+// none of the regexes themselves. Each regex is validated (as for crex_load_regex) and compiled to
+// native code (unless that's deferred) the first time it's looked up; its classes and bytecode are
+// never copied
+
+#define DATABASE_MAGIC "crxd"
+#define DATABASE_MAGIC_SIZE 4
+
+#define DATABASE_VERSION 1
+
+#define DATABASE_CLASS_ALIGNMENT 32
+#define DATABASE_BYTECODE_ALIGNMENT 8
+
+enum { DB_VERSION, DB_BYTE_ORDER, DB_N_REGEXES, DB_N_FIELDS };
+
+enum {
+  DBI_N_CAPTURING_GROUPS,
+  DBI_N_CLASSES,
+  DBI_N_FLAGS,
+  DBI_CLASSES_OFFSET,
+  DBI_BYTECODE_OFFSET,
+  DBI_BYTECODE_SIZE,
+  DBI_N_FIELDS
+};
+
+#define DATABASE_HEADER_SIZE (DATABASE_MAGIC_SIZE + 4 * DB_N_FIELDS)
+#define DATABASE_INDEX_ENTRY_SIZE (4 * DBI_N_FIELDS)
+
+#if defined(__GNUC__) || defined(__clang__)
+#define DATABASE_LOAD_VIEW(view) __atomic_load_n(&(view), __ATOMIC_ACQUIRE)
+#define DATABASE_STORE_VIEW(view, value) __atomic_store_n(&(view), (value), __ATOMIC_RELEASE)
+#else
+#define DATABASE_LOAD_VIEW(view) (view)
+#define DATABASE_STORE_VIEW(view, value) ((view) = (value))
+#endif
+
+struct crex_database {
+  const unsigned char *buffer;
+  size_t size;
+
+  size_t n_regexes;
+
+  // A regex for each entry of the index, referring to the database's classes and bytecode, or NULL
+  // if it hasn't been looked up yet. Created under mutex, and published atomically
+  regex_t **views;
+  pthread_mutex_t mutex;
+
+  allocator_t allocator;
+};
+
+static size_t align_up(size_t offset, size_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+WUR static unsigned char *dump_database(status_t *status,
+                                        size_t *size,
+                                        const regex_t *const *regexes,
+                                        size_t n_regexes,
+                                        const allocator_t *allocator) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  // Lay out the sections, checking that every offset and size fits in a field. All the sizes are
+  // bounded by the sizes of the corresponding buffers, so this could only conceivably fail for a
+  // ludicrously large database
+  const size_t index_offset = DATABASE_HEADER_SIZE;
+
+  if (n_regexes > (0xffffffffLU - index_offset) / DATABASE_INDEX_ENTRY_SIZE) {
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  const size_t classes_section =
+      align_up(index_offset + DATABASE_INDEX_ENTRY_SIZE * n_regexes, DATABASE_CLASS_ALIGNMENT);
+
+  size_t offset = classes_section;
+
+  for (size_t i = 0; i < n_regexes && offset <= 0xffffffffLU; i++) {
+    offset += sizeof(char_class_t) * regexes[i]->n_classes;
+  }
+
+  for (size_t i = 0; i < n_regexes && offset <= 0xffffffffLU; i++) {
+    offset = align_up(offset, DATABASE_BYTECODE_ALIGNMENT) + regexes[i]->bytecode.size;
+  }
+
+  if (offset > 0xffffffffLU) {
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  *size = offset;
+
+  unsigned char *buffer = ALLOC(allocator, *size);
+
+  if (buffer == NULL) {
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  // The padding between sections is zeroed, so that equal databases are dumped identically
+  memset(buffer, 0, *size);
+
+  memcpy(buffer, DATABASE_MAGIC, DATABASE_MAGIC_SIZE);
+
+  size_t fields[DB_N_FIELDS];
+
+  fields[DB_VERSION] = DATABASE_VERSION;
+  fields[DB_BYTE_ORDER] = host_byte_order();
+  fields[DB_N_REGEXES] = n_regexes;
+
+  for (size_t i = 0; i < DB_N_FIELDS; i++) {
+    serialize_operand_le(buffer + DATABASE_MAGIC_SIZE + 4 * i, fields[i], 4);
+  }
+
+  size_t classes_offset = classes_section;
+  size_t bytecode_offset = classes_section;
+
+  for (size_t i = 0; i < n_regexes; i++) {
+    bytecode_offset += sizeof(char_class_t) * regexes[i]->n_classes;
+  }
+
+  for (size_t i = 0; i < n_regexes; i++) {
+    const regex_t *regex = regexes[i];
+
+    const size_t classes_size = sizeof(char_class_t) * regex->n_classes;
+    bytecode_offset = align_up(bytecode_offset, DATABASE_BYTECODE_ALIGNMENT);
+
+    size_t entry[DBI_N_FIELDS];
+
+    entry[DBI_N_CAPTURING_GROUPS] = regex->n_capturing_groups;
+    entry[DBI_N_CLASSES] = regex->n_classes;
+    entry[DBI_N_FLAGS] = regex->n_flags;
+    entry[DBI_CLASSES_OFFSET] = classes_offset;
+    entry[DBI_BYTECODE_OFFSET] = bytecode_offset;
+    entry[DBI_BYTECODE_SIZE] = regex->bytecode.size;
+
+    unsigned char *data = buffer + index_offset + DATABASE_INDEX_ENTRY_SIZE * i;
+
+    for (size_t j = 0; j < DBI_N_FIELDS; j++) {
+      serialize_operand_le(data + 4 * j, entry[j], 4);
+    }
+
+    safe_memcpy(buffer + classes_offset, regex->classes, classes_size);
+    safe_memcpy(buffer + bytecode_offset, regex->bytecode.code, regex->bytecode.size);
+
+    classes_offset += classes_size;
+    bytecode_offset += regex->bytecode.size;
+  }
+
+  assert(bytecode_offset == *size);
+
+  *status = CREX_OK;
+
+  return buffer;
+}
+
+// The buffer must outlive the database, and mustn't change in the meantime
+WUR static database_t *open_database(status_t *status,
+                                     const unsigned char *buffer,
+                                     size_t size,
+                                     const allocator_t *allocator) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  if (size < DATABASE_HEADER_SIZE || memcmp(buffer, DATABASE_MAGIC, DATABASE_MAGIC_SIZE) != 0) {
+    *status = CREX_E_BAD_DUMP;
+    return NULL;
+  }
+
+  size_t fields[DB_N_FIELDS];
+
+  for (size_t i = 0; i < DB_N_FIELDS; i++) {
+    fields[i] = deserialize_operand_le(buffer + DATABASE_MAGIC_SIZE + 4 * i, 4);
+  }
+
+  const size_t n_regexes = fields[DB_N_REGEXES];
+
+  if (fields[DB_VERSION] != DATABASE_VERSION || fields[DB_BYTE_ORDER] != host_byte_order() ||
+      n_regexes > (size - DATABASE_HEADER_SIZE) / DATABASE_INDEX_ENTRY_SIZE) {
+    *status = CREX_E_BAD_DUMP;
+    return NULL;
+  }
+
+  database_t *database = ALLOC(allocator, sizeof(database_t));
+  regex_t **views = ALLOC(allocator, sizeof(regex_t *) * n_regexes);
+
+  if (database == NULL || (views == NULL && n_regexes != 0)) {
+    FREE(allocator, database);
+    FREE(allocator, views);
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  for (size_t i = 0; i < n_regexes; i++) {
+    views[i] = NULL;
+  }
+
+  database->buffer = buffer;
+  database->size = size;
+  database->n_regexes = n_regexes;
+  database->views = views;
+  database->allocator = *allocator;
+
+  pthread_mutex_init(&database->mutex, NULL);
+
+  *status = CREX_OK;
+
+  return database;
+}
+
+static void close_database(database_t *database) {
+  const allocator_t *allocator = &database->allocator;
+
+  for (size_t i = 0; i < database->n_regexes; i++) {
+    regex_t *regex = database->views[i];
+
+    if (regex == NULL) {
+      continue;
+    }
+
+    // The classes and bytecode belong to the buffer
+    destroy_parallel_dfa(regex->parallel_dfa, allocator);
+
+#ifdef NATIVE_COMPILER
+    if (regex->native_code.code != NULL) {
+      free_native_code(regex->native_code.code, regex->native_code.size);
+    }
+#endif
+
+    FREE(allocator, regex);
+  }
+
+  pthread_mutex_destroy(&database->mutex);
+
+  FREE(allocator, database->views);
+  FREE(allocator, database);
+}
+
+// Yields a regex referring to the classes and bytecode of the given entry of the index, having
+// validated them
+WUR static regex_t *create_database_view(status_t *status, database_t *database, size_t index) {
+  const allocator_t *allocator = &database->allocator;
+  const unsigned char *buffer = database->buffer;
+  const size_t size = database->size;
+
+  size_t entry[DBI_N_FIELDS];
+
+  for (size_t i = 0; i < DBI_N_FIELDS; i++) {
+    const size_t offset = DATABASE_HEADER_SIZE + DATABASE_INDEX_ENTRY_SIZE * index + 4 * i;
+    entry[i] = deserialize_operand_le(buffer + offset, 4);
+  }
+
+  const size_t classes_offset = entry[DBI_CLASSES_OFFSET];
+  const size_t classes_size = sizeof(char_class_t) * entry[DBI_N_CLASSES];
+  const size_t bytecode_offset = entry[DBI_BYTECODE_OFFSET];
+  const size_t bytecode_size = entry[DBI_BYTECODE_SIZE];
+
+  if (entry[DBI_N_CAPTURING_GROUPS] == 0 || entry[DBI_N_CAPTURING_GROUPS] > DUMP_MAX_COUNT ||
+      entry[DBI_N_FLAGS] > DUMP_MAX_COUNT || classes_offset > size ||
+      classes_size > size - classes_offset || bytecode_offset > size ||
+      bytecode_size > size - bytecode_offset) {
+    *status = CREX_E_BAD_DUMP;
+    return NULL;
+  }
+
+  regex_t *regex = ALLOC(allocator, sizeof(regex_t));
+  unsigned char *boundaries = ALLOC(allocator, bitmap_size_for_bits(bytecode_size + 1));
+
+  if (regex == NULL || boundaries == NULL) {
+    FREE(allocator, regex);
+    FREE(allocator, boundaries);
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  regex->n_capturing_groups = entry[DBI_N_CAPTURING_GROUPS];
+  regex->n_classes = entry[DBI_N_CLASSES];
+  regex->n_flags = entry[DBI_N_FLAGS];
+  regex->n_patterns = 0;
+  regex->cache_entry = NULL;
+  regex->parallel_dfa = NULL;
+
+  // Neither is ever written through the regex
+  regex->classes = (char_class_t *)(buffer + classes_offset);
+  regex->bytecode.size = bytecode_size;
+  regex->bytecode.code = (unsigned char *)(buffer + bytecode_offset);
+
+  regex->allocator = *allocator;
+
+  bitmap_clear(boundaries, bitmap_size_for_bits(bytecode_size + 1));
+
+  // Without swapping, scan_bytecode doesn't write to the bytecode either
+  *status = scan_bytecode(boundaries, regex->bytecode.code, bytecode_size, 0)
+                ? validate_bytecode(regex, boundaries, allocator)
+                : CREX_E_BAD_DUMP;
+
+  FREE(allocator, boundaries);
+
+  if (*status != CREX_OK) {
+    FREE(allocator, regex);
+    return NULL;
+  }
+
+#ifdef NATIVE_COMPILER
+  if (!initialize_native_code(regex, NULL, 0, NULL, 0)) {
+    *status = CREX_E_NOMEM;
+    FREE(allocator, regex);
+    return NULL;
+  }
+#endif
+
+  return regex;
+}
+
+// The regex belongs to the database, and mustn't be destroyed
+WUR static const regex_t *database_regex(status_t *status, database_t *database, size_t index) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  assert(index < database->n_regexes);
+
+  regex_t *regex = DATABASE_LOAD_VIEW(database->views[index]);
+
+  if (regex != NULL) {
+    *status = CREX_OK;
+    return regex;
+  }
+
+  pthread_mutex_lock(&database->mutex);
+
+  // Another thread may have created the view in the meantime
+  regex = database->views[index];
+
+  if (regex == NULL) {
+    regex = create_database_view(status, database, index);
+
+    if (regex != NULL) {
+      DATABASE_STORE_VIEW(database->views[index], regex);
+    }
+  } else {
+    *status = CREX_OK;
+  }
+
+  pthread_mutex_unlock(&database->mutex);
+
+  return regex;
+}
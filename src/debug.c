@@ -78,6 +78,9 @@ const char *opcode_to_str(unsigned char opcode) {
   case VM_TEST_AND_SET_FLAG:
     return "VM_TEST_AND_SET_FLAG";
 
+  case VM_ACCEPT:
+    return "VM_ACCEPT";
+
   default:
     assert(0);
     return NULL;
@@ -413,7 +416,8 @@ void crex_print_bytecode(const regex_t *regex, FILE *file) {
     }
 
     case VM_WRITE_POINTER:
-    case VM_TEST_AND_SET_FLAG: {
+    case VM_TEST_AND_SET_FLAG:
+    case VM_ACCEPT: {
       fprintf(file, " %zu\n", operand);
       break;
     }
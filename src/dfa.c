@@ -0,0 +1,759 @@
+// A DFA equivalent to a regex's program, for boolean searches. Each DFA state is the set of threads
+// waiting to consume the character at the current position, together with whatever the anchors in
+// the program need to know about the previous character. A transition on a character takes the
+// closure of those threads (plus a new thread, started at the current position) and yields either
+// a match or the set of threads that consumed the character. Because a boolean search doesn't care
+// which thread matches, the set is unordered, and duplicate threads (which the program's flags
+// would otherwise weed out) are simply merged. That's only sound if each flag is tested at a
+// single pc, so the DFA isn't built for programs in which some flag is shared between pcs.
+//
+// Characters which every instruction in the program treats alike are folded into byte classes, and
+// the DFA is only built if it's small; the caller falls back to simulating the program otherwise.
+//
+// The program for a regex set never matches as such; instead, each pattern in the set marks itself
+// as having matched with a VM_ACCEPT (see compile_set_pattern). In the DFA for such a program, the
+// patterns which match on a transition (or at the EOF) are attached to the transition rather than
+// to the state, so that the number of states doesn't multiply with the number of combinations of
+// patterns that might have matched
+
+// Transition targets other than DFA states
+#define DFA_MATCH SIZE_MAX
+#define DFA_NO_MATCH (SIZE_MAX - 1)
+
+#define MAX_DFA_STATES 512
+
+// Bounds the number of distinct sets of a regex set's patterns which match on some transition
+#define MAX_DFA_ACCEPT_SETS 1024
+
+// Bounds the size of the DFA, i.e. the number of states times the number of byte classes
+#define MAX_DFA_TRANSITIONS (32 * 1024)
+
+// Bounds the work done building the DFA, i.e. the number of transitions times the size of the
+// program
+#define MAX_DFA_WORK (4 * 1024 * 1024)
+
+// What the program's anchors need to know about the previous character
+enum { DFA_PREV_BOF = 1u << 0u, DFA_PREV_NEWLINE = 1u << 1u, DFA_PREV_WORD = 1u << 2u };
+
+typedef struct {
+  size_t n_states;
+  size_t n_byte_classes;
+
+  unsigned char byte_classes[256];
+
+  // transitions[n_byte_classes * state + byte_class] is DFA_MATCH, DFA_NO_MATCH, or a state.
+  // State 0 is the initial state at the beginning of the input
+  size_t *transitions;
+
+  // The initial state (or DFA_NO_MATCH) when the string is preceded by a character in each byte
+  // class, e.g. when resuming a search partway through the input
+  size_t initial_states[256];
+
+  // Whether each state matches at the EOF
+  unsigned char *eof_matches;
+
+  // Whether each state has no threads, i.e. whether a match can only begin at the current position
+  // or later
+  unsigned char *idle;
+
+  // The number of patterns, for a regex set's program (see regex_t). For a set, no transition is
+  // DFA_MATCH or DFA_NO_MATCH. Instead, accept_sets + accepts_size * i is the ith distinct bitmap
+  // of patterns which match on some transition (where the 0th is empty); transition_accepts and
+  // eof_accepts are the index of the patterns which match on each transition and at the EOF in
+  // each state; and finished[state] is whether no further pattern can match once in that state, in
+  // which case the search may as well stop
+  size_t n_patterns;
+  size_t accepts_size;
+  size_t n_accept_sets;
+  unsigned char *accept_sets;
+  size_t *transition_accepts;
+  size_t *eof_accepts;
+  unsigned char *finished;
+} dfa_t;
+
+// Scratch space for building a DFA
+typedef struct {
+  const regex_t *regex;
+
+  unsigned int prev_mask;
+
+  // Each state's key is its thread set, as a bitmap of bytecode indices, followed by its
+  // DFA_PREV_* flags
+  size_t key_size;
+  unsigned char *keys;
+
+  // Hash table of the keys (see dfa_intern)
+  size_t *table;
+
+  // For dfa_closure
+  size_t *stack;
+  unsigned char *visited;
+
+  // For a regex set, the patterns which match in dfa_closure, and the hash table of the DFA's
+  // accept_sets
+  unsigned char *accepts;
+  size_t *accept_sets_table;
+} dfa_builder_t;
+
+static void destroy_dfa(dfa_t *dfa, const allocator_t *allocator) {
+  FREE(allocator, dfa->transitions);
+  FREE(allocator, dfa->eof_matches);
+  FREE(allocator, dfa->idle);
+  FREE(allocator, dfa->accept_sets);
+  FREE(allocator, dfa->transition_accepts);
+  FREE(allocator, dfa->eof_accepts);
+  FREE(allocator, dfa->finished);
+}
+
+static unsigned int dfa_prev_flags(const dfa_builder_t *builder, int character) {
+  unsigned int flags = 0;
+
+  if (character == -1) {
+    flags |= DFA_PREV_BOF;
+  } else if (character == '\n') {
+    flags |= DFA_PREV_NEWLINE;
+  }
+
+  if (character != -1 && bitmap_test(builtin_classes[BCC_WORD], character)) {
+    flags |= DFA_PREV_WORD;
+  }
+
+  return flags & builder->prev_mask;
+}
+
+// Follow the threads in a state (and a new thread started at the current position) through to the
+// instructions that consume a character, given the current character (or -1 at the EOF). Yields 1
+// if any thread matches; otherwise, the threads that consume character are added to next. For a
+// regex set, the patterns which match are added to builder->accepts
+static int dfa_closure(dfa_builder_t *builder,
+                       const unsigned char *key,
+                       int character,
+                       unsigned char *next) {
+  const regex_t *regex = builder->regex;
+  const unsigned char *code = regex->bytecode.code;
+  const size_t size = regex->bytecode.size;
+
+  const unsigned int prev_flags = key[builder->key_size - 1];
+  const int is_word = character != -1 && bitmap_test(builtin_classes[BCC_WORD], character);
+
+  bitmap_clear(builder->visited, bitmap_size_for_bits(size + 1));
+
+  size_t n_stack = 0;
+
+#define PUSH(pc)                                                                                   \
+  do {                                                                                             \
+    if (!bitmap_test_and_set(builder->visited, pc)) {                                              \
+      builder->stack[n_stack++] = (pc);                                                            \
+    }                                                                                              \
+  } while (0)
+
+  PUSH(0);
+
+  for (size_t pc = 0; pc <= size; pc++) {
+    if (bitmap_test(key, pc)) {
+      PUSH(pc);
+    }
+  }
+
+  while (n_stack > 0) {
+    size_t pc = builder->stack[--n_stack];
+
+    // Reaching the end of the program is a match
+    if (pc == size) {
+      return 1;
+    }
+
+    const unsigned char byte = code[pc++];
+
+    const unsigned char opcode = VM_OPCODE(byte);
+    const size_t operand_size = VM_OPERAND_SIZE(byte);
+
+    const size_t operand = deserialize_operand(code + pc, operand_size);
+    pc += operand_size;
+
+    switch (opcode) {
+    case VM_CHARACTER:
+    case VM_CHAR_CLASS:
+    case VM_BUILTIN_CHAR_CLASS: {
+      if (character == -1) {
+        break;
+      }
+
+      int accepted;
+
+      if (opcode == VM_CHARACTER) {
+        accepted = (size_t)character == operand;
+      } else if (opcode == VM_CHAR_CLASS) {
+        accepted = bitmap_test(regex->classes[operand], character);
+      } else {
+        accepted = bitmap_test(builtin_classes[operand], character);
+      }
+
+      if (accepted) {
+        bitmap_set(next, pc);
+      }
+
+      break;
+    }
+
+    case VM_ANCHOR_BOF: {
+      if (prev_flags & DFA_PREV_BOF) {
+        PUSH(pc);
+      }
+
+      break;
+    }
+
+    case VM_ANCHOR_BOL: {
+      if (prev_flags & (DFA_PREV_BOF | DFA_PREV_NEWLINE)) {
+        PUSH(pc);
+      }
+
+      break;
+    }
+
+    case VM_ANCHOR_EOF: {
+      if (character == -1) {
+        PUSH(pc);
+      }
+
+      break;
+    }
+
+    case VM_ANCHOR_EOL: {
+      if (character == -1 || character == '\n') {
+        PUSH(pc);
+      }
+
+      break;
+    }
+
+    case VM_ANCHOR_WORD_BOUNDARY:
+    case VM_ANCHOR_NOT_WORD_BOUNDARY: {
+      const int is_boundary = !(prev_flags & DFA_PREV_WORD) != !is_word;
+
+      if (is_boundary == (opcode == VM_ANCHOR_WORD_BOUNDARY)) {
+        PUSH(pc);
+      }
+
+      break;
+    }
+
+    case VM_JUMP: {
+      PUSH(pc + operand);
+      break;
+    }
+
+    case VM_SPLIT_PASSIVE:
+    case VM_SPLIT_EAGER: {
+      PUSH(pc);
+      PUSH(pc + operand);
+      break;
+    }
+
+    case VM_SPLIT_BACKWARDS_PASSIVE:
+    case VM_SPLIT_BACKWARDS_EAGER: {
+      PUSH(pc);
+      PUSH(pc - operand);
+      break;
+    }
+
+    case VM_WRITE_POINTER:
+    case VM_TEST_AND_SET_FLAG: {
+      PUSH(pc);
+      break;
+    }
+
+    case VM_ACCEPT: {
+      bitmap_set(builder->accepts, operand);
+      break;
+    }
+
+    default:
+      UNREACHABLE();
+    }
+  }
+
+#undef PUSH
+
+  return 0;
+}
+
+static size_t dfa_key_hash(const unsigned char *key, size_t key_size) {
+  // 32-bit FNV-1a
+  size_t hash = 0x811c9dc5LU;
+
+  for (size_t i = 0; i < key_size; i++) {
+    hash = ((hash ^ key[i]) * 0x01000193LU) & 0xffffffffLU;
+  }
+
+  return hash;
+}
+
+// Yields the index of key among the *n_keys keys in keys, adding it if necessary, or SIZE_MAX if
+// there are already max_keys keys. The keys are indexed by an open-addressed hash table with
+// 2 * max_keys slots
+static size_t dfa_intern(unsigned char *keys,
+                         size_t *n_keys,
+                         size_t *table,
+                         const unsigned char *key,
+                         size_t key_size,
+                         size_t max_keys) {
+  const size_t table_size = 2 * max_keys;
+
+  size_t slot = dfa_key_hash(key, key_size) & (table_size - 1);
+
+  for (;; slot = (slot + 1) & (table_size - 1)) {
+    const size_t index = table[slot];
+
+    if (index == SIZE_MAX) {
+      break;
+    }
+
+    if (memcmp(keys + key_size * index, key, key_size) == 0) {
+      return index;
+    }
+  }
+
+  if (*n_keys == max_keys) {
+    return SIZE_MAX;
+  }
+
+  const size_t index = (*n_keys)++;
+  memcpy(keys + key_size * index, key, key_size);
+  table[slot] = index;
+
+  return index;
+}
+
+// Yields the state with the given key, creating it if necessary, or SIZE_MAX if there are already
+// too many states
+static size_t dfa_state(dfa_builder_t *builder, size_t *n_states, const unsigned char *key) {
+  return dfa_intern(
+      builder->keys, n_states, builder->table, key, builder->key_size, MAX_DFA_STATES);
+}
+
+// Yields the index of the set of patterns in builder->accepts among the DFA's accept_sets, or
+// SIZE_MAX if there are already too many
+static size_t dfa_accept_set(dfa_builder_t *builder, dfa_t *dfa) {
+  return dfa_intern(dfa->accept_sets,
+                    &dfa->n_accept_sets,
+                    builder->accept_sets_table,
+                    builder->accepts,
+                    dfa->accepts_size,
+                    MAX_DFA_ACCEPT_SETS);
+}
+
+// Split each byte class into its members which are and aren't in bitmap. Yields the new number of
+// byte classes
+static size_t refine_dfa_byte_classes(unsigned char *byte_classes,
+                                      size_t n_byte_classes,
+                                      const unsigned char *bitmap) {
+  size_t split_classes[2 * 256];
+
+  for (size_t i = 0; i < 2 * n_byte_classes; i++) {
+    split_classes[i] = SIZE_MAX;
+  }
+
+  size_t n_split_classes = 0;
+
+  for (size_t c = 0; c <= 255; c++) {
+    const size_t index = 2 * byte_classes[c] + bitmap_test(bitmap, c);
+
+    if (split_classes[index] == SIZE_MAX) {
+      split_classes[index] = n_split_classes++;
+    }
+
+    byte_classes[c] = split_classes[index];
+  }
+
+  return n_split_classes;
+}
+
+// Partition the bytes into classes which no instruction in the program distinguishes between
+static size_t compute_dfa_byte_classes(unsigned char *byte_classes,
+                                       const regex_t *regex,
+                                       int uses_newline,
+                                       int uses_word) {
+  memset(byte_classes, 0, 256);
+  size_t n_byte_classes = 1;
+
+  const unsigned char *code = regex->bytecode.code;
+
+  char_class_t char_class;
+
+  for (size_t pc = 0; pc < regex->bytecode.size;) {
+    const unsigned char byte = code[pc++];
+
+    const unsigned char opcode = VM_OPCODE(byte);
+    const size_t operand_size = VM_OPERAND_SIZE(byte);
+
+    const size_t operand = deserialize_operand(code + pc, operand_size);
+    pc += operand_size;
+
+    const unsigned char *bitmap;
+
+    if (opcode == VM_CHARACTER) {
+      bitmap_clear(char_class, sizeof(char_class_t));
+      bitmap_set(char_class, operand);
+      bitmap = char_class;
+    } else if (opcode == VM_CHAR_CLASS) {
+      bitmap = regex->classes[operand];
+    } else if (opcode == VM_BUILTIN_CHAR_CLASS) {
+      bitmap = builtin_classes[operand];
+    } else {
+      continue;
+    }
+
+    n_byte_classes = refine_dfa_byte_classes(byte_classes, n_byte_classes, bitmap);
+  }
+
+  if (uses_newline) {
+    bitmap_clear(char_class, sizeof(char_class_t));
+    bitmap_set(char_class, '\n');
+    n_byte_classes = refine_dfa_byte_classes(byte_classes, n_byte_classes, char_class);
+  }
+
+  if (uses_word) {
+    n_byte_classes =
+        refine_dfa_byte_classes(byte_classes, n_byte_classes, builtin_classes[BCC_WORD]);
+  }
+
+  return n_byte_classes;
+}
+
+// Yields 0 if the DFA would be too large, or on allocation failure
+WUR static int build_dfa(dfa_t *dfa, const regex_t *regex, const allocator_t *allocator) {
+  const unsigned char *code = regex->bytecode.code;
+  const size_t size = regex->bytecode.size;
+  const size_t n_patterns = regex->n_patterns;
+
+  // Determine which properties of the previous and next characters matter, and whether any flag is
+  // tested at more than one pc
+  unsigned int prev_mask = 0;
+  int uses_newline = 0;
+  int uses_word = 0;
+
+  const size_t flags_size = bitmap_size_for_bits(regex->n_flags);
+  unsigned char *tested_flags = NULL;
+
+  if (flags_size != 0) {
+    tested_flags = ALLOC(allocator, flags_size);
+
+    if (tested_flags == NULL) {
+      return 0;
+    }
+
+    bitmap_clear(tested_flags, flags_size);
+  }
+
+  int shares_flags = 0;
+
+  for (size_t pc = 0; pc < size;) {
+    const unsigned char byte = code[pc++];
+    const size_t operand_size = VM_OPERAND_SIZE(byte);
+
+    const size_t operand = deserialize_operand(code + pc, operand_size);
+    pc += operand_size;
+
+    switch (VM_OPCODE(byte)) {
+    case VM_ANCHOR_BOF:
+      prev_mask |= DFA_PREV_BOF;
+      break;
+
+    case VM_ANCHOR_BOL:
+      prev_mask |= DFA_PREV_BOF | DFA_PREV_NEWLINE;
+      uses_newline = 1;
+      break;
+
+    case VM_ANCHOR_EOL:
+      uses_newline = 1;
+      break;
+
+    case VM_ANCHOR_WORD_BOUNDARY:
+    case VM_ANCHOR_NOT_WORD_BOUNDARY:
+      prev_mask |= DFA_PREV_WORD;
+      uses_word = 1;
+      break;
+
+    case VM_TEST_AND_SET_FLAG:
+      shares_flags |= bitmap_test_and_set(tested_flags, operand);
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  if (tested_flags != NULL) {
+    FREE(allocator, tested_flags);
+  }
+
+  // A flag tested at a single pc only ever kills a thread that duplicates a higher-priority thread
+  // at the same pc, which the DFA merges anyway. But a counted repetition repeats its child's code,
+  // flags and all; there, a flag set by one copy kills threads in another copy, which needn't be
+  // duplicates, and whether it does depends on the threads' priorities. The DFA can't model that,
+  // so leave such programs to the VM (or the native Pike body)
+  if (shares_flags) {
+    return 0;
+  }
+
+  dfa->n_byte_classes =
+      compute_dfa_byte_classes(dfa->byte_classes, regex, uses_newline, uses_word);
+
+  // Don't bother if even the initial state would be too much work (e.g. for a large regex set)
+  if (dfa->n_byte_classes * (size + 1) > MAX_DFA_WORK) {
+    return 0;
+  }
+
+  dfa->n_patterns = n_patterns;
+  dfa->accepts_size = bitmap_size_for_bits(n_patterns);
+  dfa->n_accept_sets = 0;
+  dfa->accept_sets = NULL;
+  dfa->transition_accepts = NULL;
+  dfa->eof_accepts = NULL;
+  dfa->finished = NULL;
+
+  dfa_builder_t builder;
+
+  builder.regex = regex;
+  builder.prev_mask = prev_mask;
+
+  // A thread may be at the end of the program, i.e. about to match
+  const size_t set_size = bitmap_size_for_bits(size + 1);
+  builder.key_size = set_size + 1;
+
+  builder.keys = ALLOC(allocator, builder.key_size * (MAX_DFA_STATES + 1));
+  builder.table = ALLOC(allocator, sizeof(size_t) * 2 * MAX_DFA_STATES);
+  builder.stack = ALLOC(allocator, sizeof(size_t) * (size + 1));
+  builder.visited = ALLOC(allocator, bitmap_size_for_bits(size + 1));
+  builder.accepts = NULL;
+  builder.accept_sets_table = NULL;
+
+  dfa->transitions = ALLOC(allocator, sizeof(size_t) * MAX_DFA_TRANSITIONS);
+  dfa->eof_matches = ALLOC(allocator, MAX_DFA_STATES);
+  dfa->idle = ALLOC(allocator, MAX_DFA_STATES);
+
+  int success = builder.keys != NULL && builder.table != NULL && builder.stack != NULL &&
+                builder.visited != NULL && dfa->transitions != NULL && dfa->eof_matches != NULL &&
+                dfa->idle != NULL;
+
+  if (success && n_patterns != 0) {
+    builder.accepts = ALLOC(allocator, dfa->accepts_size);
+    builder.accept_sets_table = ALLOC(allocator, sizeof(size_t) * 2 * MAX_DFA_ACCEPT_SETS);
+
+    dfa->accept_sets = ALLOC(allocator, dfa->accepts_size * MAX_DFA_ACCEPT_SETS);
+    dfa->transition_accepts = ALLOC(allocator, sizeof(size_t) * MAX_DFA_TRANSITIONS);
+    dfa->eof_accepts = ALLOC(allocator, sizeof(size_t) * MAX_DFA_STATES);
+    dfa->finished = ALLOC(allocator, MAX_DFA_STATES);
+
+    success = builder.accepts != NULL && builder.accept_sets_table != NULL &&
+              dfa->accept_sets != NULL && dfa->transition_accepts != NULL &&
+              dfa->eof_accepts != NULL && dfa->finished != NULL;
+  }
+
+  // Whether a match (or for a regex set, a match of some pattern) is reachable from each state
+  unsigned char live[MAX_DFA_STATES];
+
+  if (success) {
+    for (size_t i = 0; i < 2 * MAX_DFA_STATES; i++) {
+      builder.table[i] = SIZE_MAX;
+    }
+
+    // The empty set of patterns is the 0th
+    if (n_patterns != 0) {
+      for (size_t i = 0; i < 2 * MAX_DFA_ACCEPT_SETS; i++) {
+        builder.accept_sets_table[i] = SIZE_MAX;
+      }
+
+      bitmap_clear(builder.accepts, dfa->accepts_size);
+
+      const size_t empty_set = dfa_accept_set(&builder, dfa);
+      assert(empty_set == 0);
+      (void)empty_set;
+    }
+
+    // The key for a new state is assembled in the spare slot at the end of the keys buffer
+    unsigned char *next = builder.keys + builder.key_size * MAX_DFA_STATES;
+
+    bitmap_clear(next, builder.key_size);
+    next[set_size] = dfa_prev_flags(&builder, -1);
+
+    size_t n_states = 0;
+    const size_t initial_state = dfa_state(&builder, &n_states, next);
+    assert(initial_state == 0);
+    (void)initial_state;
+
+    // Representative character of each byte class
+    int representatives[256];
+
+    for (int c = 255; c >= 0; c--) {
+      representatives[dfa->byte_classes[c]] = c;
+    }
+
+    // There are only as many of these as there are combinations of DFA_PREV_* flags, so there's
+    // necessarily room for them
+    for (size_t byte_class = 0; byte_class < dfa->n_byte_classes; byte_class++) {
+      next[set_size] = dfa_prev_flags(&builder, representatives[byte_class]);
+      dfa->initial_states[byte_class] = dfa_state(&builder, &n_states, next);
+      assert(dfa->initial_states[byte_class] != SIZE_MAX);
+    }
+
+    // States are numbered in the order in which they're discovered, so this is a breadth-first
+    // traversal
+    for (size_t state = 0; success && state < n_states; state++) {
+      const size_t n_transitions = dfa->n_byte_classes * (state + 1);
+
+      if (n_transitions > MAX_DFA_TRANSITIONS || n_transitions * (size + 1) > MAX_DFA_WORK) {
+        success = 0;
+        break;
+      }
+
+      const unsigned char *key = builder.keys + builder.key_size * state;
+
+      dfa->idle[state] = 1;
+
+      for (size_t i = 0; i < set_size; i++) {
+        if (key[i] != 0) {
+          dfa->idle[state] = 0;
+          break;
+        }
+      }
+
+      bitmap_clear(next, builder.key_size);
+
+      if (n_patterns != 0) {
+        bitmap_clear(builder.accepts, dfa->accepts_size);
+      }
+
+      dfa->eof_matches[state] = dfa_closure(&builder, key, -1, next);
+      live[state] = dfa->eof_matches[state];
+
+      if (n_patterns != 0) {
+        dfa->eof_accepts[state] = dfa_accept_set(&builder, dfa);
+
+        if (dfa->eof_accepts[state] == SIZE_MAX) {
+          success = 0;
+          break;
+        }
+
+        live[state] = dfa->eof_accepts[state] != 0;
+      }
+
+      for (size_t byte_class = 0; byte_class < dfa->n_byte_classes; byte_class++) {
+        const size_t transition = dfa->n_byte_classes * state + byte_class;
+        const int character = representatives[byte_class];
+
+        bitmap_clear(next, builder.key_size);
+
+        if (n_patterns != 0) {
+          bitmap_clear(builder.accepts, dfa->accepts_size);
+        }
+
+        size_t target;
+
+        if (dfa_closure(&builder, key, character, next)) {
+          target = DFA_MATCH;
+        } else {
+          next[set_size] = dfa_prev_flags(&builder, character);
+          target = dfa_state(&builder, &n_states, next);
+
+          if (target == SIZE_MAX) {
+            success = 0;
+            break;
+          }
+        }
+
+        if (n_patterns != 0) {
+          dfa->transition_accepts[transition] = dfa_accept_set(&builder, dfa);
+
+          if (dfa->transition_accepts[transition] == SIZE_MAX) {
+            success = 0;
+            break;
+          }
+
+          live[state] |= dfa->transition_accepts[transition] != 0;
+        }
+
+        dfa->transitions[transition] = target;
+      }
+    }
+
+    dfa->n_states = n_states;
+  }
+
+  FREE(allocator, builder.keys);
+  FREE(allocator, builder.table);
+  FREE(allocator, builder.stack);
+  FREE(allocator, builder.visited);
+  FREE(allocator, builder.accepts);
+  FREE(allocator, builder.accept_sets_table);
+
+  if (!success) {
+    destroy_dfa(dfa, allocator);
+    return 0;
+  }
+
+  // A state from which no match is reachable may as well fail immediately. Find the states from
+  // which a match is reachable by iterating to a fixpoint
+  for (int changed = 1; changed;) {
+    changed = 0;
+
+    for (size_t state = 0; state < dfa->n_states; state++) {
+      if (live[state]) {
+        continue;
+      }
+
+      for (size_t byte_class = 0; byte_class < dfa->n_byte_classes; byte_class++) {
+        const size_t target = dfa->transitions[dfa->n_byte_classes * state + byte_class];
+
+        if (target == DFA_MATCH || live[target]) {
+          live[state] = 1;
+          changed = 1;
+          break;
+        }
+      }
+    }
+  }
+
+  // A regex set's states are kept, so that the search can be cut short from such a state without
+  // losing track of what's already matched
+  if (n_patterns != 0) {
+    for (size_t state = 0; state < dfa->n_states; state++) {
+      dfa->finished[state] = !live[state];
+    }
+
+    return 1;
+  }
+
+  for (size_t i = 0; i < dfa->n_byte_classes * dfa->n_states; i++) {
+    const size_t target = dfa->transitions[i];
+
+    if (target != DFA_MATCH && !live[target]) {
+      dfa->transitions[i] = DFA_NO_MATCH;
+    }
+  }
+
+  for (size_t byte_class = 0; byte_class < dfa->n_byte_classes; byte_class++) {
+    if (!live[dfa->initial_states[byte_class]]) {
+      dfa->initial_states[byte_class] = DFA_NO_MATCH;
+    }
+  }
+
+  return 1;
+}
+
+// build_dfa allocates room for the largest DFA it will build. For a DFA that's kept around, give
+// back what it didn't use. If out of memory, the DFA is left as it is
+static void shrink_dfa(dfa_t *dfa, const allocator_t *allocator) {
+  const size_t size = sizeof(size_t) * dfa->n_byte_classes * dfa->n_states;
+  size_t *transitions = ALLOC(allocator, size);
+
+  if (transitions == NULL) {
+    return;
+  }
+
+  memcpy(transitions, dfa->transitions, size);
+  FREE(allocator, dfa->transitions);
+  dfa->transitions = transitions;
+}
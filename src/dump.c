@@ -0,0 +1,513 @@
+// A dumped regex is encoded as:
+// - the magic string "crex"
+// - DUMP_N_FIELDS little-endian 32-bit header fields, as enumerated below
+// - the regex's character classes (32 bytes apiece)
+// - the regex's bytecode
+// - optionally, the regex's native code
+//
+// Bytecode operands are in the byte order of the host that dumped the regex, which is recorded in
+// the header; a host of the other byte order swaps them when loading.
+//
+// A dump might come from anywhere, so loading validates the bytecode thoroughly enough that
+// executing it can't misbehave (see validate_bytecode). Native code can't be validated like that:
+// running a crafted dump's native code would run whatever its author liked. So native code is only
+// included if requested, and is ignored when loading unless the caller vouches for the dump (with
+// crex_load_trusted_regex_with_native_code). Even then, it's only used if the loading process was
+// built with a compatible native compiler and the host supports all the CPU features it uses.
+// Otherwise, the loaded regex is compiled to native code from its bytecode as usual
+
+#define DUMP_MAGIC "crex"
+#define DUMP_MAGIC_SIZE 4
+
+#define DUMP_VERSION 3
+
+enum { DUMP_LITTLE_ENDIAN, DUMP_BIG_ENDIAN };
+
+enum {
+  DF_VERSION,
+  DF_BYTE_ORDER,
+  DF_N_CAPTURING_GROUPS,
+  DF_N_CLASSES,
+  DF_N_FLAGS,
+  DF_BYTECODE_SIZE,
+  DF_NATIVE_CODE_SIZE,
+  DF_NATIVE_CODE_FEATURES,
+  DF_NATIVE_CODE_FINGERPRINT,
+  DF_NATIVE_CODE_FIND_ENTRY_POINT,
+  DF_NATIVE_CODE_GROUPS_ENTRY_POINT,
+  DUMP_N_FIELDS
+};
+
+#define DUMP_HEADER_SIZE (DUMP_MAGIC_SIZE + 4 * DUMP_N_FIELDS)
+
+// Bounds the number of capturing groups and flags in a loaded regex. Neither is bounded by the size
+// of the bytecode, and the cost of executing (and compiling to native code) grows with both, so a
+// corrupt count could make loading take forever. No sensible pattern comes anywhere near
+#define DUMP_MAX_COUNT (1LU << 16u)
+
+static size_t host_byte_order(void) {
+  const uint16_t probe = 1;
+  unsigned char first_byte;
+  memcpy(&first_byte, &probe, 1);
+
+  return (first_byte == 1) ? DUMP_LITTLE_ENDIAN : DUMP_BIG_ENDIAN;
+}
+
+WUR static unsigned char *dump_regex(status_t *status,
+                                     size_t *size,
+                                     const regex_t *regex,
+                                     int include_native_code,
+                                     const allocator_t *allocator) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  size_t fields[DUMP_N_FIELDS];
+
+  fields[DF_VERSION] = DUMP_VERSION;
+  fields[DF_BYTE_ORDER] = host_byte_order();
+  fields[DF_N_CAPTURING_GROUPS] = regex->n_capturing_groups;
+  fields[DF_N_CLASSES] = regex->n_classes;
+  fields[DF_N_FLAGS] = regex->n_flags;
+  fields[DF_BYTECODE_SIZE] = regex->bytecode.size;
+  fields[DF_NATIVE_CODE_SIZE] = 0;
+  fields[DF_NATIVE_CODE_FEATURES] = 0;
+  fields[DF_NATIVE_CODE_FINGERPRINT] = 0;
+  fields[DF_NATIVE_CODE_FIND_ENTRY_POINT] = 0;
+  fields[DF_NATIVE_CODE_GROUPS_ENTRY_POINT] = 0;
+
+  const void *native_code = NULL;
+
+#ifdef NATIVE_COMPILER
+  // If native compilation of the regex has been deferred and hasn't happened yet, there's nothing
+  // to include
+  if (include_native_code) {
+#ifdef DEFERRED_NATIVE_COMPILER
+    native_code = __atomic_load_n(&regex->native_code.code, __ATOMIC_ACQUIRE);
+#else
+    native_code = regex->native_code.code;
+#endif
+  }
+
+  if (native_code != NULL) {
+    fields[DF_NATIVE_CODE_SIZE] = regex->native_code.size;
+    fields[DF_NATIVE_CODE_FEATURES] = regex->native_code.features;
+    fields[DF_NATIVE_CODE_FINGERPRINT] = native_code_fingerprint();
+    fields[DF_NATIVE_CODE_FIND_ENTRY_POINT] = regex->native_code.entry_points[NM_FIND];
+    fields[DF_NATIVE_CODE_GROUPS_ENTRY_POINT] = regex->native_code.entry_points[NM_GROUPS];
+  }
+#else
+  (void)include_native_code;
+#endif
+
+  // All the sizes are bounded by the sizes of the corresponding buffers, so this could only
+  // conceivably fail for a ludicrously large regex
+  for (size_t i = 0; i < DUMP_N_FIELDS; i++) {
+    if (fields[i] > 0xffffffffLU) {
+      *status = CREX_E_NOMEM;
+      return NULL;
+    }
+  }
+
+  const size_t classes_size = sizeof(char_class_t) * regex->n_classes;
+
+  *size = DUMP_HEADER_SIZE + classes_size + regex->bytecode.size + fields[DF_NATIVE_CODE_SIZE];
+
+  unsigned char *buffer = ALLOC(allocator, *size);
+
+  if (buffer == NULL) {
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  unsigned char *data = buffer;
+
+  memcpy(data, DUMP_MAGIC, DUMP_MAGIC_SIZE);
+  data += DUMP_MAGIC_SIZE;
+
+  for (size_t i = 0; i < DUMP_N_FIELDS; i++) {
+    serialize_operand_le(data, fields[i], 4);
+    data += 4;
+  }
+
+  safe_memcpy(data, regex->classes, classes_size);
+  data += classes_size;
+
+  safe_memcpy(data, regex->bytecode.code, regex->bytecode.size);
+  data += regex->bytecode.size;
+
+  safe_memcpy(data, native_code, fields[DF_NATIVE_CODE_SIZE]);
+  data += fields[DF_NATIVE_CODE_SIZE];
+
+  assert(data == buffer + *size);
+
+  *status = CREX_OK;
+
+  return buffer;
+}
+
+// Marks the beginning of each of the bytecode's instructions in boundaries (a bitmap with a bit for
+// each byte of the bytecode, plus one for its end), reversing the bytes of each operand if swap is
+// set. Yields 0 if the instructions don't fit the bytecode exactly
+WUR static int
+scan_bytecode(unsigned char *boundaries, unsigned char *code, size_t size, int swap) {
+  size_t index = 0;
+
+  while (index < size) {
+    bitmap_set(boundaries, index);
+
+    const size_t operand_size = VM_OPERAND_SIZE(code[index++]);
+
+    if (operand_size == 3 || operand_size > 4 || operand_size > size - index) {
+      return 0;
+    }
+
+    for (size_t i = 0; swap && i < operand_size / 2; i++) {
+      const unsigned char byte = code[index + i];
+      code[index + i] = code[index + operand_size - 1 - i];
+      code[index + operand_size - 1 - i] = byte;
+    }
+
+    index += operand_size;
+  }
+
+  bitmap_set(boundaries, size);
+
+  return 1;
+}
+
+// Yields the targets of the control flow that leaves the instruction at index without consuming a
+// character (except for that of a VM_TEST_AND_SET_FLAG, which is what breaks cycles in such control
+// flow), or SIZE_MAX for a target outside of the bytecode. Advances index to the next instruction
+static size_t bytecode_successors(size_t *successors, const unsigned char *code, size_t *index) {
+  const unsigned char byte = code[(*index)++];
+
+  const unsigned char opcode = VM_OPCODE(byte);
+  const size_t operand_size = VM_OPERAND_SIZE(byte);
+
+  const size_t operand = deserialize_operand(code + *index, operand_size);
+  *index += operand_size;
+
+  const size_t next = *index;
+
+  switch (opcode) {
+  case VM_CHARACTER:
+  case VM_CHAR_CLASS:
+  case VM_BUILTIN_CHAR_CLASS:
+  case VM_TEST_AND_SET_FLAG:
+  case VM_ACCEPT:
+    return 0;
+
+  case VM_JUMP:
+    successors[0] = (operand > SIZE_MAX - next) ? SIZE_MAX : next + operand;
+    return 1;
+
+  case VM_SPLIT_PASSIVE:
+  case VM_SPLIT_EAGER:
+    successors[0] = next;
+    successors[1] = (operand > SIZE_MAX - next) ? SIZE_MAX : next + operand;
+    return 2;
+
+  case VM_SPLIT_BACKWARDS_PASSIVE:
+  case VM_SPLIT_BACKWARDS_EAGER:
+    successors[0] = next;
+    successors[1] = (operand > next) ? SIZE_MAX : next - operand;
+    return 2;
+
+  default:
+    successors[0] = next;
+    return 1;
+  }
+}
+
+// Checks that each instruction is a known opcode with an operand in range for the regex, that all
+// control flow lands on instruction boundaries, and that every cycle in the control flow either
+// consumes a character or passes through a VM_TEST_AND_SET_FLAG (as the bytecode compiler
+// guarantees), since the VM and the native code would otherwise loop forever. The operands must be
+// in the host's byte order, and boundaries must be as yielded by scan_bytecode
+WUR static status_t validate_bytecode(const regex_t *regex,
+                                      const unsigned char *boundaries,
+                                      const allocator_t *allocator) {
+  const unsigned char *code = regex->bytecode.code;
+  const size_t size = regex->bytecode.size;
+
+  if (size == 0) {
+    return CREX_E_BAD_DUMP;
+  }
+
+  for (size_t index = 0; index < size;) {
+    const unsigned char byte = code[index];
+
+    const unsigned char opcode = VM_OPCODE(byte);
+    const size_t operand_size = VM_OPERAND_SIZE(byte);
+    const size_t operand = deserialize_operand(code + index + 1, operand_size);
+
+    int okay;
+
+    switch (opcode) {
+    case VM_CHARACTER:
+      okay = operand <= 0xff;
+      break;
+
+    case VM_CHAR_CLASS:
+      okay = operand < regex->n_classes;
+      break;
+
+    case VM_BUILTIN_CHAR_CLASS:
+      okay = operand < N_BUILTIN_CLASSES;
+      break;
+
+    case VM_ANCHOR_BOF:
+    case VM_ANCHOR_BOL:
+    case VM_ANCHOR_EOF:
+    case VM_ANCHOR_EOL:
+    case VM_ANCHOR_WORD_BOUNDARY:
+    case VM_ANCHOR_NOT_WORD_BOUNDARY:
+      okay = operand == 0;
+      break;
+
+    case VM_JUMP:
+    case VM_SPLIT_PASSIVE:
+    case VM_SPLIT_EAGER:
+    case VM_SPLIT_BACKWARDS_PASSIVE:
+    case VM_SPLIT_BACKWARDS_EAGER:
+      okay = 1;
+      break;
+
+    case VM_WRITE_POINTER:
+      okay = operand < 2 * regex->n_capturing_groups;
+      break;
+
+    case VM_TEST_AND_SET_FLAG:
+      okay = operand < regex->n_flags;
+      break;
+
+    // Only a regex set's program accepts, and sets aren't dumped
+    default:
+      okay = 0;
+      break;
+    }
+
+    size_t successors[2];
+    const size_t n_successors = bytecode_successors(successors, code, &index);
+
+    // The bytecode compiler ends every program with an instruction that neither consumes a
+    // character nor branches, and never branches to the end of the program; the native compiler
+    // relies on both
+    const int is_branch = VM_JUMP <= opcode && opcode <= VM_SPLIT_BACKWARDS_EAGER;
+
+    if (opcode <= VM_BUILTIN_CHAR_CLASS && index == size) {
+      okay = 0;
+    }
+
+    for (size_t i = 0; i < n_successors; i++) {
+      okay = okay && successors[i] <= size - is_branch && bitmap_test(boundaries, successors[i]);
+    }
+
+    if (!okay) {
+      return CREX_E_BAD_DUMP;
+    }
+  }
+
+  // Look for a cycle in the control flow that doesn't consume a character by repeatedly removing
+  // instructions with no remaining predecessors; whatever can't be removed lies on such a cycle
+  size_t *n_predecessors = ALLOC(allocator, sizeof(size_t) * (size + 1));
+  size_t *queue = ALLOC(allocator, sizeof(size_t) * (size + 1));
+
+  if (n_predecessors == NULL || queue == NULL) {
+    FREE(allocator, n_predecessors);
+    FREE(allocator, queue);
+    return CREX_E_NOMEM;
+  }
+
+  size_t n_instructions = 0;
+
+  for (size_t index = 0; index <= size; index++) {
+    n_predecessors[index] = 0;
+  }
+
+  for (size_t index = 0; index < size; n_instructions++) {
+    size_t successors[2];
+    const size_t n_successors = bytecode_successors(successors, code, &index);
+
+    for (size_t i = 0; i < n_successors; i++) {
+      n_predecessors[successors[i]]++;
+    }
+  }
+
+  size_t head = 0;
+  size_t tail = 0;
+
+  for (size_t index = 0; index < size; index++) {
+    if (bitmap_test(boundaries, index) && n_predecessors[index] == 0) {
+      queue[tail++] = index;
+    }
+  }
+
+  while (head != tail) {
+    size_t index = queue[head++];
+
+    size_t successors[2];
+    const size_t n_successors = bytecode_successors(successors, code, &index);
+
+    for (size_t i = 0; i < n_successors; i++) {
+      if (--n_predecessors[successors[i]] == 0 && successors[i] != size) {
+        queue[tail++] = successors[i];
+      }
+    }
+  }
+
+  FREE(allocator, n_predecessors);
+  FREE(allocator, queue);
+
+  return (tail == n_instructions) ? CREX_OK : CREX_E_BAD_DUMP;
+}
+
+WUR static regex_t *load_regex(status_t *status,
+                               const unsigned char *buffer,
+                               size_t size,
+                               int trusted,
+                               const allocator_t *allocator) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  if (size < DUMP_HEADER_SIZE || memcmp(buffer, DUMP_MAGIC, DUMP_MAGIC_SIZE) != 0) {
+    *status = CREX_E_BAD_DUMP;
+    return NULL;
+  }
+
+  size_t fields[DUMP_N_FIELDS];
+
+  for (size_t i = 0; i < DUMP_N_FIELDS; i++) {
+    fields[i] = deserialize_operand_le(buffer + DUMP_MAGIC_SIZE + 4 * i, 4);
+  }
+
+  if (fields[DF_VERSION] != DUMP_VERSION || fields[DF_BYTE_ORDER] > DUMP_BIG_ENDIAN ||
+      fields[DF_N_CAPTURING_GROUPS] == 0 || fields[DF_N_CAPTURING_GROUPS] > DUMP_MAX_COUNT ||
+      fields[DF_N_FLAGS] > DUMP_MAX_COUNT) {
+    *status = CREX_E_BAD_DUMP;
+    return NULL;
+  }
+
+  // Each of these is at most 0xffffffff, so the sum can't overflow
+  const size_t classes_size = sizeof(char_class_t) * fields[DF_N_CLASSES];
+  const size_t bytecode_size = fields[DF_BYTECODE_SIZE];
+  const size_t native_code_size = fields[DF_NATIVE_CODE_SIZE];
+
+  if (size != DUMP_HEADER_SIZE + classes_size + bytecode_size + native_code_size) {
+    *status = CREX_E_BAD_DUMP;
+    return NULL;
+  }
+
+  const unsigned char *classes = buffer + DUMP_HEADER_SIZE;
+  const unsigned char *bytecode = classes + classes_size;
+  const unsigned char *native_code = bytecode + bytecode_size;
+
+  regex_t *regex = ALLOC(allocator, sizeof(regex_t));
+
+  if (regex == NULL) {
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  regex->n_capturing_groups = fields[DF_N_CAPTURING_GROUPS];
+  regex->n_classes = fields[DF_N_CLASSES];
+  regex->n_flags = fields[DF_N_FLAGS];
+  regex->n_patterns = 0;
+  regex->cache_entry = NULL;
+  regex->parallel_dfa = NULL;
+
+  regex->classes = NULL;
+
+  if (classes_size != 0) {
+    regex->classes = ALLOC(allocator, classes_size);
+
+    if (regex->classes == NULL) {
+      *status = CREX_E_NOMEM;
+      FREE(allocator, regex);
+      return NULL;
+    }
+
+    memcpy(regex->classes, classes, classes_size);
+  }
+
+  regex->bytecode.size = bytecode_size;
+  regex->bytecode.code = ALLOC(allocator, bytecode_size);
+
+  if (regex->bytecode.code == NULL) {
+    *status = CREX_E_NOMEM;
+    FREE(allocator, regex->classes);
+    FREE(allocator, regex);
+    return NULL;
+  }
+
+  safe_memcpy(regex->bytecode.code, bytecode, bytecode_size);
+
+  regex->allocator = *allocator;
+
+  unsigned char *boundaries = ALLOC(allocator, bitmap_size_for_bits(bytecode_size + 1));
+
+  if (boundaries == NULL) {
+    *status = CREX_E_NOMEM;
+    FREE(allocator, regex->bytecode.code);
+    FREE(allocator, regex->classes);
+    FREE(allocator, regex);
+    return NULL;
+  }
+
+  bitmap_clear(boundaries, bitmap_size_for_bits(bytecode_size + 1));
+
+  const int swap = fields[DF_BYTE_ORDER] != host_byte_order();
+
+  *status = scan_bytecode(boundaries, regex->bytecode.code, bytecode_size, swap)
+                ? validate_bytecode(regex, boundaries, allocator)
+                : CREX_E_BAD_DUMP;
+
+  FREE(allocator, boundaries);
+
+  if (*status != CREX_OK) {
+    FREE(allocator, regex->bytecode.code);
+    FREE(allocator, regex->classes);
+    FREE(allocator, regex);
+    return NULL;
+  }
+
+#ifdef NATIVE_COMPILER
+  const unsigned int features = fields[DF_NATIVE_CODE_FEATURES];
+
+  // The is_match body always comes first
+  const size_t entry_points[N_NATIVE_MODES] = {
+      0, fields[DF_NATIVE_CODE_FIND_ENTRY_POINT], fields[DF_NATIVE_CODE_GROUPS_ENTRY_POINT]};
+
+  // Native code is useless to a host of the other byte order, even if it's otherwise compatible
+  const int native_code_usable = trusted && native_code_size != 0 && !swap &&
+                                 fields[DF_NATIVE_CODE_FINGERPRINT] == native_code_fingerprint() &&
+                                 (features & ~host_native_features()) == 0 &&
+                                 entry_points[NM_FIND] < native_code_size &&
+                                 entry_points[NM_GROUPS] < native_code_size;
+
+  if (!native_code_usable) {
+    native_code = NULL;
+  }
+
+  if (!initialize_native_code(regex, native_code, native_code_size, entry_points, features)) {
+    *status = CREX_E_NOMEM;
+    FREE(allocator, regex->bytecode.code);
+    FREE(allocator, regex->classes);
+    FREE(allocator, regex);
+    return NULL;
+  }
+#else
+  (void)native_code;
+  (void)trusted;
+#endif
+
+  *status = CREX_OK;
+
+  return regex;
+}
@@ -1,24 +1,16 @@
 #include "vm.h"
 
-WUR static status_t execute_regex(void *result,
-                                  context_t *context,
-                                  const regex_t *regex,
-                                  const char *str,
-                                  size_t size,
-                                  size_t n_pointers) {
-  vm_t vm;
-
-  if (!create_vm(&vm, context, regex, n_pointers, 0)) {
-    return CREX_E_NOMEM;
-  }
+// Run a freshly created (or reset) VM over the string
+WUR static status_t
+run_vm(void *result, vm_t *vm, const char *str, size_t size, int prev_character) {
+  const size_t n_pointers = vm->n_pointers;
 
   const char *eof = str + size;
-  int prev_character = -1;
 
   for (;;) {
     const int character = (str == eof) ? -1 : (unsigned char)(*str);
 
-    vm_status_t status = run_threads(&vm, step_thread, str, character, prev_character);
+    vm_status_t status = run_threads(vm, step_thread, str, character, prev_character);
 
     if (status == VM_STATUS_DONE) {
       break;
@@ -40,13 +32,13 @@ WUR static status_t execute_regex(void *result,
 
   if (n_pointers == 0) {
     int *is_match = result;
-    *is_match = vm.matched_thread != NULL_HANDLE;
+    *is_match = vm->matched_thread != NULL_HANDLE;
     return CREX_OK;
   }
 
   match_t *matches = result;
 
-  if (vm.matched_thread == NULL_HANDLE) {
+  if (vm->matched_thread == NULL_HANDLE) {
     for (size_t i = 0; i < n_pointers / 2; i++) {
       matches[i].begin = NULL;
       matches[i].end = NULL;
@@ -55,7 +47,23 @@ WUR static status_t execute_regex(void *result,
     return CREX_OK;
   }
 
-  memcpy(matches, POINTER_BUFFER(vm, vm.matched_thread), sizeof(const char *) * n_pointers);
+  memcpy(matches, POINTER_BUFFER(*vm, vm->matched_thread), sizeof(const char *) * n_pointers);
 
   return CREX_OK;
 }
+
+WUR static status_t execute_regex(void *result,
+                                  context_t *context,
+                                  const regex_t *regex,
+                                  const char *str,
+                                  size_t size,
+                                  int prev_character,
+                                  size_t n_pointers) {
+  vm_t vm;
+
+  if (!create_vm(&vm, context, regex, n_pointers, 0)) {
+    return CREX_E_NOMEM;
+  }
+
+  return run_vm(result, &vm, str, size, prev_character);
+}
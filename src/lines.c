@@ -0,0 +1,193 @@
+// Line-oriented searches, which report each line of the input that contains a match, as if each
+// line were searched separately (so that e.g. \A and ^ match at the beginning of every line). Lines
+// are delimited by '\n', which isn't part of the line; a '\n' at the very end of the input doesn't
+// begin another, empty line. The search of a line stops at its first match, and the next search
+// begins at the next line.
+//
+// Where every match must begin with a character in some class (see first_char_class), the search
+// first skips ahead to the next such character, with memchr if there's only one, and only searches
+// the line containing it, so that lines which can't match are never searched at all
+
+// Yields 1 and populates char_class with the set of characters with which any match must begin, or
+// yields 0 if there's no such set (i.e. if the regex can match the empty string) or on allocation
+// failure. Unlike initial_char_class (see native-compiler.c), this follows the program's control
+// flow. Anchors are assumed to succeed, which can only make the set larger
+WUR static int first_char_class(char_class_t char_class,
+                                const regex_t *regex,
+                                const allocator_t *allocator) {
+  const unsigned char *code = regex->bytecode.code;
+  const size_t size = regex->bytecode.size;
+
+  unsigned char *visited = ALLOC(allocator, bitmap_size_for_bits(size + 1));
+  size_t *stack = ALLOC(allocator, sizeof(size_t) * (size + 1));
+
+  if (visited == NULL || stack == NULL) {
+    FREE(allocator, visited);
+    FREE(allocator, stack);
+    return 0;
+  }
+
+  bitmap_clear(visited, bitmap_size_for_bits(size + 1));
+  bitmap_clear(char_class, sizeof(char_class_t));
+
+  size_t depth = 0;
+  stack[depth++] = 0;
+  bitmap_set(visited, 0);
+
+  int result = 1;
+
+  while (depth != 0 && result) {
+    size_t index = stack[--depth];
+
+    // Falling off the end of the program is a match
+    if (index == size) {
+      result = 0;
+      break;
+    }
+
+    const unsigned char byte = code[index++];
+
+    const unsigned char opcode = VM_OPCODE(byte);
+    const size_t operand_size = VM_OPERAND_SIZE(byte);
+
+    const size_t operand = deserialize_operand(code + index, operand_size);
+    index += operand_size;
+
+    size_t successors[2];
+    size_t n_successors = 0;
+
+    switch (opcode) {
+    case VM_CHARACTER: {
+      bitmap_set(char_class, operand);
+      break;
+    }
+
+    case VM_CHAR_CLASS:
+    case VM_BUILTIN_CHAR_CLASS: {
+      const unsigned char *bitmap =
+          (opcode == VM_CHAR_CLASS) ? regex->classes[operand] : builtin_classes[operand];
+
+      bitmap_union(char_class, bitmap, sizeof(char_class_t));
+
+      break;
+    }
+
+    case VM_JUMP: {
+      successors[n_successors++] = index + operand;
+      break;
+    }
+
+    case VM_SPLIT_PASSIVE:
+    case VM_SPLIT_EAGER: {
+      successors[n_successors++] = index;
+      successors[n_successors++] = index + operand;
+      break;
+    }
+
+    case VM_SPLIT_BACKWARDS_PASSIVE:
+    case VM_SPLIT_BACKWARDS_EAGER: {
+      successors[n_successors++] = index;
+      successors[n_successors++] = index - operand;
+      break;
+    }
+
+    case VM_ACCEPT: {
+      result = 0;
+      break;
+    }
+
+    default: {
+      successors[n_successors++] = index;
+      break;
+    }
+    }
+
+    for (size_t i = 0; i < n_successors; i++) {
+      if (!bitmap_test_and_set(visited, successors[i])) {
+        stack[depth++] = successors[i];
+      }
+    }
+  }
+
+  FREE(allocator, visited);
+  FREE(allocator, stack);
+
+  return result;
+}
+
+WUR static status_t match_lines(context_t *context,
+                                const regex_t *regex,
+                                const char *str,
+                                size_t size,
+                                line_callback_t callback,
+                                void *callback_context) {
+  char_class_t first_class;
+  const int has_first_class = first_char_class(first_class, regex, &context->allocator);
+
+  // The only character in first_class, if there's just one; otherwise negative
+  int first_character = -1;
+
+  if (has_first_class) {
+    for (size_t c = 0; c <= 255; c++) {
+      if (!bitmap_test(first_class, c)) {
+        continue;
+      }
+
+      first_character = (first_character == -1) ? (int)c : -2;
+    }
+  }
+
+  const char *eof = str + size;
+
+  for (const char *line = str; line != eof;) {
+    if (has_first_class) {
+      const char *candidate;
+
+      if (first_character >= 0) {
+        candidate = memchr(line, first_character, eof - line);
+      } else {
+        candidate = line;
+
+        while (candidate != eof && !bitmap_test(first_class, (unsigned char)(*candidate))) {
+          candidate++;
+        }
+
+        candidate = (candidate == eof) ? NULL : candidate;
+      }
+
+      if (candidate == NULL) {
+        break;
+      }
+
+      // Back up to the beginning of the candidate's line, which is no earlier than line
+      while (candidate != line && candidate[-1] != '\n') {
+        candidate--;
+      }
+
+      line = candidate;
+    }
+
+    const char *newline = memchr(line, '\n', eof - line);
+    const char *line_end = (newline == NULL) ? eof : newline;
+
+    int is_match;
+
+    const status_t status = run_regex(&is_match, context, regex, line, line_end - line, -1, 0);
+
+    if (status != CREX_OK) {
+      return status;
+    }
+
+    if (is_match) {
+      const match_t match = {line, line_end};
+
+      if (!(*callback)(callback_context, &match)) {
+        break;
+      }
+    }
+
+    line = (newline == NULL) ? eof : newline + 1;
+  }
+
+  return CREX_OK;
+}
@@ -2,18 +2,20 @@
 
 #include "assembler.c"
 
+#if defined(__GNUC__) || defined(__clang__)
+#include <cpuid.h>
+#endif
+
 #define R_SCRATCH RAX
 #define R_SCRATCH_2 RCX
 
-#define R_CHAR_CLASSES R9
-#define R_BUILTIN_CHAR_CLASSES RBX
+#define R_CHAR_CLASSES R8
+#define R_BUILTIN_CHAR_CLASSES R9
 
 #define R_BUFFER R15
 
 #define R_STR RDX
 
-#define R_N_POINTERS R8
-
 #define R_CAPACITY R12
 #define R_BUMP_POINTER R13
 #define R_FREELIST R10
@@ -65,6 +67,13 @@
     }                                                                                              \
   } while (0)
 
+#define ASM3(id, x, y, z)                                                                          \
+  do {                                                                                             \
+    if (!id(as, x, y, z, allocator)) {                                                             \
+      return 0;                                                                                    \
+    }                                                                                              \
+  } while (0)
+
 // The vast majority of branches in the (typical) compiled program are used for simple control
 // flow and boolean logic within a single VM instruction or self-contained loop; moreover, these
 // branches can always be expressed as short jccs. For this class of branch, we can save
@@ -103,9 +112,11 @@ enum {
   LABEL_STATE_LOOP_HEAD,
   LABEL_HAVE_STATE,
   LABEL_POST_STATE_LOOP,
-  LABEL_FIND_OR_GROUPS_CODA,
   LABEL_FIND_OR_GROUPS_NO_MATCH,
   LABEL_RETURN_OK,
+  LABEL_POST_LEADING_CLASS_SKIP,
+  LABEL_LEADING_CLASS_TABLES,
+  LABEL_MATCH,
   N_STATIC_LABELS
 };
 
@@ -115,89 +126,992 @@ enum {
 // The first 64 flags are stored in a register, the remainder in memory
 #define FLAG_BUFFER_SIZE(n_flags) (((((n_flags)-64) + 63) / 64) * 8)
 
+// Scanning ahead for the leading character class doesn't pay for itself if most characters are in
+// the class anyway
+#define MAX_SKIPPABLE_CLASS_SIZE 128
+
+// A run of literal characters is matched at most this many bytes at a time
+#define MAX_FUSED_LITERAL_SIZE 16
+
+// Optional CPU features of which the native code may make use. The set of features used by a given
+// piece of native code is recorded, so that serialized native code isn't run on a host that lacks
+// them
+enum { NF_SSSE3 = 1u << 0u, NF_AVX2 = 1u << 1u, NF_AVX512BW = 1u << 2u };
+
+// Registers used by bodies compiled from a DFA (see compile_dfa_body), in addition to R_STR and
+// R_SCRATCH{,_2}
+#define R_DFA_EOF RSI
+#define R_DFA_BYTE_CLASSES R8
+#define R_DFA_TARGET R9
+#define R_DFA_SCRATCH R10
+
+// A DFA state's transitions are dispatched with a tree of comparisons if they partition the bytes
+// into at most this many intervals, and with a jump table otherwise
+#define MAX_DFA_COMPARE_INTERVALS 8
+
+// Labels for the pieces of a body compiled from a DFA (see compile_dfa_states). There's a label for
+// each state, each state's jump table, and each transition's stub, of which only some are used
+typedef struct {
+  label_t first_state;
+  label_t first_table;
+  label_t first_stub;
+  label_t match;
+  label_t no_match;
+} dfa_labels_t;
+
+// Bump this whenever a change to the native compiler changes the calling convention or memory
+// layout assumed by previously-generated code
+#define NATIVE_CODE_VERSION 3
+
+// Each body of native code is padded to a multiple of this many bytes
+#define NATIVE_BODY_ALIGNMENT 16
+
+WUR static unsigned int host_native_features(void);
+
+WUR static unsigned int allowed_native_features(void);
+
+WUR static size_t native_code_fingerprint(void);
+
+WUR static size_t native_mode_n_pointers(native_mode_t mode, const regex_t *regex);
+
+WUR static int initial_char_class(char_class_t char_class, const regex_t *regex, int past_bof);
+
+WUR static int leading_char_class(char_class_t char_class, const regex_t *regex);
+
+WUR static int compile_body(assembler_t *as,
+                            const regex_t *regex,
+                            size_t n_pointers,
+                            const char_class_t leading_class,
+                            size_t skip_width,
+                            const allocator_t *allocator);
+
+WUR static int compile_dfa_body(assembler_t *as,
+                                const regex_t *regex,
+                                const char_class_t leading_class,
+                                size_t skip_width,
+                                const allocator_t *allocator);
+
+WUR static void *compile_set_to_native(size_t *size,
+                                      const dfa_t *dfa,
+                                      const regex_t *regex,
+                                      const allocator_t *allocator);
+
+WUR static int compile_dfa_states(assembler_t *as,
+                                  const dfa_t *dfa,
+                                  const char_class_t leading_class,
+                                  size_t skip_width,
+                                  const allocator_t *allocator);
+
+WUR static int
+compile_dfa_table_jump(assembler_t *as, label_t table_label, const allocator_t *allocator);
+
+WUR static label_t
+dfa_transition_label(const dfa_t *dfa, const dfa_labels_t *labels, size_t transition);
+
+WUR static label_t dfa_target_label(const dfa_labels_t *labels, size_t target);
+
+WUR static int compile_dfa_accepts(assembler_t *as,
+                                   const dfa_t *dfa,
+                                   size_t accept_set,
+                                   const allocator_t *allocator);
+
+WUR static size_t dfa_transition_intervals(size_t *starts,
+                                           label_t *interval_labels,
+                                           const dfa_t *dfa,
+                                           const dfa_labels_t *labels,
+                                           size_t state);
+
+WUR static int compile_dfa_compare_tree(assembler_t *as,
+                                        const size_t *starts,
+                                        const label_t *labels,
+                                        size_t n_intervals,
+                                        label_t fallthrough_label,
+                                        const allocator_t *allocator);
+
 WUR static int compile_prologue(assembler_t *as, size_t n_flags, const allocator_t *allocator);
 
-WUR static int
-compile_string_loop(assembler_t *as, const regex_t *regex, const allocator_t *allocator);
+WUR static int compile_string_loop(assembler_t *as,
+                                   const regex_t *regex,
+                                   size_t n_pointers,
+                                   size_t skip_width,
+                                   const allocator_t *allocator);
+
+WUR static int
+compile_leading_class_skip(assembler_t *as, size_t skip_width, const allocator_t *allocator);
+
+WUR static int compile_leading_class_scan_sse(assembler_t *as, const allocator_t *allocator);
+
+WUR static int compile_leading_class_scan_avx2(assembler_t *as, const allocator_t *allocator);
+
+WUR static int compile_leading_class_scan_avx512(assembler_t *as, const allocator_t *allocator);
+
+WUR static int compile_state_list_loop(assembler_t *as,
+                                       const regex_t *regex,
+                                       size_t n_pointers,
+                                       const allocator_t *allocator);
+
+WUR static int compile_epilogue(assembler_t *as, const allocator_t *allocator);
+
+WUR static int compile_allocator(assembler_t *as, size_t n_pointers, const allocator_t *allocator);
+
+WUR static int
+compile_push_state_copy(assembler_t *as, size_t n_pointers, const allocator_t *allocator);
+
+WUR static int compile_bytecode_instruction(assembler_t *as,
+                                            const regex_t *regex,
+                                            size_t n_pointers,
+                                            const unsigned char *initial_class,
+                                            size_t *index,
+                                            const allocator_t *allocator);
+
+WUR static int compile_fused_literal(assembler_t *as,
+                                     const regex_t *regex,
+                                     const unsigned char *initial_class,
+                                     unsigned char character,
+                                     size_t index,
+                                     const allocator_t *allocator);
+
+WUR static int compile_match(assembler_t *as, size_t n_pointers, const allocator_t *allocator);
+
+WUR static int compile_leading_class_tables(assembler_t *as,
+                                            const char_class_t char_class,
+                                            const allocator_t *allocator);
+
+WUR static int compile_debugging_boundary(assembler_t *as, const allocator_t *allocator);
+
+WUR static int perf_map_enabled(void);
+
+static void write_perf_map(const unsigned char *code,
+                           size_t size,
+                           const regex_t *regex,
+                           const char *body_name,
+                           const assembler_t *as,
+                           int has_leading_class_tables,
+                           const allocator_t *allocator);
+
+// The native code comprises one body per native_mode_t, each of which is a function specialized for
+// the corresponding number of pointers; entry_points receives the offset of each body within the
+// code. Bodies are assembled separately and then concatenated, which is fine because the code is
+// position-independent
+WUR static void *compile_to_native(size_t *size,
+                                  size_t *entry_points,
+                                  unsigned int *features,
+                                  const regex_t *regex,
+                                  const allocator_t *allocator) {
+  const unsigned int host_features = host_native_features();
+  *features = 0;
+
+  // If every match must begin with a character from some (sparse) class, the string loop can skip
+  // ahead a vector at a time while there are no live states, using the widest vectors available
+  char_class_t leading_class;
+  size_t skip_width = 0;
+
+  if (leading_char_class(leading_class, regex)) {
+    if (host_features & NF_AVX512BW) {
+      skip_width = 64;
+      *features |= NF_AVX512BW;
+    } else if (host_features & NF_AVX2) {
+      skip_width = 32;
+      *features |= NF_AVX2;
+    } else if (host_features & NF_SSSE3) {
+      skip_width = 16;
+      *features |= NF_SSSE3;
+    }
+  }
+
+  assembler_t bodies[N_NATIVE_MODES];
+  native_mode_t body_modes[N_NATIVE_MODES];
+  int body_is_dfa[N_NATIVE_MODES];
+  size_t n_bodies = 0;
+
+  size_t total_size = 0;
+
+  for (native_mode_t mode = 0; mode < N_NATIVE_MODES; mode++) {
+    const size_t n_pointers = native_mode_n_pointers(mode, regex);
+
+    // A regex without any explicit capturing groups only has the one for the whole match, in which
+    // case finds and group queries are the same thing
+    if (mode == NM_GROUPS && n_pointers == native_mode_n_pointers(NM_FIND, regex)) {
+      entry_points[mode] = entry_points[NM_FIND];
+      continue;
+    }
+
+    assembler_t *as = &bodies[n_bodies];
+
+    // Boolean searches run a DFA directly, if it's small enough
+    const int is_dfa = mode == NM_IS_MATCH &&
+                       compile_dfa_body(as, regex, leading_class, skip_width, allocator);
+
+    if (!is_dfa && !compile_body(as, regex, n_pointers, leading_class, skip_width, allocator)) {
+      while (n_bodies > 0) {
+        destroy_assembler(&bodies[--n_bodies], allocator);
+      }
+
+      return NULL;
+    }
+
+    body_modes[n_bodies] = mode;
+    body_is_dfa[n_bodies] = is_dfa;
+    n_bodies++;
+
+    entry_points[mode] = total_size;
+    total_size += (as->size + NATIVE_BODY_ALIGNMENT - 1) / NATIVE_BODY_ALIGNMENT *
+                  NATIVE_BODY_ALIGNMENT;
+  }
+
+  unsigned char *buffer = ALLOC(allocator, total_size);
+  unsigned char *code = NULL;
+
+  if (buffer != NULL) {
+    // Pad with int3
+    memset(buffer, 0xcc, total_size);
+
+    for (size_t i = 0, offset = 0; i < n_bodies; i++) {
+      memcpy(buffer + offset, bodies[i].code, bodies[i].size);
+      offset += (bodies[i].size + NATIVE_BODY_ALIGNMENT - 1) / NATIVE_BODY_ALIGNMENT *
+                NATIVE_BODY_ALIGNMENT;
+    }
+
+    code = allocate_native_code(buffer, total_size);
+    FREE(allocator, buffer);
+  }
+
+  if (code != NULL && perf_map_enabled()) {
+    static const char *const body_names[N_NATIVE_MODES] = {"is_match", "find", "groups"};
+
+    for (size_t i = 0; i < n_bodies; i++) {
+      write_perf_map(code + entry_points[body_modes[i]],
+                     bodies[i].size,
+                     regex,
+                     body_names[body_modes[i]],
+                     body_is_dfa[i] ? NULL : &bodies[i],
+                     skip_width != 0,
+                     allocator);
+    }
+  }
+
+  while (n_bodies > 0) {
+    destroy_assembler(&bodies[--n_bodies], allocator);
+  }
+
+  if (code != NULL) {
+    *size = total_size;
+  }
+
+  return code;
+}
+
+static size_t native_mode_n_pointers(native_mode_t mode, const regex_t *regex) {
+  switch (mode) {
+  case NM_IS_MATCH:
+    return 0;
+
+  case NM_FIND:
+    return 2;
+
+  case NM_GROUPS:
+    return 2 * regex->n_capturing_groups;
+
+  default:
+    UNREACHABLE();
+    return 0;
+  }
+}
+
+// Assemble a body specialized for queries yielding n_pointers pointers (with labels resolved, but
+// still in the assembler's buffer). On failure, the assembler is destroyed
+static int compile_body(assembler_t *as,
+                        const regex_t *regex,
+                        size_t n_pointers,
+                        const char_class_t leading_class,
+                        size_t skip_width,
+                        const allocator_t *allocator) {
+  create_assembler(as);
+
+  // Preallocate static labels and bytecode instruction labels
+  for (size_t i = 0; i < N_STATIC_LABELS + regex->bytecode.size; i++) {
+    const label_t label = create_label(as);
+
+#ifndef NDEBUG
+    assert(label == i);
+#else
+    (void)label;
+#endif
+  }
+
+#define CHECK_ERROR(expr)                                                                          \
+  do {                                                                                             \
+    if (!expr) {                                                                                   \
+      destroy_assembler(as, allocator);                                                            \
+      return 0;                                                                                    \
+    }                                                                                              \
+  } while (0)
+
+  // Main executor function body
+
+  CHECK_ERROR(compile_prologue(as, regex->n_flags, allocator));
+  CHECK_ERROR(compile_debugging_boundary(as, allocator));
+
+  CHECK_ERROR(compile_string_loop(as, regex, n_pointers, skip_width, allocator));
+  CHECK_ERROR(compile_debugging_boundary(as, allocator));
+
+  CHECK_ERROR(compile_epilogue(as, allocator));
+  CHECK_ERROR(compile_debugging_boundary(as, allocator));
+
+  // Utility functions called from elsewhere
+
+  CHECK_ERROR(compile_allocator(as, n_pointers, allocator));
+  CHECK_ERROR(compile_debugging_boundary(as, allocator));
+
+  CHECK_ERROR(compile_push_state_copy(as, n_pointers, allocator));
+  CHECK_ERROR(compile_debugging_boundary(as, allocator));
+
+  // Compiled regex program
+
+  // The characters on which a thread started after the beginning of the string can survive its
+  // first step, if known; this bounds how far literals can be fused
+  char_class_t initial_class;
+  const int has_initial_class = initial_char_class(initial_class, regex, 1);
+
+  for (size_t i = 0; i < regex->bytecode.size;) {
+    CHECK_ERROR(compile_bytecode_instruction(
+        as, regex, n_pointers, has_initial_class ? initial_class : NULL, &i, allocator));
+  }
+
+  CHECK_ERROR(compile_match(as, n_pointers, allocator));
+
+  // Constant data
+
+  if (skip_width != 0) {
+    CHECK_ERROR(compile_debugging_boundary(as, allocator));
+    CHECK_ERROR(compile_leading_class_tables(as, leading_class, allocator));
+  }
+
+  CHECK_ERROR(finalize_assembler(as, allocator));
+
+#undef CHECK_ERROR
+
+  return 1;
+}
+
+// Assemble a body for boolean searches that runs a DFA equivalent to the regex, if the DFA is small
+// enough. Yields 0 if it isn't, or on failure, in which case the assembler is destroyed
+static int compile_dfa_body(assembler_t *as,
+                            const regex_t *regex,
+                            const char_class_t leading_class,
+                            size_t skip_width,
+                            const allocator_t *allocator) {
+  dfa_t dfa;
+
+  if (!build_dfa(&dfa, regex, allocator)) {
+    return 0;
+  }
+
+  create_assembler(as);
+
+  // Only a few of the static labels are used, but they're allocated regardless so that they can be
+  // referred to by the same names
+  for (size_t i = 0; i < N_STATIC_LABELS; i++) {
+    const label_t label = create_label(as);
+    (void)label;
+  }
+
+  const int success = compile_dfa_states(as, &dfa, leading_class, skip_width, allocator) &&
+                      finalize_assembler(as, allocator);
+
+  destroy_dfa(&dfa, allocator);
+
+  if (!success) {
+    destroy_assembler(as, allocator);
+  }
+
+  return success;
+}
+
+// Compile a regex set's program to a single body, with the same calling convention as the body of
+// a regex's native code for boolean searches, except that the result is the bitmap of patterns to
+// which the body adds those which match. The body runs the set's DFA, or the program itself if
+// there is no DFA (i.e. dfa is NULL)
+static void *compile_set_to_native(size_t *size,
+                                   const dfa_t *dfa,
+                                   const regex_t *regex,
+                                   const allocator_t *allocator) {
+  assert(regex->n_patterns != 0);
+
+  assembler_t as;
+
+  if (dfa != NULL) {
+    create_assembler(&as);
+
+    for (size_t i = 0; i < N_STATIC_LABELS; i++) {
+      const label_t label = create_label(&as);
+      (void)label;
+    }
+
+    // Skipping ahead from idle states relies on a leading class for the whole program, which a
+    // set's program doesn't have (see leading_char_class)
+    if (!compile_dfa_states(&as, dfa, NULL, 0, allocator) || !finalize_assembler(&as, allocator)) {
+      destroy_assembler(&as, allocator);
+      return NULL;
+    }
+  } else if (!compile_body(&as, regex, 0, NULL, 0, allocator)) {
+    return NULL;
+  }
+
+  void *code = allocate_native_code(as.code, as.size);
+
+  if (code != NULL) {
+    *size = as.size;
+
+    if (perf_map_enabled()) {
+      write_perf_map(code, as.size, regex, "set", (dfa == NULL) ? &as : NULL, 0, allocator);
+    }
+  }
+
+  destroy_assembler(&as, allocator);
+
+  return code;
+}
+
+// The label to which a transition jumps: either its target's or, if some of a regex set's patterns
+// match on the transition, that of a stub which sets their bits and then jumps to the target.
+// Transitions from the same state with the same target and patterns share a stub
+static label_t
+dfa_transition_label(const dfa_t *dfa, const dfa_labels_t *labels, size_t transition) {
+  const size_t target = dfa->transitions[transition];
+
+  if (dfa->n_patterns == 0 || dfa->transition_accepts[transition] == 0) {
+    return dfa_target_label(labels, target);
+  }
+
+  size_t first = transition - transition % dfa->n_byte_classes;
+
+  while (dfa->transitions[first] != target ||
+         dfa->transition_accepts[first] != dfa->transition_accepts[transition]) {
+    first++;
+  }
+
+  return labels->first_stub + first;
+}
+
+static label_t dfa_target_label(const dfa_labels_t *labels, size_t target) {
+  switch (target) {
+  case DFA_MATCH:
+    return labels->match;
+
+  case DFA_NO_MATCH:
+    return labels->no_match;
+
+  default:
+    return labels->first_state + target;
+  }
+}
+
+// Set the bits of the patterns in the given set, in the bitmap at RDI
+static int compile_dfa_accepts(assembler_t *as,
+                               const dfa_t *dfa,
+                               size_t accept_set,
+                               const allocator_t *allocator) {
+  const unsigned char *accepts = dfa->accept_sets + dfa->accepts_size * accept_set;
+
+  for (size_t i = 0; i < dfa->accepts_size; i++) {
+    if (accepts[i] == 0) {
+      continue;
+    }
+
+    for (size_t j = 8 * i; j < 8 * i + 8; j++) {
+      if (bitmap_test(accepts, j)) {
+        ASM2(bts32_mem_u8, M_INDIRECT_REG_DISP(RDI, 4 * (j / 32)), j % 32);
+      }
+    }
+  }
+
+  return 1;
+}
+
+// Each state is a block which consumes a character and jumps to the block for the next state, so
+// there's no state list, allocation or flag bitmap; the only state is the position in the code.
+// For a regex set's DFA, the result is instead the bitmap of the set's patterns, which the caller
+// clears beforehand (and whose size is rounded up to a multiple of 4 bytes)
+static int compile_dfa_states(assembler_t *as,
+                              const dfa_t *dfa,
+                              const char_class_t leading_class,
+                              size_t skip_width,
+                              const allocator_t *allocator) {
+  dfa_labels_t labels;
+
+  labels.first_state = as->n_labels;
+
+  for (size_t i = 0; i < dfa->n_states; i++) {
+    const label_t label = create_label(as);
+    (void)label;
+  }
+
+  // Jump tables, for states that need them
+  labels.first_table = as->n_labels;
+
+  for (size_t i = 0; i < dfa->n_states; i++) {
+    const label_t label = create_label(as);
+    (void)label;
+  }
+
+  // Stubs, for transitions that need them
+  labels.first_stub = as->n_labels;
+
+  for (size_t i = 0; dfa->n_patterns != 0 && i < dfa->n_byte_classes * dfa->n_states; i++) {
+    const label_t label = create_label(as);
+    (void)label;
+  }
+
+  labels.match = create_label(as);
+  labels.no_match = create_label(as);
+
+  const label_t byte_classes_label = create_label(as);
+  const label_t resume_label = create_label(as);
+  const label_t initial_table_label = create_label(as);
+  const label_t return_label = create_label(as);
+
+  // We have the same parameters as in compile_prologue, of which we need only the result pointer,
+  // the context (for the previous character), str and eof. RCX is clobbered by the leading class
+  // scan, so eof is moved out of the way
+  assert(R_STR == RDX);
+
+  const size_t prev_character_offset = offsetof(context_t, prev_character);
+  ASM2(mov32_reg_mem, R_SCRATCH, M_INDIRECT_REG_DISP(RSI, prev_character_offset));
+
+  ASM2(mov64_reg_reg, R_DFA_EOF, RCX);
+  ASM2(lea64_reg_label, R_DFA_BYTE_CLASSES, byte_classes_label);
+
+  // Start in state 0 (whose block follows) at the beginning of the input, and otherwise in the
+  // initial state for the previous character
+  ASM2(cmp32_reg_i8, R_SCRATCH, -1);
+  ASM2(jcc_label, JCC_JNE, resume_label);
+
+  // Each state's transitions, as a partition of the bytes into intervals
+  size_t starts[256];
+  label_t interval_labels[256];
+
+  for (size_t state = 0; state < dfa->n_states; state++) {
+    ASM1(define_label, labels.first_state + state);
+
+    // No pattern of a regex set can match from here on (so neither can any at the EOF)
+    if (dfa->n_patterns != 0 && dfa->finished[state]) {
+      ASM1(jmp_label, return_label);
+      continue;
+    }
+
+    // If the state has no threads and a match must begin with a character from the leading class,
+    // skip ahead to the next such character. Skipping over a character that isn't in the class
+    // leads to a state without threads, so if we skipped anything we back up a character and take
+    // the usual transition
+    if (skip_width != 0 && dfa->idle[state]) {
+      const label_t post_skip_label = create_label(as);
+
+      ASM2(mov64_reg_reg, R_SCRATCH_2, R_DFA_EOF);
+      ASM2(sub64_reg_reg, R_SCRATCH_2, R_STR);
+      ASM2(cmp64_reg_i8, R_SCRATCH_2, skip_width);
+      ASM2(jcc_label, JCC_JB, post_skip_label);
+
+      ASM2(mov64_reg_reg, R_DFA_TARGET, R_STR);
+      ASM2(lea64_reg_label, R_SCRATCH, LABEL_LEADING_CLASS_TABLES);
+
+      switch (skip_width) {
+      case 16: {
+        if (!compile_leading_class_scan_sse(as, allocator)) {
+          return 0;
+        }
+
+        break;
+      }
+
+      case 32: {
+        if (!compile_leading_class_scan_avx2(as, allocator)) {
+          return 0;
+        }
+
+        break;
+      }
+
+      case 64: {
+        if (!compile_leading_class_scan_avx512(as, allocator)) {
+          return 0;
+        }
+
+        break;
+      }
+
+      default:
+        assert(0);
+      }
+
+      ASM2(cmp64_reg_reg, R_STR, R_DFA_TARGET);
+      ASM2(jcc_label, JCC_JE, post_skip_label);
+      ASM2(sub64_reg_i8, R_STR, 1);
+
+      ASM1(define_label, post_skip_label);
+    }
+
+    ASM2(cmp64_reg_reg, R_STR, R_DFA_EOF);
+
+    if (dfa->n_patterns == 0) {
+      ASM2(jcc_label, JCC_JE, dfa->eof_matches[state] ? labels.match : labels.no_match);
+    } else if (dfa->eof_accepts[state] == 0) {
+      ASM2(jcc_label, JCC_JE, return_label);
+    } else {
+      const label_t continue_label = create_label(as);
+
+      ASM2(jcc_label, JCC_JNE, continue_label);
+
+      if (!compile_dfa_accepts(as, dfa, dfa->eof_accepts[state], allocator)) {
+        return 0;
+      }
+
+      ASM1(jmp_label, return_label);
+      ASM1(define_label, continue_label);
+    }
+
+    ASM2(movzx328_reg_mem, R_SCRATCH, M_INDIRECT_REG(R_STR));
+    ASM1(inc64_reg, R_STR);
+
+    const size_t n_intervals =
+        dfa_transition_intervals(starts, interval_labels, dfa, &labels, state);
+
+    if (n_intervals <= MAX_DFA_COMPARE_INTERVALS) {
+      // The next state's block follows immediately
+      const label_t fallthrough_label =
+          (state + 1 < dfa->n_states) ? labels.first_state + state + 1 : SIZE_MAX;
+
+      if (!compile_dfa_compare_tree(
+              as, starts, interval_labels, n_intervals, fallthrough_label, allocator)) {
+        return 0;
+      }
+
+      continue;
+    }
+
+    if (!compile_dfa_table_jump(as, labels.first_table + state, allocator)) {
+      return 0;
+    }
+  }
+
+  ASM1(define_label, resume_label);
+
+  if (!compile_dfa_table_jump(as, initial_table_label, allocator)) {
+    return 0;
+  }
+
+  // Either way, the return value is CREX_OK
+  assert(CREX_OK == 0);
+  assert(sizeof(int) == 4 || sizeof(int) == 8);
+
+  if (dfa->n_patterns != 0) {
+    ASM1(define_label, return_label);
+    ASM2(xor32_reg_reg, R_SCRATCH, R_SCRATCH);
+    ASM0(ret);
+  }
+
+  for (int matched = 1; dfa->n_patterns == 0 && matched >= 0; matched--) {
+    ASM1(define_label, matched ? labels.match : labels.no_match);
+
+    if (sizeof(int) == 4) {
+      ASM2(mov32_mem_i32, M_INDIRECT_REG(RDI), matched);
+    } else {
+      ASM2(mov64_mem_i32, M_INDIRECT_REG(RDI), matched);
+    }
+
+    ASM2(xor32_reg_reg, R_SCRATCH, R_SCRATCH);
+    ASM0(ret);
+  }
+
+  for (size_t i = 0; dfa->n_patterns != 0 && i < dfa->n_byte_classes * dfa->n_states; i++) {
+    if (dfa_transition_label(dfa, &labels, i) != labels.first_stub + i) {
+      continue;
+    }
+
+    ASM1(define_label, labels.first_stub + i);
+
+    if (!compile_dfa_accepts(as, dfa, dfa->transition_accepts[i], allocator)) {
+      return 0;
+    }
+
+    ASM1(jmp_label, dfa_target_label(&labels, dfa->transitions[i]));
+  }
+
+  // Constant data
+
+  if (!compile_debugging_boundary(as, allocator)) {
+    return 0;
+  }
+
+  ASM1(define_label, byte_classes_label);
+
+  if (!emit_assembler_data(as, dfa->byte_classes, sizeof(dfa->byte_classes), allocator)) {
+    return 0;
+  }
+
+  for (size_t state = 0; state < dfa->n_states; state++) {
+    if (dfa->n_patterns != 0 && dfa->finished[state]) {
+      continue;
+    }
+
+    if (dfa_transition_intervals(starts, interval_labels, dfa, &labels, state) <=
+        MAX_DFA_COMPARE_INTERVALS) {
+      continue;
+    }
+
+    ASM1(define_label, labels.first_table + state);
+
+    for (size_t byte_class = 0; byte_class < dfa->n_byte_classes; byte_class++) {
+      const size_t transition = dfa->n_byte_classes * state + byte_class;
+      ASM1(emit_label_offset, dfa_transition_label(dfa, &labels, transition));
+    }
+  }
+
+  ASM1(define_label, initial_table_label);
+
+  for (size_t byte_class = 0; byte_class < dfa->n_byte_classes; byte_class++) {
+    ASM1(emit_label_offset, dfa_target_label(&labels, dfa->initial_states[byte_class]));
+  }
+
+  if (skip_width != 0 && !compile_leading_class_tables(as, leading_class, allocator)) {
+    return 0;
+  }
+
+  return 1;
+}
+
+// Jump through the table at table_label, by the byte class of the character in R_SCRATCH. Each
+// entry of the table holds the displacement from the entry to its target
+static int
+compile_dfa_table_jump(assembler_t *as, label_t table_label, const allocator_t *allocator) {
+  ASM2(movzx328_reg_mem, R_SCRATCH, M_INDIRECT_BSXD(R_DFA_BYTE_CLASSES, SCALE_1, R_SCRATCH, 0));
+
+  ASM2(lea64_reg_label, R_DFA_TARGET, table_label);
+  ASM2(lea64_reg_mem, R_DFA_TARGET, M_INDIRECT_BSXD(R_DFA_TARGET, SCALE_4, R_SCRATCH, 0));
+  ASM2(movsxd64_reg_mem, R_DFA_SCRATCH, M_INDIRECT_REG(R_DFA_TARGET));
+  ASM2(add64_reg_reg, R_DFA_TARGET, R_DFA_SCRATCH);
+  ASM1(jmp_reg, R_DFA_TARGET);
+
+  return 1;
+}
+
+// Partition the bytes into maximal intervals of bytes on which the state's transitions go to the
+// same label. Yields the number of intervals
+static size_t dfa_transition_intervals(size_t *starts,
+                                       label_t *interval_labels,
+                                       const dfa_t *dfa,
+                                       const dfa_labels_t *labels,
+                                       size_t state) {
+  size_t n_intervals = 0;
+
+  for (size_t c = 0; c <= 255; c++) {
+    const size_t transition = dfa->n_byte_classes * state + dfa->byte_classes[c];
+    const label_t label = dfa_transition_label(dfa, labels, transition);
+
+    if (n_intervals == 0 || interval_labels[n_intervals - 1] != label) {
+      starts[n_intervals] = c;
+      interval_labels[n_intervals] = label;
+      n_intervals++;
+    }
+  }
+
+  return n_intervals;
+}
+
+// Dispatch R_SCRATCH to the label for the interval containing it, by binary search. The code for
+// the last interval may fall through to fallthrough_label, if it's the same label
+static int compile_dfa_compare_tree(assembler_t *as,
+                                    const size_t *starts,
+                                    const label_t *labels,
+                                    size_t n_intervals,
+                                    label_t fallthrough_label,
+                                    const allocator_t *allocator) {
+  assert(n_intervals > 0);
+
+  if (n_intervals == 1) {
+    if (labels[0] != fallthrough_label) {
+      ASM1(jmp_label, labels[0]);
+    }
+
+    return 1;
+  }
+
+  const size_t mid = n_intervals / 2;
+  const label_t upper_label = create_label(as);
+
+  if (starts[mid] <= 127) {
+    ASM2(cmp32_reg_i8, R_SCRATCH, starts[mid]);
+  } else {
+    ASM2(cmp32_reg_i32, R_SCRATCH, starts[mid]);
+  }
+
+  ASM2(jcc_label, JCC_JAE, upper_label);
+
+  if (!compile_dfa_compare_tree(as, starts, labels, mid, SIZE_MAX, allocator)) {
+    return 0;
+  }
+
+  ASM1(define_label, upper_label);
+
+  return compile_dfa_compare_tree(
+      as, starts + mid, labels + mid, n_intervals - mid, fallthrough_label, allocator);
+}
+
+static unsigned int host_native_features(void) {
+  unsigned int features = 0;
+
+#if defined(__GNUC__) || defined(__clang__)
+  unsigned int eax, ebx, ecx, edx;
+
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+    return 0;
+  }
+
+  if (ecx & bit_SSSE3) {
+    features |= NF_SSSE3;
+  }
 
-WUR static int
-compile_state_list_loop(assembler_t *as, const regex_t *regex, const allocator_t *allocator);
+  // The wider vector registers are only usable if the OS saves and restores them, as indicated by
+  // XCR0: bits 1 and 2 for the SSE and AVX state, and 5 through 7 for the AVX-512 state
+  if ((ecx & bit_OSXSAVE) && (ecx & bit_AVX) && __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+    unsigned int xcr0;
+    __asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(edx) : "c"(0));
 
-WUR static int compile_epilogue(assembler_t *as, const allocator_t *allocator);
+    if ((xcr0 & 0x06u) == 0x06u && (ebx & bit_AVX2)) {
+      features |= NF_AVX2;
+    }
 
-WUR static int compile_allocator(assembler_t *as, const allocator_t *allocator);
+    if ((xcr0 & 0xe6u) == 0xe6u && (ebx & bit_AVX512F) && (ebx & bit_AVX512BW)) {
+      features |= NF_AVX512BW;
+    }
+  }
+#endif
 
-WUR static int
-compile_push_state_copy(assembler_t *as, size_t n_capturing_groups, const allocator_t *allocator);
+  return features & allowed_native_features();
+}
 
-WUR static int compile_bytecode_instruction(assembler_t *as,
-                                            regex_t *regex,
-                                            size_t *index,
-                                            const allocator_t *allocator);
+// CREX_NATIVE_ISA can be used to cap the instruction set extensions used by native code, e.g. to
+// avoid the clock speed penalties associated with AVX-512 on some CPUs
+static unsigned int allowed_native_features(void) {
+  static const struct {
+    const char *name;
+    unsigned int features;
+  } isas[] = {{"sse2", 0},
+              {"ssse3", NF_SSSE3},
+              {"avx2", NF_SSSE3 | NF_AVX2},
+              {"avx512", NF_SSSE3 | NF_AVX2 | NF_AVX512BW}};
+
+  const char *value = getenv("CREX_NATIVE_ISA");
+
+  if (value != NULL) {
+    for (size_t i = 0; i < sizeof(isas) / sizeof(*isas); i++) {
+      if (strcmp(value, isas[i].name) == 0) {
+        return isas[i].features;
+      }
+    }
+  }
 
-WUR static int compile_match(assembler_t *as, const allocator_t *allocator);
+  return ~0u;
+}
 
-WUR static int compile_debugging_boundary(assembler_t *as, const allocator_t *allocator);
+// Identifies the ABI of generated native code, i.e. everything other than the CPU features on which
+// the code depends. Serialized native code is only reused by a build with the same fingerprint
+static size_t native_code_fingerprint(void) {
+  const size_t values[] = {NATIVE_CODE_VERSION,
+                           sizeof(int),
+                           sizeof(size_t),
+                           sizeof(match_t),
+                           offsetof(context_t, buffer),
+                           offsetof(context_t, capacity),
+                           offsetof(context_t, prev_character),
+                           offsetof(context_t, allocator),
+                           offsetof(allocator_t, context),
+                           offsetof(allocator_t, alloc),
+                           offsetof(allocator_t, free)};
+
+  // 32-bit FNV-1a
+  size_t hash = 0x811c9dc5LU;
+
+  for (size_t i = 0; i < sizeof(values) / sizeof(*values); i++) {
+    for (size_t j = 0; j < sizeof(size_t); j++) {
+      hash ^= (values[i] >> (8 * j)) & 0xffu;
+      hash = (hash * 0x01000193LU) & 0xffffffffLU;
+    }
+  }
 
-WUR static status_t compile_to_native(regex_t *regex, const allocator_t *allocator) {
-  assembler_t as;
-  create_assembler(&as);
+  return hash;
+}
 
-  // Preallocate static labels and bytecode instruction labels
-  for (size_t i = 0; i < N_STATIC_LABELS + regex->bytecode.size; i++) {
-    const label_t label = create_label(&as);
+// Yields 1 and populates char_class with the set of characters which a thread starting from the
+// beginning of the program can consume in its first step, if that set can be determined without
+// following any control flow. If past_bof is set, the set is for threads starting anywhere other
+// than the beginning of the string
+static int initial_char_class(char_class_t char_class, const regex_t *regex, int past_bof) {
+  const unsigned char *code = regex->bytecode.code;
+  size_t index = 0;
+
+  // Pointer writes can't fail, so look past them to the first instruction that consumes a character
+  for (;;) {
+    if (index == regex->bytecode.size) {
+      return 0;
+    }
 
-#ifndef NDEBUG
-    assert(label == i);
-#else
-    (void)label;
-#endif
-  }
+    const unsigned char byte = code[index++];
 
-#define CHECK_ERROR(expr)                                                                          \
-  do {                                                                                             \
-    if (!expr) {                                                                                   \
-      destroy_assembler(&as, allocator);                                                           \
-      return CREX_E_NOMEM;                                                                         \
-    }                                                                                              \
-  } while (0)
+    const unsigned char opcode = VM_OPCODE(byte);
+    const size_t operand_size = VM_OPERAND_SIZE(byte);
 
-  // Main executor function body
+    const size_t operand = deserialize_operand(code + index, operand_size);
+    index += operand_size;
 
-  CHECK_ERROR(compile_prologue(&as, regex->n_flags, allocator));
-  CHECK_ERROR(compile_debugging_boundary(&as, allocator));
+    if (opcode == VM_WRITE_POINTER) {
+      continue;
+    }
 
-  CHECK_ERROR(compile_string_loop(&as, regex, allocator));
-  CHECK_ERROR(compile_debugging_boundary(&as, allocator));
+    switch (opcode) {
+    case VM_ANCHOR_BOF: {
+      if (!past_bof) {
+        return 0;
+      }
 
-  CHECK_ERROR(compile_epilogue(&as, allocator));
-  CHECK_ERROR(compile_debugging_boundary(&as, allocator));
+      bitmap_clear(char_class, sizeof(char_class_t));
+      return 1;
+    }
 
-  // Utility functions called from elsewhere
+    case VM_CHARACTER: {
+      bitmap_clear(char_class, sizeof(char_class_t));
+      bitmap_set(char_class, operand);
+      return 1;
+    }
 
-  CHECK_ERROR(compile_allocator(&as, allocator));
-  CHECK_ERROR(compile_debugging_boundary(&as, allocator));
+    case VM_CHAR_CLASS:
+    case VM_BUILTIN_CHAR_CLASS: {
+      const unsigned char *bitmap =
+          (opcode == VM_CHAR_CLASS) ? regex->classes[operand] : builtin_classes[operand];
 
-  CHECK_ERROR(compile_push_state_copy(&as, regex->n_capturing_groups, allocator));
-  CHECK_ERROR(compile_debugging_boundary(&as, allocator));
+      memcpy(char_class, bitmap, sizeof(char_class_t));
 
-  // Compiled regex program
+      return 1;
+    }
 
-  for (size_t i = 0; i < regex->bytecode.size;) {
-    CHECK_ERROR(compile_bytecode_instruction(&as, regex, &i, allocator));
+    default:
+      return 0;
+    }
   }
+}
 
-  CHECK_ERROR(compile_match(&as, allocator));
-
-#undef CHECK_ERROR
+static int leading_char_class(char_class_t char_class, const regex_t *regex) {
+  if (!initial_char_class(char_class, regex, 0)) {
+    return 0;
+  }
 
-  regex->native_code.code = finalize_assembler(&regex->native_code.size, &as, allocator);
+  size_t class_size = 0;
 
-  if (regex->native_code.code == NULL) {
-    return CREX_E_NOMEM;
+  for (size_t c = 0; c <= 255; c++) {
+    class_size += bitmap_test(char_class, c);
   }
 
-  return CREX_OK;
+  return class_size <= MAX_SKIPPABLE_CLASS_SIZE;
 }
 
 static int compile_prologue(assembler_t *as, size_t n_flags, const allocator_t *allocator) {
@@ -210,17 +1124,18 @@ static int compile_prologue(assembler_t *as, size_t n_flags, const allocator_t *
   }
 
   // We have parameters:
-  // - RDI: result pointer  (int* or match_t*)
-  // - RSI: context pointer (context_t*)
-  // - RDX: str             (const char*)
-  // - RCX: eof             (const char*)
-  // - R8:  n_pointers      (size_t)
-  // - R9:  classes         (const unsigned char*)
-
-  // str, n_pointers, and classes should already be in the correct place
+  // - RDI: result pointer   (int* or match_t*, depending on the body)
+  // - RSI: context pointer  (context_t*)
+  // - RDX: str              (const char*)
+  // - RCX: eof              (const char*)
+  // - R8:  classes          (const unsigned char*)
+  // - R9:  builtin classes  (const unsigned char*). This is passed in, rather than baked into the
+  //   machine code, so that the machine code is position-independent
+
+  // str and both sets of classes should already be in the correct place
   assert(R_STR == RDX);
-  assert(R_N_POINTERS == R8);
-  assert(R_CHAR_CLASSES == R9);
+  assert(R_CHAR_CLASSES == R8);
+  assert(R_BUILTIN_CHAR_CLASSES == R9);
 
   // M_CONTEXT
   ASM1(push64_reg, RSI);
@@ -255,14 +1170,6 @@ static int compile_prologue(assembler_t *as, size_t n_flags, const allocator_t *
   ASM2(mov64_reg_mem, R_BUFFER, M_INDIRECT_REG_DISP(RSI, offsetof(context_t, buffer)));
   ASM2(mov64_reg_mem, R_CAPACITY, M_INDIRECT_REG_DISP(RSI, offsetof(context_t, capacity)));
 
-  const uint64_t builtin_classes_uint = (uint64_t)builtin_classes;
-
-  if (builtin_classes_uint <= 0xffffffffLU) {
-    ASM2(mov32_reg_u32, R_BUILTIN_CHAR_CLASSES, builtin_classes_uint);
-  } else {
-    ASM2(mov64_reg_u64, R_BUILTIN_CHAR_CLASSES, builtin_classes_uint);
-  }
-
   ASM2(xor32_reg_reg, R_BUMP_POINTER, R_BUMP_POINTER);
   ASM2(mov64_reg_i32, R_FREELIST, -1);
 
@@ -276,9 +1183,17 @@ static int compile_prologue(assembler_t *as, size_t n_flags, const allocator_t *
   return 1;
 }
 
-static int
-compile_string_loop(assembler_t *as, const regex_t *regex, const allocator_t *allocator) {
-  ASM2(mov32_reg_i32, R_CHARACTER, -1);
+static int compile_string_loop(assembler_t *as,
+                               const regex_t *regex,
+                               size_t n_pointers,
+                               size_t skip_width,
+                               const allocator_t *allocator) {
+  // The string may be a suffix of the input (e.g. when iterating over matches), in which case the
+  // previous character is supplied through the context
+  const size_t prev_character_offset = offsetof(context_t, prev_character);
+
+  ASM2(mov64_reg_mem, R_SCRATCH, M_CONTEXT);
+  ASM2(mov32_reg_mem, R_CHARACTER, M_INDIRECT_REG_DISP(R_SCRATCH, prev_character_offset));
 
   // Loop over the string, up to and including the EOF position
 
@@ -289,6 +1204,10 @@ compile_string_loop(assembler_t *as, const regex_t *regex, const allocator_t *al
 
   ASM2(mov32_reg_reg, R_PREV_CHARACTER, R_CHARACTER);
 
+  if (skip_width != 0 && !compile_leading_class_skip(as, skip_width, allocator)) {
+    return 0;
+  }
+
   // Let R_CHARACTER := -1 if R_STR == M_EOF, [R_STR] otherwise. N.B. there's no 8-bit cmov
 
   ASM2(mov32_reg_i32, R_CHARACTER, -1);
@@ -302,10 +1221,23 @@ compile_string_loop(assembler_t *as, const regex_t *regex, const allocator_t *al
   BRANCH_TARGET(eof);
 
   // Process the list of states
-  if (!compile_state_list_loop(as, regex, allocator)) {
+  if (!compile_state_list_loop(as, regex, n_pointers, allocator)) {
     return 0;
   }
 
+  // If there are no live states and we've already found a match, no further match is possible, so
+  // stop rather than running out the rest of the string (which would make iterating over the
+  // matches of e.g. x* quadratic). Boolean searches return as soon as they find a match. Both tests
+  // are folded into one branch, since a branch macro can't span the jcc_label
+  if (n_pointers != 0) {
+    ASM2(mov64_reg_mem, R_SCRATCH, M_MATCHED_STATE);
+    ASM2(mov64_reg_i32, R_SCRATCH_2, -1);
+    ASM2(cmp64_mem_i8, M_HEAD, -1);
+    ASM2(cmovne64_reg_reg, R_SCRATCH, R_SCRATCH_2);
+    ASM2(cmp64_reg_i8, R_SCRATCH, -1);
+    ASM2(jcc_label, JCC_JNE, LABEL_POST_STRING_LOOP);
+  }
+
   // Break if R_STR == M_EOF. We need to check this before the increment to prevent an overflow when
   // M_EOF == 0xffffffffffffffff; this means we need two cmps instead of one
   ASM2(cmp64_reg_mem, R_STR, M_EOF);
@@ -321,77 +1253,292 @@ compile_string_loop(assembler_t *as, const regex_t *regex, const allocator_t *al
 
   ASM2(mov64_reg_mem, R_SCRATCH, M_RESULT);
 
-  ASM2(cmp64_reg_i8, R_N_POINTERS, 0);
-  ASM2(jcc_label, JCC_JNE, LABEL_FIND_OR_GROUPS_CODA);
+  if (regex->n_patterns != 0) {
+    // We're running a regex set's program, which never matches as such; its patterns' matches are
+    // already in the result (see VM_ACCEPT)
+  } else if (n_pointers == 0) {
+    // We're performing a boolean search. Because boolean searches short-circuit on match, if we
+    // reach this point there was no match. Set the result equal to zero
 
-  // R_N_POINTERS == 0, i.e. we're performing a boolean search. Because boolean searches
-  // short-circuit on match, if we reach this point there was no match. Set the result equal to zero
-
-  assert(sizeof(int) == 4 || sizeof(int) == 8);
+    assert(sizeof(int) == 4 || sizeof(int) == 8);
 
-  if (sizeof(int) == 4) {
-    ASM2(mov32_mem_i32, M_INDIRECT_REG(R_SCRATCH), 0);
+    if (sizeof(int) == 4) {
+      ASM2(mov32_mem_i32, M_INDIRECT_REG(R_SCRATCH), 0);
+    } else {
+      ASM2(mov64_mem_i32, M_INDIRECT_REG(R_SCRATCH), 0);
+    }
   } else {
-    ASM2(mov64_mem_i32, M_INDIRECT_REG(R_SCRATCH), 0);
+    // We're performing a find (n_pointers == 2) or a group query (n_pointers == 2 *
+    // regex->n_capturing_groups)
+
+    ASM2(mov64_reg_mem, R_SCRATCH_2, M_MATCHED_STATE);
+
+    ASM2(cmp64_reg_i8, R_SCRATCH_2, -1);
+    ASM2(jcc_label, JCC_JE, LABEL_FIND_OR_GROUPS_NO_MATCH);
+
+    // Copy the pointer buffer of the matched state into the result
+
+    for (size_t i = 0; i < n_pointers; i++) {
+      // Clobber R_PREDECESSOR; we won't need it again
+      ASM2(mov64_reg_mem, R_PREDECESSOR, M_DISPLACED(M_DEREF_HANDLE(R_SCRATCH_2), 16 + 8 * i));
+      ASM2(mov64_mem_reg, M_DISPLACED(M_INDIRECT_REG(R_SCRATCH), 8 * i), R_PREDECESSOR);
+    }
+
+    // Don't fall through
+    ASM1(jmp_label, LABEL_RETURN_OK);
+
+    ASM1(define_label, LABEL_FIND_OR_GROUPS_NO_MATCH);
+
+    // Fill the result with NULLs
+
+    for (size_t i = 0; i < n_pointers; i++) {
+      assert((size_t)NULL == 0);
+      ASM2(mov64_mem_i32, M_DISPLACED(M_INDIRECT_REG(R_SCRATCH), 8 * i), 0);
+    }
   }
 
-  // Don't fall through to the next case
-  ASM1(jmp_label, LABEL_RETURN_OK);
+  ASM1(define_label, LABEL_RETURN_OK);
+
+  // Set the return value to CREX_OK
+  assert(CREX_OK == 0);
+  ASM2(xor32_reg_reg, R_SCRATCH, R_SCRATCH);
+
+  // Fall through to the function epilogue
 
-  ASM1(define_label, LABEL_FIND_OR_GROUPS_CODA);
+  return 1;
+}
 
-  // Two possibilities: R_N_POINTERS is exactly 2 (in the case of a find), or R_N_POINTERS is
-  // exactly 2 * regex->n_capturing_groups (in the case of a group query)
+static int
+compile_leading_class_skip(assembler_t *as, size_t skip_width, const allocator_t *allocator) {
+  // The scan only applies when no states are live, i.e. when the next thing to happen is that the
+  // initial state is pushed at R_STR and immediately tests R_CHARACTER against the leading class.
+  // (No match has been found yet, or the string loop would already have stopped)
+  ASM2(cmp64_mem_i8, M_HEAD, -1);
+  ASM2(jcc_label, JCC_JNE, LABEL_POST_LEADING_CLASS_SKIP);
+
+  // R_SCRATCH_2 holds the number of bytes remaining. The last few bytes (and the EOF position) are
+  // left to the scalar loop
+  ASM2(mov64_reg_mem, R_SCRATCH_2, M_EOF);
+  ASM2(sub64_reg_reg, R_SCRATCH_2, R_STR);
+  ASM2(cmp64_reg_i8, R_SCRATCH_2, skip_width);
+  ASM2(jcc_label, JCC_JB, LABEL_POST_LEADING_CLASS_SKIP);
+
+  // R_PREDECESSOR is reinitialized by the state list loop, so we can borrow it to remember where
+  // the scan started
+  ASM2(mov64_reg_reg, R_PREDECESSOR, R_STR);
+
+  // Load the tables emitted by compile_leading_class_tables; see there for the layout
+  ASM2(lea64_reg_label, R_SCRATCH, LABEL_LEADING_CLASS_TABLES);
+
+  // Each scan advances R_STR to the first character in the class, or for as long as a whole vector
+  // remains
+  switch (skip_width) {
+  case 16: {
+    if (!compile_leading_class_scan_sse(as, allocator)) {
+      return 0;
+    }
 
-  ASM2(mov64_reg_mem, R_SCRATCH_2, M_MATCHED_STATE);
+    break;
+  }
 
-  ASM2(cmp64_reg_i8, R_SCRATCH_2, -1);
-  ASM2(jcc_label, JCC_JE, LABEL_FIND_OR_GROUPS_NO_MATCH);
+  case 32: {
+    if (!compile_leading_class_scan_avx2(as, allocator)) {
+      return 0;
+    }
 
-  // Copy the pointer buffer of the matched state into the result
+    break;
+  }
 
-  for (size_t i = 0; i < 2 * regex->n_capturing_groups; i++) {
-    if (i == 2) {
-      ASM2(cmp64_reg_i8, R_N_POINTERS, 2);
-      ASM2(jcc_label, JCC_JE, LABEL_RETURN_OK);
+  case 64: {
+    if (!compile_leading_class_scan_avx512(as, allocator)) {
+      return 0;
     }
 
-    // Clobber R_PREDECESSOR; we won't need it again
+    break;
+  }
 
-    ASM2(mov64_reg_mem, R_PREDECESSOR, M_DISPLACED(M_DEREF_HANDLE(R_SCRATCH_2), 16 + 8 * i));
-    ASM2(mov64_mem_reg, M_DISPLACED(M_INDIRECT_REG(R_SCRATCH), 8 * i), R_PREDECESSOR);
+  default:
+    assert(0);
   }
 
-  // Don't fall through
-  ASM1(jmp_label, LABEL_RETURN_OK);
+  // If we skipped anything, the previous character is no longer the one loaded in the last
+  // iteration of the string loop
+  ASM2(cmp64_reg_reg, R_STR, R_PREDECESSOR);
+  BRANCH(je_i8, not_advanced);
 
-  ASM1(define_label, LABEL_FIND_OR_GROUPS_NO_MATCH);
+  ASM2(movzx328_reg_mem, R_PREV_CHARACTER, M_INDIRECT_REG_DISP(R_STR, -1));
 
-  // Fill the result with NULLs
+  BRANCH_TARGET(not_advanced);
 
-  for (size_t i = 0; i < 2 * regex->n_capturing_groups; i++) {
-    if (i == 2) {
-      ASM2(cmp64_reg_i8, R_N_POINTERS, 2);
-      ASM2(jcc_label, JCC_JE, LABEL_RETURN_OK);
-    }
+  ASM1(define_label, LABEL_POST_LEADING_CLASS_SKIP);
 
-    assert((size_t)NULL == 0);
-    ASM2(mov64_mem_i32, M_DISPLACED(M_INDIRECT_REG(R_SCRATCH), 8 * i), 0);
+  return 1;
+}
+
+static int compile_leading_class_scan_sse(assembler_t *as, const allocator_t *allocator) {
+  for (size_t i = 0; i < 6; i++) {
+    ASM2(movdqu_xmm_mem, XMM8 + i, M_INDIRECT_REG_DISP(R_SCRATCH, 16 * i));
   }
 
-  ASM1(define_label, LABEL_RETURN_OK);
+  ASM2(pxor_xmm_xmm, XMM14, XMM14);
 
-  // Set the return value to CREX_OK
-  assert(CREX_OK == 0);
-  ASM2(xor32_reg_reg, R_SCRATCH, R_SCRATCH);
+  BACKWARDS_BRANCH_TARGET(loop_head);
 
-  // Fall through to the function epilogue
+  ASM2(movdqu_xmm_mem, XMM0, M_INDIRECT_REG(R_STR));
+
+  // Look up the row of the bitmap for each character's low nibble. pshufb yields zero for indices
+  // with the high bit set, so masking with 0x8f (or 0x8f ^ 0x80) selects the half of the bitmap
+  // corresponding to the character's high bit
+  ASM2(movdqa_xmm_xmm, XMM1, XMM0);
+  ASM2(pand_xmm_xmm, XMM1, XMM12);
+  ASM2(movdqa_xmm_xmm, XMM2, XMM8);
+  ASM2(pshufb_xmm_xmm, XMM2, XMM1);
+
+  ASM2(pxor_xmm_xmm, XMM1, XMM13);
+  ASM2(movdqa_xmm_xmm, XMM3, XMM9);
+  ASM2(pshufb_xmm_xmm, XMM3, XMM1);
+
+  ASM2(por_xmm_xmm, XMM2, XMM3);
+
+  // Select the bit within the row corresponding to the remaining 3 bits of the high nibble
+  ASM2(psrlw_xmm_u8, XMM0, 4);
+  ASM2(pand_xmm_xmm, XMM0, XMM11);
+  ASM2(movdqa_xmm_xmm, XMM3, XMM10);
+  ASM2(pshufb_xmm_xmm, XMM3, XMM0);
+
+  ASM2(pand_xmm_xmm, XMM2, XMM3);
+
+  // Bit k of R_SCRATCH is clear iff the kth character is in the class
+  ASM2(pcmpeqb_xmm_xmm, XMM2, XMM14);
+  ASM2(pmovmskb_reg_xmm, R_SCRATCH, XMM2);
+
+  ASM2(cmp32_reg_u32, R_SCRATCH, 0xffff);
+  BRANCH(jne_i8, found);
+
+  ASM2(add64_reg_i8, R_STR, 16);
+  ASM2(sub64_reg_i8, R_SCRATCH_2, 16);
+  ASM2(cmp64_reg_i8, R_SCRATCH_2, 16);
+  BACKWARDS_BRANCH(jnc_i8, loop_head);
+
+  BRANCH(jmp_i8, exhausted);
+
+  BRANCH_TARGET(found);
+
+  ASM1(not32_reg, R_SCRATCH);
+  ASM2(bsf32_reg_reg, R_SCRATCH, R_SCRATCH);
+  ASM2(add64_reg_reg, R_STR, R_SCRATCH);
+
+  BRANCH_TARGET(exhausted);
 
   return 1;
 }
 
-WUR static int
-compile_state_list_loop(assembler_t *as, const regex_t *regex, const allocator_t *allocator) {
+// As above, 32 bytes at a time. vpshufb shuffles within each 128-bit lane, so each row of the
+// tables is broadcast to both lanes
+static int compile_leading_class_scan_avx2(assembler_t *as, const allocator_t *allocator) {
+  for (size_t i = 0; i < 6; i++) {
+    ASM2(vbroadcasti128_ymm_mem, YMM8 + i, M_INDIRECT_REG_DISP(R_SCRATCH, 16 * i));
+  }
+
+  BACKWARDS_BRANCH_TARGET(loop_head);
+
+  ASM2(vmovdqu_ymm_mem, YMM0, M_INDIRECT_REG(R_STR));
+
+  ASM3(vpand_ymm_ymm_ymm, YMM1, YMM0, YMM12);
+  ASM3(vpshufb_ymm_ymm_ymm, YMM2, YMM8, YMM1);
+
+  ASM3(vpxor_ymm_ymm_ymm, YMM1, YMM1, YMM13);
+  ASM3(vpshufb_ymm_ymm_ymm, YMM3, YMM9, YMM1);
+
+  ASM3(vpor_ymm_ymm_ymm, YMM2, YMM2, YMM3);
+
+  ASM3(vpsrlw_ymm_ymm_u8, YMM0, YMM0, 4);
+  ASM3(vpand_ymm_ymm_ymm, YMM0, YMM0, YMM11);
+  ASM3(vpshufb_ymm_ymm_ymm, YMM3, YMM10, YMM0);
+
+  // Byte k of YMM2 is nonzero iff the kth character is in the class
+  ASM3(vpand_ymm_ymm_ymm, YMM2, YMM2, YMM3);
+
+  ASM2(vptest_ymm_ymm, YMM2, YMM2);
+  BRANCH(jnz_i8, found);
+
+  ASM2(add64_reg_i8, R_STR, 32);
+  ASM2(sub64_reg_i8, R_SCRATCH_2, 32);
+  ASM2(cmp64_reg_i8, R_SCRATCH_2, 32);
+  BACKWARDS_BRANCH(jnc_i8, loop_head);
+
+  BRANCH(jmp_i8, exhausted);
+
+  BRANCH_TARGET(found);
+
+  ASM3(vpxor_ymm_ymm_ymm, YMM14, YMM14, YMM14);
+  ASM3(vpcmpeqb_ymm_ymm_ymm, YMM2, YMM2, YMM14);
+  ASM2(vpmovmskb_reg_ymm, R_SCRATCH, YMM2);
+
+  ASM1(not32_reg, R_SCRATCH);
+  ASM2(bsf32_reg_reg, R_SCRATCH, R_SCRATCH);
+  ASM2(add64_reg_reg, R_STR, R_SCRATCH);
+
+  BRANCH_TARGET(exhausted);
+
+  // Avoid SSE/AVX transition penalties in any code called later on (e.g. the allocator)
+  ASM0(vzeroupper);
+
+  return 1;
+}
+
+// As above, 64 bytes at a time; vptestmb yields the characters in the class directly as a mask
+static int compile_leading_class_scan_avx512(assembler_t *as, const allocator_t *allocator) {
+  for (size_t i = 0; i < 6; i++) {
+    ASM2(vbroadcasti32x4_zmm_mem, ZMM8 + i, M_INDIRECT_REG_DISP(R_SCRATCH, 16 * i));
+  }
+
+  BACKWARDS_BRANCH_TARGET(loop_head);
+
+  ASM2(vmovdqu8_zmm_mem, ZMM0, M_INDIRECT_REG(R_STR));
+
+  ASM3(vpandd_zmm_zmm_zmm, ZMM1, ZMM0, ZMM12);
+  ASM3(vpshufb_zmm_zmm_zmm, ZMM2, ZMM8, ZMM1);
+
+  ASM3(vpxord_zmm_zmm_zmm, ZMM1, ZMM1, ZMM13);
+  ASM3(vpshufb_zmm_zmm_zmm, ZMM3, ZMM9, ZMM1);
+
+  ASM3(vpord_zmm_zmm_zmm, ZMM2, ZMM2, ZMM3);
+
+  ASM3(vpsrlw_zmm_zmm_u8, ZMM0, ZMM0, 4);
+  ASM3(vpandd_zmm_zmm_zmm, ZMM0, ZMM0, ZMM11);
+  ASM3(vpshufb_zmm_zmm_zmm, ZMM3, ZMM10, ZMM0);
+
+  // Bit k of K1 is set iff the kth character is in the class
+  ASM3(vptestmb_k_zmm_zmm, K1, ZMM2, ZMM3);
+
+  ASM2(kortestq_k_k, K1, K1);
+  BRANCH(jnz_i8, found);
+
+  ASM2(add64_reg_i8, R_STR, 64);
+  ASM2(sub64_reg_i8, R_SCRATCH_2, 64);
+  ASM2(cmp64_reg_i8, R_SCRATCH_2, 64);
+  BACKWARDS_BRANCH(jnc_i8, loop_head);
+
+  BRANCH(jmp_i8, exhausted);
+
+  BRANCH_TARGET(found);
+
+  ASM2(kmovq_reg_k, R_SCRATCH, K1);
+  ASM2(bsf64_reg_reg, R_SCRATCH, R_SCRATCH);
+  ASM2(add64_reg_reg, R_STR, R_SCRATCH);
+
+  BRANCH_TARGET(exhausted);
+
+  ASM0(vzeroupper);
+
+  return 1;
+}
+
+WUR static int compile_state_list_loop(assembler_t *as,
+                                       const regex_t *regex,
+                                       size_t n_pointers,
+                                       const allocator_t *allocator) {
   ASM2(mov64_reg_i32, R_PREDECESSOR, -1);
   ASM2(mov64_reg_mem, R_STATE, M_HEAD);
 
@@ -408,15 +1555,18 @@ compile_state_list_loop(assembler_t *as, const regex_t *regex, const allocator_t
   }
 
   // If we've already found a match, we needn't push the initial state; clear M_INITIAL_STATE_PUSHED
-  // only if we haven't found a match
+  // only if we haven't found a match. Boolean searches never get this far after finding a match
 
-  ASM2(cmp64_mem_i8, M_MATCHED_STATE, -1);
-  BRANCH(jne_i8, match_found);
+  if (n_pointers == 0) {
+    ASM2(mov32_mem_i32, M_INITIAL_STATE_PUSHED, 0);
+  } else {
+    ASM2(cmp64_mem_i8, M_MATCHED_STATE, -1);
+    BRANCH(jne_i8, match_found);
 
-  // FIXME: consider skipping this if R_N_POINTERS == 0
-  ASM2(mov32_mem_i32, M_INITIAL_STATE_PUSHED, 0);
+    ASM2(mov32_mem_i32, M_INITIAL_STATE_PUSHED, 0);
 
-  BRANCH_TARGET(match_found);
+    BRANCH_TARGET(match_found);
+  }
 
   ASM1(define_label, LABEL_STATE_LOOP_HEAD);
 
@@ -450,14 +1600,8 @@ compile_state_list_loop(assembler_t *as, const regex_t *regex, const allocator_t
   // Set the instruction pointer to the start of the regex program
   ASM2(mov64_mem_reg, M_DISPLACED(M_DEREF_HANDLE(R_STATE), 8), R_SCRATCH_2);
 
-  // Initialize the pointer buffer. Recall that R_N_POINTERS is either 0, 2, or 2 *
-  // regex->n_capturing_groups
-  for (size_t i = 0; i < 2 * regex->n_capturing_groups; i++) {
-    if (i == 0 || i == 2) {
-      ASM2(cmp64_reg_i8, R_N_POINTERS, i);
-      ASM2(jcc_label, JCC_JE, LABEL_HAVE_STATE);
-    }
-
+  // Initialize the pointer buffer
+  for (size_t i = 0; i < n_pointers; i++) {
     assert((size_t)NULL == 0);
     ASM2(mov64_mem_i32, M_DISPLACED(M_DEREF_HANDLE(R_STATE), 16 + 8 * i), 0);
   }
@@ -552,7 +1696,7 @@ static int compile_epilogue(assembler_t *as, const allocator_t *allocator) {
   return 1;
 }
 
-static int compile_allocator(assembler_t *as, const allocator_t *allocator) {
+static int compile_allocator(assembler_t *as, size_t n_pointers, const allocator_t *allocator) {
   // The macros for the various stack variables are written assuming the stack is in the same
   // state as immediately following the prologue. However, because we reach this function body via
   // a call, we need to take into account the return address that was pushed onto the stack, as
@@ -564,10 +1708,8 @@ static int compile_allocator(assembler_t *as, const allocator_t *allocator) {
   // State-push allocation operations enter here
   ASM1(define_label, LABEL_ALLOC_STATE_BLOCK);
 
-  // Compute the size of a state block
-  ASM2(mov64_reg_reg, R_SCRATCH, R_N_POINTERS);
-  ASM2(add64_reg_i8, R_SCRATCH, 2);
-  ASM2(shl64_reg_i8, R_SCRATCH, 3);
+  // A state block comprises the successor handle, the instruction pointer, and the pointer buffer
+  ASM2(mov32_reg_i32, R_SCRATCH, 8 * (2 + n_pointers));
 
   // General allocations (e.g. for the flag bitmap) enter here, and provide their own size
   // parameter in R_SCRATCH
@@ -646,28 +1788,18 @@ static int compile_allocator(assembler_t *as, const allocator_t *allocator) {
   BRANCH(je_i8, epilogue);
 
   // Stash the new buffer in R_CAPACITY, because R_CAPACITY is stale and R_SCRATCH gets
-  // clobbered by the call to memcpy
+  // clobbered by the call to free
   ASM2(mov64_reg_reg, R_CAPACITY, R_SCRATCH);
 
-  // Call memcpy, with the first parameter being the new buffer, the second being the old
-  // buffer, and the third being the total space allocated in the old buffer (i.e.
-  // R_BUMP_POINTER)
+  // Copy the total space allocated in the old buffer (i.e. R_BUMP_POINTER) into the new buffer.
+  // We use rep movsb rather than calling memcpy so as not to bake the address of memcpy into the
+  // machine code (which would prevent it from being serialized). RDI, RSI, and RCX were all saved
+  // above
 
   ASM2(mov64_reg_reg, RDI, R_SCRATCH);
   ASM2(mov64_reg_reg, RSI, R_BUFFER);
-  ASM2(mov64_reg_reg, RDX, R_BUMP_POINTER);
-
-  // Save a few bytes by choosing the smallest usable mov
-
-  const uint64_t memcpy_value = (uint64_t)memcpy;
-
-  if (memcpy_value <= 0xffffffffLU) {
-    ASM2(mov32_reg_i32, R_SCRATCH, memcpy_value);
-  } else {
-    ASM2(mov64_reg_u64, R_SCRATCH, memcpy_value);
-  }
-
-  ASM1(call_reg, R_SCRATCH);
+  ASM2(mov64_reg_reg, RCX, R_BUMP_POINTER);
+  ASM0(rep_movsb);
 
   // Call the allocator's free function, with the first parameter being the allocator
   // context and the second being the the old buffer
@@ -726,7 +1858,7 @@ static int compile_allocator(assembler_t *as, const allocator_t *allocator) {
 }
 
 WUR static int
-compile_push_state_copy(assembler_t *as, size_t n_capturing_groups, const allocator_t *allocator) {
+compile_push_state_copy(assembler_t *as, size_t n_pointers, const allocator_t *allocator) {
   ASM1(define_label, LABEL_PUSH_STATE_COPY);
 
   // We assume that:
@@ -743,34 +1875,9 @@ compile_push_state_copy(assembler_t *as, size_t n_capturing_groups, const alloca
   ASM2(mov64_mem_reg, M_DEREF_HANDLE(R_SCRATCH), R_SCRATCH_2);
   ASM2(mov64_mem_reg, M_DEREF_HANDLE(R_STATE), R_SCRATCH);
 
-  // Copy pointer buffer. Recall that R_N_POINTERS is either 0, 2, or 2 times the number of
-  // capturing groups; we can use this observation to unroll the copy loop very efficiently
-
-  ASM2(cmp64_reg_i8, R_N_POINTERS, 0);
-  BRANCH(jne_i8, n_pointers_nonzero);
+  // Copy the pointer buffer, fully unrolled
 
-  ASM0(ret);
-
-  BRANCH_TARGET(n_pointers_nonzero);
-
-  // R_N_POINTERS is at least 2, so copy 2 poitners
-
-  ASM2(mov64_reg_mem, R_SCRATCH_2, M_DISPLACED(M_DEREF_HANDLE(R_STATE), 16));
-  ASM2(mov64_mem_reg, M_DISPLACED(M_DEREF_HANDLE(R_SCRATCH), 16), R_SCRATCH_2);
-
-  ASM2(mov64_reg_mem, R_SCRATCH_2, M_DISPLACED(M_DEREF_HANDLE(R_STATE), 24));
-  ASM2(mov64_mem_reg, M_DISPLACED(M_DEREF_HANDLE(R_SCRATCH), 16 + 8), R_SCRATCH_2);
-
-  ASM2(cmp64_reg_i8, R_N_POINTERS, 2);
-  BRANCH(jne_i8, n_pointers_not_two);
-
-  ASM0(ret);
-
-  BRANCH_TARGET(n_pointers_not_two);
-
-  // R_N_POINTERS is exactly 2 * n_capturing groups.
-
-  for (size_t i = 2; i < 2 * n_capturing_groups; i++) {
+  for (size_t i = 0; i < n_pointers; i++) {
     ASM2(mov64_reg_mem, R_SCRATCH_2, M_DISPLACED(M_DEREF_HANDLE(R_STATE), 16 + 8 * i));
     ASM2(mov64_mem_reg, M_DISPLACED(M_DEREF_HANDLE(R_SCRATCH), 16 + 8 * i), R_SCRATCH_2);
   }
@@ -781,7 +1888,9 @@ compile_push_state_copy(assembler_t *as, size_t n_capturing_groups, const alloca
 }
 
 static int compile_bytecode_instruction(assembler_t *as,
-                                        regex_t *regex,
+                                        const regex_t *regex,
+                                        size_t n_pointers,
+                                        const unsigned char *initial_class,
                                         size_t *index,
                                         const allocator_t *allocator) {
   ASM1(define_label, INSTR_LABEL(*index));
@@ -808,6 +1917,10 @@ static int compile_bytecode_instruction(assembler_t *as,
 
     ASM2(jcc_label, JCC_JNE, LABEL_DESTROY_STATE);
 
+    if (!compile_fused_literal(as, regex, initial_class, operand, *index, allocator)) {
+      return 0;
+    }
+
     ASM2(lea64_reg_label, R_SCRATCH, INSTR_LABEL(*index));
     ASM1(jmp_label, LABEL_KEEP_STATE);
 
@@ -976,18 +2089,11 @@ static int compile_bytecode_instruction(assembler_t *as,
   }
 
   case VM_WRITE_POINTER: {
-    if (operand < 128) {
-      ASM2(cmp64_reg_i8, R_N_POINTERS, operand);
-    } else {
-      ASM2(cmp64_reg_i32, R_N_POINTERS, operand);
+    // Pointers beyond those tracked by this body are dropped
+    if (operand < n_pointers) {
+      ASM2(mov64_mem_reg, M_DISPLACED(M_DEREF_HANDLE(R_STATE), 8 * (2 + operand)), R_STR);
     }
 
-    BRANCH(jbe_i8, out_of_range);
-
-    ASM2(mov64_mem_reg, M_DISPLACED(M_DEREF_HANDLE(R_STATE), 8 * (2 + operand)), R_STR);
-
-    BRANCH_TARGET(out_of_range);
-
     break;
   }
 
@@ -1008,6 +2114,18 @@ static int compile_bytecode_instruction(assembler_t *as,
     break;
   }
 
+  case VM_ACCEPT: {
+    assert(operand < regex->n_patterns);
+
+    // Set the pattern's bit in the result (a bitmap whose size is a multiple of 4 bytes; see
+    // run_regex_set). The state has done its job; the search carries on for the other patterns
+    ASM2(mov64_reg_mem, R_SCRATCH, M_RESULT);
+    ASM2(bts32_mem_u8, M_INDIRECT_REG_DISP(R_SCRATCH, 4 * (operand / 32)), operand % 32);
+    ASM1(jmp_label, LABEL_DESTROY_STATE);
+
+    break;
+  }
+
   default:
     assert(0);
   }
@@ -1015,29 +2133,142 @@ static int compile_bytecode_instruction(assembler_t *as,
   return 1;
 }
 
-WUR static int compile_match(assembler_t *as, const allocator_t *allocator) {
-  // FIXME: use 32-bit operations on R_N_POINTERS if applicable
-  ASM2(cmp64_reg_i8, R_N_POINTERS, 0);
-  BRANCH(jne_i8, n_pointers_nonzero);
+// Having matched character (at R_STR), try to match the run of literal characters beginning with it
+// and continuing with the VM_CHARACTER instructions at index, all at once rather than a character
+// per iteration of the string loop. This is only possible if the state is the only one live, and
+// if every thread that would be started at the intervening positions would die in its first step
+// (i.e. if none of the intervening characters can begin a match). Falls through if the run can't
+// be fused at runtime
+static int compile_fused_literal(assembler_t *as,
+                                 const regex_t *regex,
+                                 const unsigned char *initial_class,
+                                 unsigned char character,
+                                 size_t index,
+                                 const allocator_t *allocator) {
+  if (initial_class == NULL) {
+    return 1;
+  }
 
-  // R_N_POINTERS == 0, i.e. we're performing a boolean search. M_RESULT is a pointer to an int
-  ASM2(mov64_reg_mem, R_SCRATCH, M_RESULT);
+  const unsigned char *bytecode = regex->bytecode.code;
 
-  assert(sizeof(int) == 4 || sizeof(int) == 8);
+  unsigned char literal[MAX_FUSED_LITERAL_SIZE];
+  size_t size = 0;
+
+  literal[size++] = character;
+
+  while (size < MAX_FUSED_LITERAL_SIZE && index < regex->bytecode.size) {
+    const unsigned char byte = bytecode[index];
+
+    if (VM_OPCODE(byte) != VM_CHARACTER) {
+      break;
+    }
+
+    const size_t operand_size = VM_OPERAND_SIZE(byte);
+    const size_t operand = deserialize_operand(bytecode + index + 1, operand_size);
 
-  if (sizeof(int) == 4) {
-    ASM2(mov32_mem_i32, M_INDIRECT_REG(R_SCRATCH), 1);
+    if (bitmap_test(initial_class, operand)) {
+      break;
+    }
+
+    literal[size++] = operand;
+    index += 1 + operand_size;
+  }
+
+  if (size < 2) {
+    return 1;
+  }
+
+  const label_t unfused = create_label(as);
+
+  ASM2(cmp64_reg_i8, R_PREDECESSOR, -1);
+  ASM2(jcc_label, JCC_JNE, unfused);
+
+  ASM2(cmp64_mem_i8, M_DEREF_HANDLE(R_STATE), -1);
+  ASM2(jcc_label, JCC_JNE, unfused);
+
+  // If a thread started at R_STR could survive, it must already have been started (i.e. it must be
+  // this one)
+  if (bitmap_test(initial_class, character)) {
+    ASM2(cmp32_mem_i8, M_INITIAL_STATE_PUSHED, 0);
+    ASM2(jcc_label, JCC_JE, unfused);
+  }
+
+  // The whole run must precede the EOF
+  ASM2(mov64_reg_mem, R_SCRATCH, M_EOF);
+  ASM2(sub64_reg_reg, R_SCRATCH, R_STR);
+  ASM2(cmp64_reg_i8, R_SCRATCH, size);
+  ASM2(jcc_label, JCC_JB, unfused);
+
+  // Compare the run against the string in as few loads as possible, overlapping the last load with
+  // the one before it where necessary. A mismatch means that the state would die somewhere in the
+  // run without having had any effect, so it can be destroyed immediately
+  if (size >= 8) {
+    for (size_t offset = 0;; offset += 8) {
+      offset = (offset + 8 > size) ? size - 8 : offset;
+
+      ASM2(mov64_reg_u64, R_SCRATCH, deserialize_operand_le(literal + offset, 8));
+      ASM2(cmp64_reg_mem, R_SCRATCH, M_INDIRECT_REG_DISP(R_STR, offset));
+      ASM2(jcc_label, JCC_JNE, LABEL_DESTROY_STATE);
+
+      if (offset + 8 == size) {
+        break;
+      }
+    }
+  } else if (size >= 4) {
+    for (size_t offset = 0;; offset = size - 4) {
+      ASM2(cmp32_mem_u32,
+           M_INDIRECT_REG_DISP(R_STR, offset),
+           deserialize_operand_le(literal + offset, 4));
+      ASM2(jcc_label, JCC_JNE, LABEL_DESTROY_STATE);
+
+      if (offset + 4 == size) {
+        break;
+      }
+    }
   } else {
-    ASM2(mov64_mem_i32, M_INDIRECT_REG(R_SCRATCH), 1);
+    // The first character has already been matched
+    for (size_t offset = 1; offset < size; offset++) {
+      ASM2(cmp8_mem_u8, M_INDIRECT_REG_DISP(R_STR, offset), literal[offset]);
+      ASM2(jcc_label, JCC_JNE, LABEL_DESTROY_STATE);
+    }
   }
 
-  // Short-circuit by jumping directly to the function epilogue
-  ASM2(xor32_reg_reg, R_SCRATCH, R_SCRATCH);
-  ASM1(jmp_label, LABEL_EPILOGUE);
+  // Consume the run, leaving R_STR and R_CHARACTER as they would be had it been matched a character
+  // at a time
+  ASM2(add64_reg_i8, R_STR, size - 1);
+  ASM2(mov32_reg_i32, R_CHARACTER, literal[size - 1]);
+
+  ASM2(lea64_reg_label, R_SCRATCH, INSTR_LABEL(index));
+  ASM1(jmp_label, LABEL_KEEP_STATE);
+
+  ASM1(define_label, unfused);
+
+  return 1;
+}
+
+WUR static int compile_match(assembler_t *as, size_t n_pointers, const allocator_t *allocator) {
+  ASM1(define_label, LABEL_MATCH);
+
+  if (n_pointers == 0) {
+    // We're performing a boolean search. M_RESULT is a pointer to an int
+    ASM2(mov64_reg_mem, R_SCRATCH, M_RESULT);
+
+    assert(sizeof(int) == 4 || sizeof(int) == 8);
+
+    if (sizeof(int) == 4) {
+      ASM2(mov32_mem_i32, M_INDIRECT_REG(R_SCRATCH), 1);
+    } else {
+      ASM2(mov64_mem_i32, M_INDIRECT_REG(R_SCRATCH), 1);
+    }
+
+    // Short-circuit by jumping directly to the function epilogue
+    ASM2(xor32_reg_reg, R_SCRATCH, R_SCRATCH);
+    ASM1(jmp_label, LABEL_EPILOGUE);
 
-  BRANCH_TARGET(n_pointers_nonzero);
+    return 1;
+  }
 
-  // R_N_POINTERS != 0, i.e. we're doing a find or group search
+  // We're doing a find or group search
 
   // Deallocate the current M_MATCHED_STATE, if any
 
@@ -1092,6 +2323,38 @@ WUR static int compile_match(assembler_t *as, const allocator_t *allocator) {
   return 1;
 }
 
+static int compile_leading_class_tables(assembler_t *as,
+                                        const char_class_t char_class,
+                                        const allocator_t *allocator) {
+  // - Rows 0 and 1: for characters below and above 0x80 respectively, byte k has bit j set iff
+  // the character with low nibble k and high nibble j (mod 8) is in the class
+  // - Row 2: byte k is 1 << (k mod 8)
+  // - Rows 3, 4, 5: splats of 0x0f, 0x8f, and 0x80
+  unsigned char tables[6][16];
+  memset(tables, 0, sizeof(tables));
+
+  for (size_t c = 0; c <= 255; c++) {
+    if (bitmap_test(char_class, c)) {
+      tables[c >> 7u][c & 15u] |= 1u << ((c >> 4u) & 7u);
+    }
+  }
+
+  for (size_t k = 0; k < 16; k++) {
+    tables[2][k] = 1u << (k & 7u);
+    tables[3][k] = 0x0f;
+    tables[4][k] = 0x8f;
+    tables[5][k] = 0x80;
+  }
+
+  ASM1(define_label, LABEL_LEADING_CLASS_TABLES);
+
+  if (!emit_assembler_data(as, tables, sizeof(tables), allocator)) {
+    return 0;
+  }
+
+  return 1;
+}
+
 WUR static int compile_debugging_boundary(assembler_t *as, const allocator_t *allocator) {
 #ifdef NDEBUG
   (void)as;
@@ -1105,4 +2368,6 @@ WUR static int compile_debugging_boundary(assembler_t *as, const allocator_t *al
   return 1;
 }
 
+#include "perf-map.c"
+
 #endif
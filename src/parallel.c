@@ -0,0 +1,358 @@
+// Searches of large inputs split across threads. The input is split into one chunk per thread, and
+// each thread runs the regex's DFA (see dfa.c) over its chunk, starting afresh at the beginning of
+// the chunk as if resuming a search there. A search which began earlier has a superset of the
+// threads (in the VM's sense) of one which began later, so any match found from a fresh start is
+// genuine; and once the earlier search's DFA is idle, the two agree from then on. Hence each thread
+// carries on past the end of its chunk until its DFA is idle (or it finds a match, or reaches the
+// EOF), and between them the threads find a match if there is one. A find then reruns the search
+// sequentially, from the beginning of the earliest chunk in which a match was found.
+//
+// The regex's native code isn't used for the chunks, since it can't stop once idle past the end of
+// a chunk. Instead, an idle state skips ahead over the bytes on which it loops back to itself: with
+// memchr if it only leaves on one particular byte, and with a table otherwise. If the regex has no
+// DFA (because it would be too large), or the input is small, the search just runs sequentially.
+//
+// The DFA and the skip tables are built on the regex's first parallel search, and cached on the
+// regex for the rest. Like native code, they're part of the regex's lazily-computed state, so a
+// regex shared between threads publishes them atomically
+
+#include <pthread.h>
+#include <unistd.h>
+
+// Chunks are at least this large, so that small inputs aren't split needlessly
+#define MIN_PARALLEL_CHUNK_SIZE (256 * 1024)
+
+// How often each thread checks whether a match has already been found in an earlier chunk
+#define PARALLEL_POLL_INTERVAL (64 * 1024)
+
+// Skips other than to a particular byte (see compute_skips)
+enum { SKIP_NONE = -1, SKIP_LOOPS = -2 };
+
+typedef struct parallel_dfa {
+  dfa_t dfa;
+
+  // How to skip ahead from each state (see compute_skips), and for each state, which bytes it loops
+  // back to itself on
+  int *skips;
+  unsigned char *loops;
+} parallel_dfa_t;
+
+// Cached in place of the DFA of a regex which has none
+static parallel_dfa_t no_parallel_dfa;
+
+typedef struct {
+  const parallel_dfa_t *parallel_dfa;
+
+  const char *str;
+  const char *eof;
+
+  // The earliest chunk in which a match has been found so far, or SIZE_MAX
+  pthread_mutex_t mutex;
+  size_t first_match;
+} parallel_search_t;
+
+typedef struct {
+  parallel_search_t *search;
+  size_t index;
+
+  const char *begin;
+  const char *end;
+
+  pthread_t thread;
+  int has_thread;
+} parallel_chunk_t;
+
+static int parallel_earlier_match(parallel_search_t *search, size_t index) {
+  pthread_mutex_lock(&search->mutex);
+  const int result = search->first_match < index;
+  pthread_mutex_unlock(&search->mutex);
+
+  return result;
+}
+
+static void *search_parallel_chunk(void *argument) {
+  parallel_chunk_t *chunk = argument;
+  parallel_search_t *search = chunk->search;
+  const parallel_dfa_t *parallel_dfa = search->parallel_dfa;
+  const dfa_t *dfa = &parallel_dfa->dfa;
+
+  const unsigned char *position = (const unsigned char *)chunk->begin;
+  const unsigned char *end = (const unsigned char *)chunk->end;
+  const unsigned char *eof = (const unsigned char *)search->eof;
+
+  size_t state = (chunk->begin == search->str)
+                     ? 0
+                     : dfa->initial_states[dfa->byte_classes[position[-1]]];
+
+  int matched = 0;
+
+  for (const unsigned char *poll = position + PARALLEL_POLL_INTERVAL; state < DFA_NO_MATCH;) {
+    // Within the chunk, run up to the next poll; beyond it, check for idleness at every step
+    const unsigned char *limit = (position < end) ? end : position + 1;
+    limit = (poll < limit) ? poll : limit;
+    limit = (eof < limit) ? eof : limit;
+
+    while (position != limit && state < DFA_NO_MATCH) {
+      const int skip = parallel_dfa->skips[state];
+
+      if (skip >= 0) {
+        const unsigned char *next = memchr(position, skip, limit - position);
+
+        if (next == NULL) {
+          position = limit;
+          break;
+        }
+
+        position = next;
+      } else if (skip == SKIP_LOOPS) {
+        const unsigned char *loops = parallel_dfa->loops + 256 * state;
+
+        while (position != limit && loops[*position]) {
+          position++;
+        }
+
+        if (position == limit) {
+          break;
+        }
+      }
+
+      state = dfa->transitions[dfa->n_byte_classes * state + dfa->byte_classes[*position++]];
+    }
+
+    if (state >= DFA_NO_MATCH) {
+      break;
+    }
+
+    if (position == eof) {
+      matched = dfa->eof_matches[state];
+      break;
+    }
+
+    if (position >= end && dfa->idle[state]) {
+      break;
+    }
+
+    if (position == poll) {
+      if (parallel_earlier_match(search, chunk->index)) {
+        break;
+      }
+
+      poll += PARALLEL_POLL_INTERVAL;
+    }
+  }
+
+  if (matched || state == DFA_MATCH) {
+    pthread_mutex_lock(&search->mutex);
+
+    if (chunk->index < search->first_match) {
+      search->first_match = chunk->index;
+    }
+
+    pthread_mutex_unlock(&search->mutex);
+  }
+
+  return NULL;
+}
+
+// An idle state that loops back to itself on all but one byte skips to that byte; one that loops
+// back to itself on any other bytes skips over them. Skipping from a state that isn't idle isn't
+// worth it, since a match is in progress
+static void compute_skips(int *skips, unsigned char *loops, const dfa_t *dfa) {
+  for (size_t state = 0; state < dfa->n_states; state++) {
+    skips[state] = SKIP_NONE;
+
+    if (!dfa->idle[state]) {
+      continue;
+    }
+
+    size_t n_exits = 0;
+    int exit = -1;
+
+    for (size_t c = 0; c <= 255; c++) {
+      const size_t target = dfa->transitions[dfa->n_byte_classes * state + dfa->byte_classes[c]];
+      loops[256 * state + c] = target == state;
+
+      if (target != state) {
+        n_exits++;
+        exit = (int)c;
+      }
+    }
+
+    if (n_exits == 1) {
+      skips[state] = exit;
+    } else if (n_exits < 256) {
+      skips[state] = SKIP_LOOPS;
+    }
+  }
+}
+
+static void destroy_parallel_dfa(parallel_dfa_t *parallel_dfa, const allocator_t *allocator) {
+  if (parallel_dfa == NULL || parallel_dfa == &no_parallel_dfa) {
+    return;
+  }
+
+  FREE(allocator, parallel_dfa->skips);
+  FREE(allocator, parallel_dfa->loops);
+  destroy_dfa(&parallel_dfa->dfa, allocator);
+  FREE(allocator, parallel_dfa);
+}
+
+// Yields NULL if out of memory
+WUR static const parallel_dfa_t *get_parallel_dfa(const regex_t *regex) {
+  // The DFA is part of the regex's lazily-computed state rather than its value, so it's fair game
+  // to modify even though the regex is const
+  regex_t *mutable_regex = (regex_t *)regex;
+
+  parallel_dfa_t *parallel_dfa = __atomic_load_n(&mutable_regex->parallel_dfa, __ATOMIC_ACQUIRE);
+
+  if (parallel_dfa != NULL) {
+    return parallel_dfa;
+  }
+
+  const allocator_t *allocator = &regex->allocator;
+
+  parallel_dfa = ALLOC(allocator, sizeof(parallel_dfa_t));
+
+  if (parallel_dfa == NULL) {
+    return NULL;
+  }
+
+  // Building the DFA only fails if it would be too large, or if out of memory. Either way, parallel
+  // searches fall back to running sequentially from then on
+  if (!build_dfa(&parallel_dfa->dfa, regex, allocator)) {
+    FREE(allocator, parallel_dfa);
+    parallel_dfa = &no_parallel_dfa;
+  } else {
+    parallel_dfa->skips = ALLOC(allocator, sizeof(int) * parallel_dfa->dfa.n_states);
+    parallel_dfa->loops = ALLOC(allocator, 256 * parallel_dfa->dfa.n_states);
+
+    if (parallel_dfa->skips == NULL || parallel_dfa->loops == NULL) {
+      destroy_parallel_dfa(parallel_dfa, allocator);
+      return NULL;
+    }
+
+    compute_skips(parallel_dfa->skips, parallel_dfa->loops, &parallel_dfa->dfa);
+    shrink_dfa(&parallel_dfa->dfa, allocator);
+  }
+
+  // Should another thread have beaten this one to it, use its DFA instead
+  parallel_dfa_t *expected = NULL;
+
+  if (!__atomic_compare_exchange_n(&mutable_regex->parallel_dfa,
+                                   &expected,
+                                   parallel_dfa,
+                                   0,
+                                   __ATOMIC_ACQ_REL,
+                                   __ATOMIC_ACQUIRE)) {
+    destroy_parallel_dfa(parallel_dfa, allocator);
+    parallel_dfa = expected;
+  }
+
+  return parallel_dfa;
+}
+
+static size_t parallel_default_n_threads(void) {
+  const long n_processors = sysconf(_SC_NPROCESSORS_ONLN);
+  return (n_processors < 1) ? 1 : (size_t)n_processors;
+}
+
+// n_threads may be 0, meaning one per processor. Only boolean searches (n_pointers == 0) and finds
+// (n_pointers == 2) are supported
+WUR static status_t run_regex_parallel(void *result,
+                                       context_t *context,
+                                       const regex_t *regex,
+                                       const char *str,
+                                       size_t size,
+                                       size_t n_pointers,
+                                       size_t n_threads) {
+  assert(n_pointers == 0 || n_pointers == 2);
+
+  if (n_threads == 0) {
+    n_threads = parallel_default_n_threads();
+  }
+
+  if (n_threads > size / MIN_PARALLEL_CHUNK_SIZE) {
+    n_threads = size / MIN_PARALLEL_CHUNK_SIZE;
+  }
+
+  if (n_threads <= 1) {
+    return run_regex(result, context, regex, str, size, -1, n_pointers);
+  }
+
+  const parallel_dfa_t *parallel_dfa = get_parallel_dfa(regex);
+
+  if (parallel_dfa == NULL) {
+    return CREX_E_NOMEM;
+  }
+
+  if (parallel_dfa == &no_parallel_dfa) {
+    return run_regex(result, context, regex, str, size, -1, n_pointers);
+  }
+
+  const allocator_t *allocator = &context->allocator;
+
+  parallel_chunk_t *chunks = ALLOC(allocator, sizeof(parallel_chunk_t) * n_threads);
+
+  if (chunks == NULL) {
+    return CREX_E_NOMEM;
+  }
+
+  parallel_search_t search;
+
+  search.parallel_dfa = parallel_dfa;
+  search.str = str;
+  search.eof = str + size;
+  search.first_match = SIZE_MAX;
+
+  pthread_mutex_init(&search.mutex, NULL);
+
+  for (size_t i = 0; i < n_threads; i++) {
+    parallel_chunk_t *chunk = &chunks[i];
+
+    chunk->search = &search;
+    chunk->index = i;
+    chunk->begin = str + size / n_threads * i;
+    chunk->end = (i + 1 == n_threads) ? str + size : str + size / n_threads * (i + 1);
+
+    // The first chunk runs on this thread. If a thread can't be created, its chunk runs on this
+    // thread too, once the others are under way
+    chunk->has_thread =
+        i != 0 && pthread_create(&chunk->thread, NULL, search_parallel_chunk, chunk) == 0;
+  }
+
+  for (size_t i = 0; i < n_threads; i++) {
+    if (!chunks[i].has_thread) {
+      search_parallel_chunk(&chunks[i]);
+    }
+  }
+
+  for (size_t i = 0; i < n_threads; i++) {
+    if (chunks[i].has_thread) {
+      pthread_join(chunks[i].thread, NULL);
+    }
+  }
+
+  pthread_mutex_destroy(&search.mutex);
+
+  const size_t first_match = search.first_match;
+  const char *begin = (first_match == SIZE_MAX) ? NULL : chunks[first_match].begin;
+
+  FREE(allocator, chunks);
+
+  if (n_pointers == 0) {
+    int *is_match = result;
+    *is_match = begin != NULL;
+    return CREX_OK;
+  }
+
+  if (begin == NULL) {
+    match_t *match = result;
+    match->begin = NULL;
+    match->end = NULL;
+    return CREX_OK;
+  }
+
+  const int prev_character = (begin == str) ? -1 : (unsigned char)begin[-1];
+
+  return run_regex(result, context, regex, begin, str + size - begin, prev_character, 2);
+}
@@ -405,13 +405,17 @@ WUR static int parser_pop_operator(operator_stack_t *operators,
     parsetree_t *left = parsetree_stack_pop(trees);
 
     if (!concatenation_push(&tree->data.concatenation, left, allocator)) {
+      FREE(allocator, tree);
       destroy_parsetree(left, allocator);
       destroy_parsetree(right, allocator);
+      return 0;
     }
 
     if (!concatenation_push(&tree->data.concatenation, right, allocator)) {
-      destroy_parsetree(left, allocator);
+      // left now belongs to tree
+      destroy_parsetree(tree, allocator);
       destroy_parsetree(right, allocator);
+      return 0;
     }
 
     break;
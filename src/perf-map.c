@@ -0,0 +1,198 @@
+// Symbol maps for perf (see tools/perf/Documentation/jit-interface.txt in the Linux source). If
+// CREX_PERF_MAP is set, a line is appended to /tmp/perf-<pid>.map for each piece of each regex's
+// native code. Each symbol is named by a hash of the regex's bytecode, so that the same pattern has
+// the same name across runs, and by the body (i.e. the kind of query) in which it appears, e.g.:
+//
+//   crex_5f3a02c1_find_prologue
+//   crex_5f3a02c1_find_string_loop
+//   ...
+//   crex_5f3a02c1_find_12_char_class     (the bytecode instruction at index 12)
+//   crex_5f3a02c1_find_match
+//   crex_5f3a02c1_is_match_code          (a body compiled from a DFA, which is named as one piece)
+//
+// Code in the arena may be reused once its regex is destroyed, so stale entries can shadow newer
+// ones in long-running processes that churn through regexes
+
+#include <fcntl.h>
+#include <stdio.h>
+
+#define PERF_MAP_LINE_SIZE 96
+
+static const char *const perf_map_opcode_names[] = {"character",
+                                                    "char_class",
+                                                    "builtin_char_class",
+                                                    "anchor_bof",
+                                                    "anchor_bol",
+                                                    "anchor_eof",
+                                                    "anchor_eol",
+                                                    "anchor_word_boundary",
+                                                    "anchor_not_word_boundary",
+                                                    "jump",
+                                                    "split_passive",
+                                                    "split_eager",
+                                                    "split_backwards_passive",
+                                                    "split_backwards_eager",
+                                                    "write_pointer",
+                                                    "test_and_set_flag",
+                                                    "accept"};
+
+static int perf_map_enabled(void) {
+  const char *value = getenv("CREX_PERF_MAP");
+  return value != NULL && *value != 0 && strcmp(value, "0") != 0;
+}
+
+// 32-bit FNV-1a over the bytecode and character classes
+static size_t perf_map_regex_hash(const regex_t *regex) {
+  size_t hash = 0x811c9dc5LU;
+
+  const unsigned char *bytecode = regex->bytecode.code;
+
+  for (size_t i = 0; i < regex->bytecode.size; i++) {
+    hash = ((hash ^ bytecode[i]) * 0x01000193LU) & 0xffffffffLU;
+  }
+
+  const unsigned char *classes = (const unsigned char *)regex->classes;
+
+  for (size_t i = 0; i < sizeof(char_class_t) * regex->n_classes; i++) {
+    hash = ((hash ^ classes[i]) * 0x01000193LU) & 0xffffffffLU;
+  }
+
+  return hash;
+}
+
+// Append a symbol to buffer, which has room for at least PERF_MAP_LINE_SIZE more bytes. index is
+// the index of the bytecode instruction, if any
+static size_t write_perf_map_line(char *buffer,
+                                  const unsigned char *begin,
+                                  const unsigned char *end,
+                                  size_t hash,
+                                  const char *body_name,
+                                  const char *name,
+                                  size_t index) {
+  assert(begin <= end);
+
+  int length;
+
+  if (index == SIZE_MAX) {
+    length = snprintf(buffer,
+                      PERF_MAP_LINE_SIZE,
+                      "%lx %lx crex_%08lx_%s_%s\n",
+                      (unsigned long)begin,
+                      (unsigned long)(end - begin),
+                      (unsigned long)hash,
+                      body_name,
+                      name);
+  } else {
+    length = snprintf(buffer,
+                      PERF_MAP_LINE_SIZE,
+                      "%lx %lx crex_%08lx_%s_%lu_%s\n",
+                      (unsigned long)begin,
+                      (unsigned long)(end - begin),
+                      (unsigned long)hash,
+                      body_name,
+                      (unsigned long)index,
+                      name);
+  }
+
+  assert(0 < length && length < PERF_MAP_LINE_SIZE);
+
+  // Empty pieces of code needn't be named
+  return (begin == end) ? 0 : (size_t)length;
+}
+
+// Describe one body of native code. as may be NULL (e.g. for a body compiled from a DFA), in which
+// case the whole body is named as one piece; body_name may also be NULL (e.g. for native code
+// loaded from a dump). Failures are ignored; this is only a profiling aid
+static void write_perf_map(const unsigned char *code,
+                           size_t size,
+                           const regex_t *regex,
+                           const char *body_name,
+                           const assembler_t *as,
+                           int has_leading_class_tables,
+                           const allocator_t *allocator) {
+  // Static symbols, in the order in which the corresponding code is emitted by compile_to_native
+  static const struct {
+    label_t label;
+    const char *name;
+  } static_symbols[] = {{LABEL_STRING_LOOP_HEAD, "string_loop"},
+                        {LABEL_EPILOGUE, "epilogue"},
+                        {LABEL_ALLOC_STATE_BLOCK, "allocator"},
+                        {LABEL_PUSH_STATE_COPY, "push_state_copy"}};
+
+  const size_t n_static_symbols = sizeof(static_symbols) / sizeof(*static_symbols);
+
+  const size_t hash = perf_map_regex_hash(regex);
+
+  // At most one symbol per bytecode byte, plus a handful of others
+  char *buffer =
+      ALLOC(allocator, PERF_MAP_LINE_SIZE * (regex->bytecode.size + n_static_symbols + 4));
+
+  if (buffer == NULL) {
+    return;
+  }
+
+  size_t length = 0;
+
+  if (as == NULL) {
+    if (body_name == NULL) {
+      body_name = "all";
+    }
+
+    length += write_perf_map_line(buffer, code, code + size, hash, body_name, "code", SIZE_MAX);
+  } else {
+    const unsigned char *begin = code;
+    const char *name = "prologue";
+    size_t index = SIZE_MAX;
+
+#define SYMBOL(label, next_name, next_index)                                                       \
+  do {                                                                                             \
+    const unsigned char *end = code + label_offset(as, label);                                     \
+    length +=                                                                                      \
+        write_perf_map_line(buffer + length, begin, end, hash, body_name, name, index);            \
+    begin = end;                                                                                   \
+    name = (next_name);                                                                            \
+    index = (next_index);                                                                          \
+  } while (0)
+
+    for (size_t i = 0; i < n_static_symbols; i++) {
+      SYMBOL(static_symbols[i].label, static_symbols[i].name, SIZE_MAX);
+    }
+
+    const unsigned char *bytecode = regex->bytecode.code;
+
+    for (size_t i = 0; i < regex->bytecode.size;) {
+      const unsigned char byte = bytecode[i];
+      assert(VM_OPCODE(byte) < sizeof(perf_map_opcode_names) / sizeof(*perf_map_opcode_names));
+
+      SYMBOL(INSTR_LABEL(i), perf_map_opcode_names[VM_OPCODE(byte)], i);
+
+      i += 1 + VM_OPERAND_SIZE(byte);
+    }
+
+    SYMBOL(LABEL_MATCH, "match", SIZE_MAX);
+
+    if (has_leading_class_tables) {
+      SYMBOL(LABEL_LEADING_CLASS_TABLES, "tables", SIZE_MAX);
+    }
+
+#undef SYMBOL
+
+    length +=
+        write_perf_map_line(buffer + length, begin, code + size, hash, body_name, name, index);
+  }
+
+  char path[64];
+  snprintf(path, sizeof(path), "/tmp/perf-%ld.map", (long)getpid());
+
+  // The map is written with a single append, so that concurrently-compiled regexes' lines aren't
+  // interleaved
+  const int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+  if (fd != -1) {
+    const ssize_t result = write(fd, buffer, length);
+    (void)result;
+    close(fd);
+  }
+
+  FREE(allocator, buffer);
+}
@@ -0,0 +1,302 @@
+// A regex set is compiled to a single program which runs all of the set's patterns at once (see
+// compile_set_pattern), so that determining which of the patterns match a string takes a single
+// pass over the string, however many patterns there are. If the program's DFA is small enough, a
+// search runs the DFA; otherwise, it runs the program itself. Either is compiled to native code if
+// there's a native compiler
+
+struct crex_regex_set {
+  // The combined program. It has no native code of its own
+  regex_t regex;
+
+  int has_dfa;
+  dfa_t dfa;
+
+#ifdef NATIVE_COMPILER
+  struct {
+    size_t size;
+    void *code;
+  } native_code;
+#endif
+};
+
+// If sizes is NULL, the patterns are NUL-terminated
+WUR static regex_set_t *compile_regex_set(status_t *status,
+                                          const char *const *patterns,
+                                          const size_t *sizes,
+                                          size_t n_patterns,
+                                          const allocator_t *allocator) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  regex_set_t *set = ALLOC(allocator, sizeof(regex_set_t));
+
+  if (set == NULL) {
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  regex_t *regex = &set->regex;
+
+  regex->n_capturing_groups = 1;
+  regex->n_patterns = n_patterns;
+  regex->cache_entry = NULL;
+  regex->parallel_dfa = NULL;
+  regex->n_flags = 0;
+  regex->allocator = *allocator;
+
+  char_classes_t classes = {0, 0, NULL};
+
+  bytecode_t bytecode;
+  create_bytecode(&bytecode);
+
+  for (size_t i = 0; i < n_patterns; i++) {
+    const size_t size = (sizes == NULL) ? strlen(patterns[i]) : sizes[i];
+
+    size_t n_capturing_groups;
+    parsetree_t *tree = parse(status, &n_capturing_groups, &classes, patterns[i], size, allocator);
+
+    int success = tree != NULL;
+
+    if (success) {
+      // The patterns' groups overlap, but nothing reads them anyway
+      if (n_capturing_groups > regex->n_capturing_groups) {
+        regex->n_capturing_groups = n_capturing_groups;
+      }
+
+      success = compile_set_pattern(
+          &bytecode, &regex->n_flags, tree, i, i + 1 == n_patterns, allocator);
+
+      destroy_parsetree(tree, allocator);
+
+      if (!success) {
+        *status = CREX_E_NOMEM;
+      }
+    }
+
+    if (!success) {
+      destroy_bytecode(&bytecode, allocator);
+      FREE(allocator, classes.buffer);
+      FREE(allocator, set);
+      return NULL;
+    }
+  }
+
+  regex->bytecode.size = 0;
+  regex->bytecode.code = NULL;
+
+  if (n_patterns != 0) {
+    regex->bytecode.code = unpack_bytecode(&bytecode, &regex->bytecode.size, allocator);
+
+    if (regex->bytecode.code == NULL) {
+      *status = CREX_E_NOMEM;
+      destroy_bytecode(&bytecode, allocator);
+      FREE(allocator, classes.buffer);
+      FREE(allocator, set);
+      return NULL;
+    }
+  }
+
+  regex->n_classes = classes.size;
+  regex->classes = classes.buffer;
+
+#ifdef NATIVE_COMPILER
+  regex->native_code.size = 0;
+  regex->native_code.code = NULL;
+  regex->native_code.features = 0;
+  regex->native_code.threshold = 0;
+  regex->native_code.n_executions = 0;
+  regex->native_code.compiling = 0;
+
+  set->native_code.size = 0;
+  set->native_code.code = NULL;
+#endif
+
+  // A DFA which would be too large isn't an error; the set just runs the program instead
+  set->has_dfa = n_patterns != 0 && build_dfa(&set->dfa, regex, allocator);
+
+#ifdef NATIVE_COMPILER
+  if (n_patterns != 0) {
+    const dfa_t *dfa = set->has_dfa ? &set->dfa : NULL;
+    set->native_code.code = compile_set_to_native(&set->native_code.size, dfa, regex, allocator);
+
+    if (set->native_code.code == NULL) {
+      *status = CREX_E_NOMEM;
+
+      if (set->has_dfa) {
+        destroy_dfa(&set->dfa, allocator);
+      }
+
+      FREE(allocator, regex->bytecode.code);
+      FREE(allocator, regex->classes);
+      FREE(allocator, set);
+      return NULL;
+    }
+  }
+#endif
+
+  *status = CREX_OK;
+
+  return set;
+}
+
+static void destroy_regex_set(regex_set_t *set) {
+  const allocator_t *allocator = &set->regex.allocator;
+
+  if (set->has_dfa) {
+    destroy_dfa(&set->dfa, allocator);
+  }
+
+#ifdef NATIVE_COMPILER
+  if (set->native_code.code != NULL) {
+    free_native_code(set->native_code.code, set->native_code.size);
+  }
+#endif
+
+  FREE(allocator, set->regex.bytecode.code);
+  FREE(allocator, set->regex.classes);
+  FREE(allocator, set);
+}
+
+#ifdef NATIVE_COMPILER
+
+WUR static status_t run_regex_set_native_code(unsigned char *accepts,
+                                             context_t *context,
+                                             const regex_set_t *set,
+                                             const char *str,
+                                             size_t size) {
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+
+  const native_function_t function = (native_function_t)set->native_code.code;
+
+#if defined(__GNUC__) || defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+  context->prev_character = -1;
+
+  return (*function)(accepts,
+                     context,
+                     str,
+                     str + size,
+                     (unsigned char *)set->regex.classes,
+                     (unsigned char *)builtin_classes);
+}
+
+#endif
+
+static void
+run_regex_set_dfa(unsigned char *accepts, const regex_set_t *set, const char *str, size_t size) {
+  const dfa_t *dfa = &set->dfa;
+
+  const unsigned char *characters = (const unsigned char *)str;
+
+  size_t state = 0;
+
+  for (size_t i = 0; i < size && !dfa->finished[state]; i++) {
+    const size_t transition = dfa->n_byte_classes * state + dfa->byte_classes[characters[i]];
+    const size_t accept_set = dfa->transition_accepts[transition];
+
+    if (accept_set != 0) {
+      bitmap_union(accepts, dfa->accept_sets + dfa->accepts_size * accept_set, dfa->accepts_size);
+    }
+
+    state = dfa->transitions[transition];
+  }
+
+  if (!dfa->finished[state]) {
+    const size_t accept_set = dfa->eof_accepts[state];
+    bitmap_union(accepts, dfa->accept_sets + dfa->accepts_size * accept_set, dfa->accepts_size);
+  }
+}
+
+WUR static status_t run_regex_set_vm(unsigned char *accepts,
+                                     context_t *context,
+                                     const regex_set_t *set,
+                                     const char *str,
+                                     size_t size) {
+  vm_t vm;
+
+  if (!create_vm(&vm, context, &set->regex, 0, 0)) {
+    return CREX_E_NOMEM;
+  }
+
+  vm.accepts = accepts;
+  vm.n_unaccepted = set->regex.n_patterns;
+
+  // There's no need to carry on once every pattern has matched
+  int prev_character = -1;
+
+  for (const char *eof = str + size; vm.n_unaccepted != 0; str++) {
+    const int character = (str == eof) ? -1 : (unsigned char)(*str);
+
+    const vm_status_t status = run_threads(&vm, step_thread, str, character, prev_character);
+
+    if (status == VM_STATUS_E_NOMEM) {
+      return CREX_E_NOMEM;
+    }
+
+    // The program never matches as such, so the VM never finishes of its own accord
+    assert(status == VM_STATUS_CONTINUE);
+
+    if (character == -1) {
+      break;
+    }
+
+    prev_character = character;
+  }
+
+  return CREX_OK;
+}
+
+// Yields (in accepts) a pointer to the bitmap of the set's patterns which match str. The bitmap
+// belongs to the context, and so is only valid until the context is next used
+WUR static status_t run_regex_set(const unsigned char **accepts,
+                                  context_t *context,
+                                  const regex_set_t *set,
+                                  const char *str,
+                                  size_t size) {
+  if (set->regex.n_patterns == 0) {
+    *accepts = NULL;
+    return CREX_OK;
+  }
+
+  // Native code sets bits a dword at a time, so the bitmap is padded to a multiple of 4 bytes
+  const size_t accepts_size = (bitmap_size_for_bits(set->regex.n_patterns) + 3) & ~(size_t)3;
+
+  if (context->set.capacity < accepts_size) {
+    const allocator_t *allocator = &context->allocator;
+
+    unsigned char *buffer = ALLOC(allocator, accepts_size);
+
+    if (buffer == NULL) {
+      return CREX_E_NOMEM;
+    }
+
+    FREE(allocator, context->set.accepts);
+
+    context->set.accepts = buffer;
+    context->set.capacity = accepts_size;
+  }
+
+  bitmap_clear(context->set.accepts, accepts_size);
+  *accepts = context->set.accepts;
+
+#ifdef NATIVE_COMPILER
+  if (set->native_code.code != NULL) {
+    return run_regex_set_native_code(context->set.accepts, context, set, str, size);
+  }
+#endif
+
+  if (set->has_dfa) {
+    run_regex_set_dfa(context->set.accepts, set, str, size);
+    return CREX_OK;
+  }
+
+  return run_regex_set_vm(context->set.accepts, context, set, str, size);
+}
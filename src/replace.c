@@ -0,0 +1,292 @@
+// Substitution. A template is parsed once into a list of pieces, each of which is either a run of
+// literal text or a reference to a capturing group: $N or ${N} refers to group N (where group 0 is
+// the whole match), and $$ is a literal $. Substituting appends to an output buffer supplied by the
+// caller, which is grown as needed with the context's allocator, so that repeated substitutions
+// into the same buffer needn't allocate at all once the buffer is large enough
+
+// Marks a piece of literal text
+#define TEMPLATE_LITERAL SIZE_MAX
+
+typedef struct {
+  // The group, or TEMPLATE_LITERAL
+  size_t group;
+
+  // The piece's text, for a literal, as an offset into the template's text
+  size_t offset;
+  size_t size;
+} template_piece_t;
+
+struct crex_template {
+  size_t n_pieces;
+  template_piece_t *pieces;
+
+  // The literal text, with the $s of $$ removed
+  char *text;
+
+  // One more than the greatest group referenced, or 0 if there are none
+  size_t n_groups;
+
+  allocator_t allocator;
+};
+
+static void destroy_template(template_t *tmpl);
+
+// Yields the group number at *tmpl (advancing past it), or SIZE_MAX if there isn't one
+static size_t parse_template_group(const char **tmpl, const char *eof) {
+  const char *digits = *tmpl;
+
+  if (digits == eof || *digits < '0' || *digits > '9') {
+    return SIZE_MAX;
+  }
+
+  size_t group = 0;
+
+  for (; digits != eof && '0' <= *digits && *digits <= '9'; digits++) {
+    const size_t digit = (size_t)(*digits - '0');
+
+    if (group > (SIZE_MAX - 1 - digit) / 10) {
+      return SIZE_MAX;
+    }
+
+    group = 10 * group + digit;
+  }
+
+  *tmpl = digits;
+
+  return group;
+}
+
+WUR static template_t *compile_template(status_t *status,
+                                        const char *tmpl,
+                                        size_t size,
+                                        const allocator_t *allocator) {
+  status_t local_status;
+
+  if (status == NULL) {
+    status = &local_status;
+  }
+
+  template_t *result = ALLOC(allocator, sizeof(template_t));
+
+  // A template has no more pieces than characters (plus one, for the empty template), and no more
+  // literal text
+  template_piece_t *pieces = ALLOC(allocator, sizeof(template_piece_t) * (size + 1));
+  char *text = ALLOC(allocator, size + 1);
+
+  if (result == NULL || pieces == NULL || text == NULL) {
+    FREE(allocator, result);
+    FREE(allocator, pieces);
+    FREE(allocator, text);
+    *status = CREX_E_NOMEM;
+    return NULL;
+  }
+
+  result->n_pieces = 0;
+  result->pieces = pieces;
+  result->text = text;
+  result->n_groups = 0;
+  result->allocator = *allocator;
+
+  size_t text_size = 0;
+
+  for (const char *eof = tmpl + size; tmpl != eof;) {
+    size_t group = TEMPLATE_LITERAL;
+
+    if (*tmpl == '$') {
+      tmpl++;
+
+      if (tmpl != eof && *tmpl == '$') {
+        tmpl++;
+      } else if (tmpl != eof && *tmpl == '{') {
+        tmpl++;
+        group = parse_template_group(&tmpl, eof);
+
+        if (group == SIZE_MAX || tmpl == eof || *tmpl != '}') {
+          *status = CREX_E_BAD_TEMPLATE;
+          destroy_template(result);
+          return NULL;
+        }
+
+        tmpl++;
+      } else {
+        group = parse_template_group(&tmpl, eof);
+
+        if (group == SIZE_MAX) {
+          *status = CREX_E_BAD_TEMPLATE;
+          destroy_template(result);
+          return NULL;
+        }
+      }
+
+      if (group == TEMPLATE_LITERAL) {
+        text[text_size++] = '$';
+      }
+    } else {
+      text[text_size++] = *(tmpl++);
+    }
+
+    if (group != TEMPLATE_LITERAL) {
+      template_piece_t *piece = &pieces[result->n_pieces++];
+      piece->group = group;
+      piece->offset = 0;
+      piece->size = 0;
+
+      if (group + 1 > result->n_groups) {
+        result->n_groups = group + 1;
+      }
+
+      continue;
+    }
+
+    // Extend the preceding literal, if any
+    template_piece_t *last = (result->n_pieces == 0) ? NULL : &pieces[result->n_pieces - 1];
+
+    if (last != NULL && last->group == TEMPLATE_LITERAL) {
+      last->size++;
+    } else {
+      template_piece_t *piece = &pieces[result->n_pieces++];
+      piece->group = TEMPLATE_LITERAL;
+      piece->offset = text_size - 1;
+      piece->size = 1;
+    }
+  }
+
+  *status = CREX_OK;
+
+  return result;
+}
+
+static void destroy_template(template_t *tmpl) {
+  const allocator_t *allocator = &tmpl->allocator;
+
+  FREE(allocator, tmpl->pieces);
+  FREE(allocator, tmpl->text);
+  FREE(allocator, tmpl);
+}
+
+// Append to the output, which is kept NUL-terminated
+WUR static int
+output_append(output_t *output, const char *data, size_t size, const allocator_t *allocator) {
+  if (output->size + size + 1 > output->capacity) {
+    size_t capacity = 2 * output->capacity;
+
+    if (capacity < output->size + size + 1) {
+      capacity = output->size + size + 1;
+    }
+
+    char *buffer = ALLOC(allocator, capacity);
+
+    if (buffer == NULL) {
+      return 0;
+    }
+
+    safe_memcpy(buffer, output->buffer, output->size);
+    FREE(allocator, output->buffer);
+
+    output->buffer = buffer;
+    output->capacity = capacity;
+  }
+
+  safe_memcpy(output->buffer + output->size, data, size);
+  output->size += size;
+  output->buffer[output->size] = 0;
+
+  return 1;
+}
+
+WUR static int expand_template(output_t *output,
+                               const template_t *tmpl,
+                               const match_t *matches,
+                               const allocator_t *allocator) {
+  for (size_t i = 0; i < tmpl->n_pieces; i++) {
+    const template_piece_t *piece = &tmpl->pieces[i];
+
+    int success;
+
+    if (piece->group == TEMPLATE_LITERAL) {
+      success = output_append(output, tmpl->text + piece->offset, piece->size, allocator);
+    } else {
+      // A group that didn't participate in the match expands to nothing
+      const match_t *match = &matches[piece->group];
+      const size_t size = (match->begin == NULL) ? 0 : (size_t)(match->end - match->begin);
+      success = output_append(output, match->begin, size, allocator);
+    }
+
+    if (!success) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+// The number of groups which can be substituted without allocating
+#define REPLACE_STACK_GROUPS 16
+
+// Append str to the output, with the first match (or if all is nonzero, each of the successive
+// non-overlapping matches, as found by crex_find_all, whose state in the context this clobbers)
+// replaced by the template's expansion
+WUR static status_t replace(output_t *output,
+                            context_t *context,
+                            const regex_t *regex,
+                            const template_t *tmpl,
+                            const char *str,
+                            size_t size,
+                            int all) {
+  if (tmpl->n_groups > regex->n_capturing_groups) {
+    return CREX_E_BAD_TEMPLATE;
+  }
+
+  const allocator_t *allocator = &context->allocator;
+
+  // A template that only refers to the whole match needs only a find
+  const size_t n_groups = (tmpl->n_groups <= 1) ? 1 : regex->n_capturing_groups;
+
+  match_t stack_matches[REPLACE_STACK_GROUPS];
+  match_t *matches = stack_matches;
+
+  if (n_groups > REPLACE_STACK_GROUPS) {
+    matches = ALLOC(allocator, sizeof(match_t) * n_groups);
+
+    if (matches == NULL) {
+      return CREX_E_NOMEM;
+    }
+  }
+
+  crex_find_all(context, regex, str, size);
+
+  // The end of the input copied to the output so far
+  const char *copied = str;
+
+  status_t status;
+
+  for (;;) {
+    status = next_match(matches, context, 2 * n_groups);
+
+    if (status != CREX_OK || matches[0].begin == NULL) {
+      break;
+    }
+
+    if (!output_append(output, copied, matches[0].begin - copied, allocator) ||
+        !expand_template(output, tmpl, matches, allocator)) {
+      status = CREX_E_NOMEM;
+      break;
+    }
+
+    copied = matches[0].end;
+
+    if (!all) {
+      break;
+    }
+  }
+
+  if (status == CREX_OK && !output_append(output, copied, str + size - copied, allocator)) {
+    status = CREX_E_NOMEM;
+  }
+
+  if (matches != stack_matches) {
+    FREE(allocator, matches);
+  }
+
+  return status;
+}
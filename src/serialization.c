@@ -131,8 +131,8 @@ static void serialize_operand_le(void *destination, size_t operand, size_t size)
   }
 }
 
-static size_t deserialize_operand_le(void *source, size_t size) {
-  unsigned char *bytes = source;
+static size_t deserialize_operand_le(const void *source, size_t size) {
+  const unsigned char *bytes = source;
 
   switch (size) {
   case 0:
@@ -155,6 +155,20 @@ static size_t deserialize_operand_le(void *source, size_t size) {
     return operand;
   }
 
+#ifdef NATIVE_COMPILER
+  case 8: {
+    size_t operand = bytes[0];
+    operand |= ((size_t)bytes[1]) << 8u;
+    operand |= ((size_t)bytes[2]) << 16u;
+    operand |= ((size_t)bytes[3]) << 24u;
+    operand |= ((size_t)bytes[4]) << 32u;
+    operand |= ((size_t)bytes[5]) << 40u;
+    operand |= ((size_t)bytes[6]) << 48u;
+    operand |= ((size_t)bytes[7]) << 56u;
+    return operand;
+  }
+#endif
+
   default:
     assert(0);
     return 0;
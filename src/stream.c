@@ -0,0 +1,95 @@
+// Streaming queries, whose input arrives in chunks. The VM only looks at the current and previous
+// characters at each step, so its threads can simply be carried across chunks in the context, and
+// no past input need be retained. Streams always run on the VM; native code keeps its state in
+// registers for the duration of a call.
+//
+// The result of a stream is reported as offsets from the beginning of the input. The VM records a
+// position by storing the str passed to run_threads, which it never dereferences, so a stream
+// passes the offset of the position in place of a pointer (plus one, so that offset zero isn't
+// NULL). A group that didn't participate in the match, or any group if there was no match, has
+// both offsets equal to SIZE_MAX
+//
+// A stream occupies the context's buffer from crex_stream_begin until crex_stream_end, so the
+// context can't be used for any other query in the meantime
+
+#define STREAM_POSITION(offset) ((const char *)(uintptr_t)((offset) + 1))
+#define STREAM_OFFSET(position) ((size_t)((uintptr_t)(position)-1))
+
+WUR static status_t begin_stream(context_t *context, const regex_t *regex, size_t n_pointers) {
+  if (!create_vm(&context->stream.vm, context, regex, n_pointers, 0)) {
+    return CREX_E_NOMEM;
+  }
+
+  context->stream.offset = 0;
+  context->stream.prev_character = -1;
+  context->stream.done = 0;
+
+  return CREX_OK;
+}
+
+WUR static status_t feed_stream(context_t *context, const char *chunk, size_t size) {
+  vm_t *vm = &context->stream.vm;
+
+  // Once the result is known, the rest of the input is irrelevant
+  for (size_t i = 0; i < size && !context->stream.done; i++) {
+    const int character = (unsigned char)chunk[i];
+
+    const vm_status_t status = run_threads(vm,
+                                           step_thread,
+                                           STREAM_POSITION(context->stream.offset),
+                                           character,
+                                           context->stream.prev_character);
+
+    if (status == VM_STATUS_E_NOMEM) {
+      return CREX_E_NOMEM;
+    }
+
+    if (status == VM_STATUS_DONE) {
+      context->stream.done = 1;
+      break;
+    }
+
+    assert(status == VM_STATUS_CONTINUE);
+
+    context->stream.prev_character = character;
+    context->stream.offset++;
+  }
+
+  return CREX_OK;
+}
+
+WUR static status_t end_stream(int *is_match, span_t *spans, context_t *context) {
+  vm_t *vm = &context->stream.vm;
+
+  // Process the EOF position
+  if (!context->stream.done) {
+    const vm_status_t status = run_threads(vm,
+                                           step_thread,
+                                           STREAM_POSITION(context->stream.offset),
+                                           -1,
+                                           context->stream.prev_character);
+
+    if (status == VM_STATUS_E_NOMEM) {
+      return CREX_E_NOMEM;
+    }
+
+    context->stream.done = 1;
+  }
+
+  *is_match = vm->matched_thread != NULL_HANDLE;
+
+  for (size_t i = 0; i < vm->n_pointers; i++) {
+    const char *position =
+        (*is_match) ? POINTER_BUFFER(*vm, vm->matched_thread)[i] : (const char *)NULL;
+
+    const size_t offset = (position == NULL) ? SIZE_MAX : STREAM_OFFSET(position);
+
+    if (i % 2 == 0) {
+      spans[i / 2].begin = offset;
+    } else {
+      spans[i / 2].end = offset;
+    }
+  }
+
+  return CREX_OK;
+}
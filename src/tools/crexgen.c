@@ -0,0 +1,55 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "crex.h"
+
+int is_identifier(const char *str);
+
+int main(int argc, char **argv) {
+  if (argc != 3 || !is_identifier(argv[1])) {
+    fprintf(stderr, "usage: %s <name> <regex>\n", argv[0]);
+    fputs("  <name> must be a C identifier, and prefixes the generated functions\n", stderr);
+    return 1;
+  }
+
+  crex_status_t status;
+  crex_regex_t *regex = crex_compile_str(&status, argv[2]);
+
+  if (regex == NULL) {
+    fprintf(stderr, "%s: invalid regex (status %d)\n", argv[0], (int)status);
+    return 1;
+  }
+
+  crex_output_t output = {NULL, 0, 0};
+
+  status = crex_generate_c(&output, regex, argv[1]);
+
+  if (status != CREX_OK) {
+    fprintf(stderr, "%s: code generation failed (status %d)\n", argv[0], (int)status);
+    free(output.buffer);
+    crex_destroy_regex(regex);
+    return 1;
+  }
+
+  fwrite(output.buffer, 1, output.size, stdout);
+
+  free(output.buffer);
+  crex_destroy_regex(regex);
+
+  return 0;
+}
+
+int is_identifier(const char *str) {
+  if (!isalpha((unsigned char)*str) && *str != '_') {
+    return 0;
+  }
+
+  for (; *str != 0; str++) {
+    if (!isalnum((unsigned char)*str) && *str != '_') {
+      return 0;
+    }
+  }
+
+  return 1;
+}
@@ -0,0 +1,526 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "crex.h"
+
+#define MAX_THREADS 64
+
+// Output is written out in chunks of about this size while a file is next in order
+#define OUTPUT_CHUNK_SIZE (64 * 1024)
+
+typedef enum { MODE_LINES, MODE_MATCHES } search_mode_t;
+
+typedef struct {
+  size_t size;
+  size_t capacity;
+  char *buffer;
+} string_t;
+
+typedef struct {
+  const char *path;
+
+  // What is yet to be printed for the file. This is written out by the thread searching the file
+  // once every file before it has been printed, and otherwise once the file has been searched
+  string_t output;
+
+  // Once output reaches this size, check whether the file is next in order
+  size_t next_flush_size;
+  int is_next;
+
+  size_t size;
+  size_t n_matches;
+  int failed;
+
+  // The errno of the failure, or 0 if the search itself failed
+  int error;
+
+  int done;
+} file_t;
+
+typedef struct {
+  const crex_regex_t *regex;
+  search_mode_t mode;
+  int count_only;
+  int print_paths;
+
+  file_t *files;
+  size_t n_files;
+
+  // The next file to be searched, the next file to be printed, and the signal that a file has been
+  // searched
+  size_t next_file;
+  size_t next_printed_file;
+  pthread_mutex_t mutex;
+  pthread_cond_t searched;
+} search_t;
+
+typedef struct {
+  search_t *search;
+  file_t *file;
+  int failed;
+} line_context_t;
+
+void *search_files(void *data);
+void search_file(search_t *search, file_t *file, crex_context_t *context);
+int search_buffer(search_t *search,
+                  file_t *file,
+                  crex_context_t *context,
+                  const char *buffer,
+                  size_t size);
+int report_line(void *data, const crex_match_t *line);
+int append(string_t *str, const char *data, size_t size);
+int append_match(string_t *str, const char *path, const crex_match_t *match);
+int append_file_match(search_t *search, file_t *file, const crex_match_t *match);
+char *read_stdin(size_t *size);
+double now(void);
+
+void usage(const char *program) {
+  fprintf(stderr, "usage: %s [-c | -o] [-j threads] [-t] <regex> [file...]\n", program);
+  fputs("  -c  print only the count of matching lines (or with -o, matches) per file\n", stderr);
+  fputs("  -o  print each match, rather than each matching line\n", stderr);
+  fputs("  -j  search up to this many files at once (default 1)\n", stderr);
+  fputs("  -t  report throughput on stderr\n", stderr);
+}
+
+int main(int argc, char **argv) {
+  search_mode_t mode = MODE_LINES;
+  int count_only = 0;
+  int report_throughput = 0;
+  long n_threads = 1;
+
+  int option;
+
+  while ((option = getopt(argc, argv, "coj:t")) != -1) {
+    switch (option) {
+    case 'c':
+      count_only = 1;
+      break;
+
+    case 'o':
+      mode = MODE_MATCHES;
+      break;
+
+    case 'j':
+      n_threads = strtol(optarg, NULL, 10);
+
+      if (n_threads < 1 || n_threads > MAX_THREADS) {
+        fprintf(stderr, "%s: -j must be between 1 and %d\n", argv[0], MAX_THREADS);
+        return 2;
+      }
+
+      break;
+
+    case 't':
+      report_throughput = 1;
+      break;
+
+    default:
+      usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (optind == argc) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  crex_status_t status;
+  crex_regex_t *regex = crex_compile_str(&status, argv[optind++]);
+
+  if (regex == NULL) {
+    fprintf(stderr, "%s: invalid regex (status %d)\n", argv[0], (int)status);
+    return 2;
+  }
+
+  // With no files, search stdin
+  static const char *stdin_path = "-";
+
+  const char **paths = (const char **)(argv + optind);
+  size_t n_files = argc - optind;
+
+  if (n_files == 0) {
+    paths = &stdin_path;
+    n_files = 1;
+  }
+
+  file_t *files = calloc(n_files, sizeof(file_t));
+
+  if (files == NULL) {
+    crex_destroy_regex(regex);
+    return 2;
+  }
+
+  for (size_t i = 0; i < n_files; i++) {
+    files[i].path = paths[i];
+    files[i].next_flush_size = OUTPUT_CHUNK_SIZE;
+  }
+
+  search_t search;
+
+  search.regex = regex;
+  search.mode = mode;
+  search.count_only = count_only;
+  search.print_paths = n_files > 1;
+  search.files = files;
+  search.n_files = n_files;
+  search.next_file = 0;
+  search.next_printed_file = 0;
+
+  pthread_mutex_init(&search.mutex, NULL);
+  pthread_cond_init(&search.searched, NULL);
+
+  if ((size_t)n_threads > n_files) {
+    n_threads = n_files;
+  }
+
+  const double begin = now();
+
+  pthread_t threads[MAX_THREADS];
+  long n_started = 0;
+
+  for (; n_started < n_threads; n_started++) {
+    if (pthread_create(&threads[n_started], NULL, search_files, &search) != 0) {
+      break;
+    }
+  }
+
+  int any_match = 0;
+  int any_failed = n_started == 0;
+
+  // Print each file's results in order, as soon as they're ready
+  for (size_t i = 0; i < n_files && n_started != 0; i++) {
+    file_t *file = &files[i];
+
+    pthread_mutex_lock(&search.mutex);
+
+    search.next_printed_file = i;
+
+    while (!file->done) {
+      pthread_cond_wait(&search.searched, &search.mutex);
+    }
+
+    pthread_mutex_unlock(&search.mutex);
+
+    if (file->failed) {
+      fprintf(stderr,
+              "%s: %s: %s\n",
+              argv[0],
+              file->path,
+              (file->error != 0) ? strerror(file->error) : "search failed");
+      any_failed = 1;
+    } else if (count_only) {
+      if (search.print_paths) {
+        printf("%s:", file->path);
+      }
+
+      printf("%zu\n", file->n_matches);
+    } else if (file->output.size != 0) {
+      fwrite(file->output.buffer, 1, file->output.size, stdout);
+    }
+
+    any_match = any_match || file->n_matches != 0;
+
+    free(file->output.buffer);
+    file->output.buffer = NULL;
+  }
+
+  for (long i = 0; i < n_started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  const double elapsed = now() - begin;
+
+  if (report_throughput) {
+    size_t total_size = 0;
+    size_t total_matches = 0;
+
+    for (size_t i = 0; i < n_files; i++) {
+      total_size += files[i].size;
+      total_matches += files[i].n_matches;
+    }
+
+    fprintf(stderr,
+            "%zu file(s), %zu byte(s), %zu %s in %.3fs on %ld thread(s): %.1f MB/s\n",
+            n_files,
+            total_size,
+            total_matches,
+            (mode == MODE_MATCHES) ? "match(es)" : "matching line(s)",
+            elapsed,
+            n_started,
+            (elapsed > 0) ? (double)total_size / elapsed / 1e6 : 0.0);
+  }
+
+  pthread_cond_destroy(&search.searched);
+  pthread_mutex_destroy(&search.mutex);
+
+  free(files);
+  crex_destroy_regex(regex);
+
+  fflush(stdout);
+
+  return any_failed ? 2 : (any_match ? 0 : 1);
+}
+
+void *search_files(void *data) {
+  search_t *search = data;
+
+  crex_context_t *context = crex_create_context(NULL);
+
+  for (;;) {
+    pthread_mutex_lock(&search->mutex);
+    const size_t index = search->next_file++;
+    pthread_mutex_unlock(&search->mutex);
+
+    if (index >= search->n_files) {
+      break;
+    }
+
+    file_t *file = &search->files[index];
+
+    if (context == NULL) {
+      file->failed = 1;
+      file->error = ENOMEM;
+    } else {
+      search_file(search, file, context);
+    }
+
+    pthread_mutex_lock(&search->mutex);
+    file->done = 1;
+    pthread_cond_broadcast(&search->searched);
+    pthread_mutex_unlock(&search->mutex);
+  }
+
+  crex_destroy_context(context);
+
+  return NULL;
+}
+
+void search_file(search_t *search, file_t *file, crex_context_t *context) {
+  if (strcmp(file->path, "-") == 0) {
+    char *buffer = read_stdin(&file->size);
+
+    if (buffer == NULL) {
+      file->failed = 1;
+      file->error = errno;
+      return;
+    }
+
+    file->failed = !search_buffer(search, file, context, buffer, file->size);
+
+    free(buffer);
+
+    return;
+  }
+
+  const int fd = open(file->path, O_RDONLY);
+
+  if (fd == -1) {
+    file->failed = 1;
+    file->error = errno;
+    return;
+  }
+
+  struct stat info;
+
+  if (fstat(fd, &info) == -1) {
+    file->error = errno;
+    close(fd);
+    file->failed = 1;
+    return;
+  }
+
+  if (!S_ISREG(info.st_mode)) {
+    close(fd);
+    file->failed = 1;
+    file->error = S_ISDIR(info.st_mode) ? EISDIR : ENODEV;
+    return;
+  }
+
+  file->size = info.st_size;
+
+  // mmap rejects empty mappings
+  if (file->size == 0) {
+    close(fd);
+    file->failed = !search_buffer(search, file, context, "", 0);
+    return;
+  }
+
+  void *buffer = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  const int error = errno;
+
+  close(fd);
+
+  if (buffer == MAP_FAILED) {
+    file->failed = 1;
+    file->error = error;
+    return;
+  }
+
+  // Only advisory, so failure doesn't matter
+  (void)madvise(buffer, file->size, MADV_SEQUENTIAL);
+
+  file->failed = !search_buffer(search, file, context, buffer, file->size);
+
+  munmap(buffer, file->size);
+}
+
+int search_buffer(search_t *search,
+                  file_t *file,
+                  crex_context_t *context,
+                  const char *buffer,
+                  size_t size) {
+  if (search->mode == MODE_MATCHES) {
+    crex_find_all(context, search->regex, buffer, size);
+
+    for (;;) {
+      crex_match_t match;
+
+      if (crex_next_match(&match, context) != CREX_OK) {
+        return 0;
+      }
+
+      if (match.begin == NULL) {
+        return 1;
+      }
+
+      file->n_matches++;
+
+      if (!search->count_only && !append_file_match(search, file, &match)) {
+        return 0;
+      }
+    }
+  }
+
+  line_context_t line_context = {search, file, 0};
+
+  const crex_status_t status =
+      crex_match_lines(context, search->regex, buffer, size, report_line, &line_context);
+
+  return status == CREX_OK && !line_context.failed;
+}
+
+int report_line(void *data, const crex_match_t *line) {
+  line_context_t *line_context = data;
+  search_t *search = line_context->search;
+  file_t *file = line_context->file;
+
+  file->n_matches++;
+
+  if (search->count_only) {
+    return 1;
+  }
+
+  if (!append_file_match(search, file, line)) {
+    line_context->failed = 1;
+    return 0;
+  }
+
+  return 1;
+}
+
+int append(string_t *str, const char *data, size_t size) {
+  if (str->size + size > str->capacity) {
+    size_t capacity = 2 * str->capacity;
+
+    if (capacity < str->size + size) {
+      capacity = str->size + size;
+    }
+
+    char *buffer = realloc(str->buffer, capacity);
+
+    if (buffer == NULL) {
+      return 0;
+    }
+
+    str->capacity = capacity;
+    str->buffer = buffer;
+  }
+
+  memcpy(str->buffer + str->size, data, size);
+  str->size += size;
+
+  return 1;
+}
+
+int append_match(string_t *str, const char *path, const crex_match_t *match) {
+  if (path != NULL && (!append(str, path, strlen(path)) || !append(str, ":", 1))) {
+    return 0;
+  }
+
+  return append(str, match->begin, match->end - match->begin) && append(str, "\n", 1);
+}
+
+int append_file_match(search_t *search, file_t *file, const crex_match_t *match) {
+  if (!append_match(&file->output, search->print_paths ? file->path : NULL, match)) {
+    file->error = ENOMEM;
+    return 0;
+  }
+
+  if (file->output.size < file->next_flush_size) {
+    return 1;
+  }
+
+  // Once a file is next in order, it stays so until it has been searched and printed
+  if (!file->is_next) {
+    pthread_mutex_lock(&search->mutex);
+    file->is_next = file == &search->files[search->next_printed_file];
+    pthread_mutex_unlock(&search->mutex);
+  }
+
+  if (!file->is_next) {
+    file->next_flush_size = file->output.size + OUTPUT_CHUNK_SIZE;
+    return 1;
+  }
+
+  // Only this thread prints until the file is done, as every file before it has been printed
+  fwrite(file->output.buffer, 1, file->output.size, stdout);
+  file->output.size = 0;
+  file->next_flush_size = OUTPUT_CHUNK_SIZE;
+
+  return 1;
+}
+
+char *read_stdin(size_t *size) {
+  string_t str = {0, 0, NULL};
+  char chunk[64 * 1024];
+
+  for (;;) {
+    const size_t n = fread(chunk, 1, sizeof(chunk), stdin);
+
+    if (!append(&str, chunk, n)) {
+      free(str.buffer);
+      return NULL;
+    }
+
+    if (n < sizeof(chunk)) {
+      break;
+    }
+  }
+
+  if (ferror(stdin)) {
+    const int error = errno;
+    free(str.buffer);
+    errno = error;
+    return NULL;
+  }
+
+  *size = str.size;
+
+  // Never NULL on success, even if stdin is empty
+  return (str.buffer == NULL) ? malloc(1) : str.buffer;
+}
+
+double now(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (double)time.tv_sec + (double)time.tv_nsec / 1e9;
+}
@@ -133,7 +133,11 @@ MU static void M(extend)(TYPE *vector, CONTAINED_TYPE *end) {
 
 MU WUR static CONTAINED_TYPE *M(emplace)(TYPE *vector, const allocator_t *allocator) {
   CONTAINED_TYPE *elem = M(reserve)(vector, 1, allocator);
-  vector->size++;
+
+  if (elem != NULL) {
+    vector->size++;
+  }
+
   return elem;
 }
 
@@ -32,6 +32,9 @@ WUR static int create_vm(
 
   vm->flags_size = bitmap_size_for_bits(regex->n_flags);
 
+  vm->accepts = NULL;
+  vm->n_unaccepted = 0;
+
 #ifndef NDEBUG
   vm->n_capturing_groups = regex->n_capturing_groups;
   vm->n_classes = regex->n_classes;
@@ -49,6 +52,22 @@ WUR static int create_vm(
   return 1;
 }
 
+// Discard all of the VM's threads, so that it can run the program afresh without being recreated
+static void reset_vm(vm_t *vm) {
+  vm->bump_pointer = 0;
+  vm->freelist = NULL_HANDLE;
+
+  vm->head = NULL_HANDLE;
+
+  vm->matched_thread = NULL_HANDLE;
+
+  // There's already room for the flags, so this can't fail
+  const vm_handle_t flags = vm_alloc(vm, vm->flags_size);
+
+  assert(flags == 0);
+  (void)flags;
+}
+
 WUR static vm_handle_t vm_alloc(vm_t *vm, size_t size) {
   // Round size up to the nearest multiple of the required alignment
   size = (size + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
@@ -292,6 +311,17 @@ WUR static thread_status_t step_thread(vm_t *vm,
     return bitmap_test_and_set(FLAGS(*vm), operand) ? TS_REJECTED : TS_CONTINUE;
   }
 
+  case VM_ACCEPT: {
+    assert(vm->accepts != NULL);
+
+    if (!bitmap_test_and_set(vm->accepts, operand)) {
+      vm->n_unaccepted--;
+    }
+
+    // The thread has done its job; the search carries on for the other patterns
+    return TS_REJECTED;
+  }
+
   default:
     UNREACHABLE();
   }
@@ -17,7 +17,8 @@ enum {
   VM_SPLIT_BACKWARDS_PASSIVE,
   VM_SPLIT_BACKWARDS_EAGER,
   VM_WRITE_POINTER,
-  VM_TEST_AND_SET_FLAG
+  VM_TEST_AND_SET_FLAG,
+  VM_ACCEPT
 };
 
 // Bytecode instruction encoding
@@ -53,6 +54,11 @@ typedef struct {
 
   size_t flags_size;
 
+  // For a regex set's program, the bitmap of patterns which have matched so far (see VM_ACCEPT),
+  // and the number of patterns which haven't. accepts is NULL for any other program
+  unsigned char *accepts;
+  size_t n_unaccepted;
+
 #ifndef NDEBUG
   size_t n_capturing_groups;
   size_t n_classes;
@@ -2,6 +2,68 @@
 
 typedef enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 } reg_t;
 
+typedef enum {
+  XMM0,
+  XMM1,
+  XMM2,
+  XMM3,
+  XMM4,
+  XMM5,
+  XMM6,
+  XMM7,
+  XMM8,
+  XMM9,
+  XMM10,
+  XMM11,
+  XMM12,
+  XMM13,
+  XMM14,
+  XMM15
+} xmm_t;
+
+// The low halves of the ymm registers are the xmm registers, and so on; only the first 16 of the
+// AVX-512 vector registers are used
+typedef enum {
+  YMM0,
+  YMM1,
+  YMM2,
+  YMM3,
+  YMM4,
+  YMM5,
+  YMM6,
+  YMM7,
+  YMM8,
+  YMM9,
+  YMM10,
+  YMM11,
+  YMM12,
+  YMM13,
+  YMM14,
+  YMM15
+} ymm_t;
+
+typedef enum {
+  ZMM0,
+  ZMM1,
+  ZMM2,
+  ZMM3,
+  ZMM4,
+  ZMM5,
+  ZMM6,
+  ZMM7,
+  ZMM8,
+  ZMM9,
+  ZMM10,
+  ZMM11,
+  ZMM12,
+  ZMM13,
+  ZMM14,
+  ZMM15
+} zmm_t;
+
+// AVX-512 opmask registers
+typedef enum { K0, K1, K2, K3, K4, K5, K6, K7 } kreg_t;
+
 typedef enum { SCALE_1, SCALE_2, SCALE_4, SCALE_8 } scale_t;
 
 #define REX(w, r, x, b) (0x40u | ((w) << 3u) | ((r) << 2u) | ((x) << 1u) | (b))
@@ -66,7 +128,12 @@ static size_t encode_rex_m(unsigned char *data, int rex_w, int rex_r, memory_t r
   return 0;
 }
 
-static size_t encode_mod_reg_rm_m(unsigned char *data, size_t reg_or_extension, memory_t rm) {
+// With EVEX encoding, an 8-bit displacement is implicitly scaled by some n (usually the size of the
+// memory operand); for everything else, n = 1
+static size_t encode_mod_reg_rm_m_scaled(unsigned char *data,
+                                         size_t reg_or_extension,
+                                         memory_t rm,
+                                         long n) {
   size_t displacement_size;
   unsigned char mod;
 
@@ -81,9 +148,11 @@ static size_t encode_mod_reg_rm_m(unsigned char *data, size_t reg_or_extension,
   } else if (rm.displacement == 0 && rm.base != RBP && rm.base != R13) {
     displacement_size = 0;
     mod = 0;
-  } else if (-128 <= rm.displacement && rm.displacement <= 127) {
+  } else if (rm.displacement % n == 0 && -128 <= rm.displacement / n &&
+             rm.displacement / n <= 127) {
     displacement_size = 1;
     mod = 1;
+    rm.displacement /= n;
   } else {
     assert(-2147483648 <= rm.displacement && rm.displacement <= 2147483647);
     displacement_size = 4;
@@ -120,6 +189,113 @@ static size_t encode_mod_reg_rm_m(unsigned char *data, size_t reg_or_extension,
   return 1 + displacement_size;
 }
 
+static size_t encode_mod_reg_rm_m(unsigned char *data, size_t reg_or_extension, memory_t rm) {
+  return encode_mod_reg_rm_m_scaled(data, reg_or_extension, rm, 1);
+}
+
+// A VEX prefix subsumes REX, any mandatory legacy prefix (pp), and the opcode's escape bytes (map),
+// and adds a vector length (l) and an extra source register (vvvv). The R, X, B, and vvvv fields
+// are stored inverted
+static size_t encode_vex(unsigned char *data,
+                         int vex_w,
+                         int rex_r,
+                         int rex_x,
+                         int rex_b,
+                         size_t map,
+                         size_t vvvv,
+                         size_t l,
+                         size_t pp) {
+  assert(l <= 1 && pp <= 3 && vvvv <= 15);
+
+  // The two-byte form implies the 0x0f map and can't encode X, B, or W
+  if (!rex_x && !rex_b && !vex_w && map == 1) {
+    data[0] = 0xc5;
+    data[1] = ((!rex_r) << 7u) | ((~vvvv & 15u) << 3u) | (l << 2u) | pp;
+    return 2;
+  }
+
+  data[0] = 0xc4;
+  data[1] = ((!rex_r) << 7u) | ((!rex_x) << 6u) | ((!rex_b) << 5u) | map;
+  data[2] = (vex_w << 7u) | ((~vvvv & 15u) << 3u) | (l << 2u) | pp;
+  return 3;
+}
+
+static size_t encode_vex_r(unsigned char *data,
+                           int vex_w,
+                           int rex_r,
+                           size_t map,
+                           size_t vvvv,
+                           size_t l,
+                           size_t pp,
+                           reg_t rm) {
+  return encode_vex(data, vex_w, rex_r, 0, rm >> 3u, map, vvvv, l, pp);
+}
+
+static size_t encode_vex_m(unsigned char *data,
+                           int vex_w,
+                           int rex_r,
+                           size_t map,
+                           size_t vvvv,
+                           size_t l,
+                           size_t pp,
+                           memory_t rm) {
+  const int rex_x = (rm.has_index) ? (rm.index >> 3u) : 0;
+  const int rex_b = (rm.rip_relative) ? 0 : rm.base >> 3u;
+  return encode_vex(data, vex_w, rex_r, rex_x, rex_b, map, vvvv, l, pp);
+}
+
+// An EVEX prefix is laid out like a three-byte VEX prefix, with a fourth byte for the opmask and
+// the extra bits needed to address 32 vector registers. We never use masking, broadcasting, or the
+// upper 16 registers, so those bits are fixed
+static size_t encode_evex(unsigned char *data,
+                          int evex_w,
+                          int rex_r,
+                          int rex_x,
+                          int rex_b,
+                          size_t map,
+                          size_t vvvv,
+                          size_t l,
+                          size_t pp) {
+  assert(l <= 2 && pp <= 3 && vvvv <= 15);
+
+  data[0] = 0x62;
+
+  // R' (inverted) is set
+  data[1] = ((!rex_r) << 7u) | ((!rex_x) << 6u) | ((!rex_b) << 5u) | (1u << 4u) | map;
+
+  // The fixed bit 2 is set
+  data[2] = (evex_w << 7u) | ((~vvvv & 15u) << 3u) | (1u << 2u) | pp;
+
+  // V' (inverted) is set; z, b, and the opmask are clear
+  data[3] = (l << 5u) | (1u << 3u);
+
+  return 4;
+}
+
+static size_t encode_evex_r(unsigned char *data,
+                            int evex_w,
+                            int rex_r,
+                            size_t map,
+                            size_t vvvv,
+                            size_t l,
+                            size_t pp,
+                            reg_t rm) {
+  return encode_evex(data, evex_w, rex_r, 0, rm >> 3u, map, vvvv, l, pp);
+}
+
+static size_t encode_evex_m(unsigned char *data,
+                            int evex_w,
+                            int rex_r,
+                            size_t map,
+                            size_t vvvv,
+                            size_t l,
+                            size_t pp,
+                            memory_t rm) {
+  const int rex_x = (rm.has_index) ? (rm.index >> 3u) : 0;
+  const int rex_b = (rm.rip_relative) ? 0 : rm.base >> 3u;
+  return encode_evex(data, evex_w, rex_r, rex_x, rex_b, map, vvvv, l, pp);
+}
+
 // FIXME: sane name
 static void copy_displacement(unsigned char *destination, long value, size_t size) {
   assert(size == 0 || size == 1 || size == 4);
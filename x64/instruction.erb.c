@@ -11,14 +11,53 @@ MU static int <%= function_name %>(assembler_t *assembler, <%= param_list && "#{
 
 <%= special.split("\n").map { |line| "  #{line}" }.join("\n") %>
 
+<% elsif vex_fields %>
+
+  const int rex_r = <%= reg ? "#{reg} >> 3u" : 0 %>;
+
+<% encode_prefix = vex ? 'encode_vex' : 'encode_evex' %>
+<% prefix_args = "#{vex_w}, rex_r, #{vex_map}, #{nds ? "(size_t)#{nds}" : 0}, #{vex_l}, #{vex_pp}" %>
+<% if rm_mem %>
+  code += <%= encode_prefix %>_m(code, <%= prefix_args %>, rm_mem);
+<% else %>
+  code += <%= encode_prefix %>_r(code, <%= prefix_args %>, <%= rm_operand || 0 %>);
+<% end %>
+
+  static const unsigned char opcode[] = <%= opcode_literal %>;
+  memcpy(code, opcode, sizeof(opcode));
+  code += sizeof(opcode);
+
+<% if rm_reg %>
+  code += encode_mod_reg_rm_r(code, <%= reg_or_extension %>, <%= rm_operand %>);
+<% elsif rm_mem %>
+  code += encode_mod_reg_rm_m_scaled(code, <%= reg_or_extension %>, rm_mem, <%= evex_n || 1 %>);
+<% end %>
+
+<% if immediate %>
+<% if immediate_unsigned %>
+  serialize_operand_le(code, immediate, <%= immediate_size %>);
 <% else %>
+  copy_displacement(code, immediate, <%= immediate_size %>);
+<% end %>
+
+  code += <%= immediate_size %>;
+<% end %>
+
+<% else %>
+
+<% unless prefix.empty? %>
+  static const unsigned char prefix[] = <%= prefix_literal %>;
+  memcpy(code, prefix, sizeof(prefix));
+  code += sizeof(prefix);
+
+<% end %>
 
 <% if reg || extension || rm_reg || rm_mem %>
   const int rex_w = <%= rex_w ? 1 : 0 %>;
-  const int rex_r = <%= reg ? "reg >> 3u" : 0 %>;
+  const int rex_r = <%= reg ? "#{reg} >> 3u" : 0 %>;
 
 <% if rm_reg %>
-  code += encode_rex_r(code, rex_w, rex_r, rm_reg);
+  code += encode_rex_r(code, rex_w, rex_r, <%= rm_operand %>);
 <% elsif rm_mem %>
   code += encode_rex_m(code, rex_w, rex_r, rm_mem);
 <% else %>
@@ -32,7 +71,7 @@ MU static int <%= function_name %>(assembler_t *assembler, <%= param_list && "#{
   code += sizeof(opcode);
 
 <% if rm_reg %>
-  code += encode_mod_reg_rm_r(code, <%= reg_or_extension %>, rm_reg);
+  code += encode_mod_reg_rm_r(code, <%= reg_or_extension %>, <%= rm_operand %>);
 <% elsif rm_mem %>
   code += encode_mod_reg_rm_m(code, <%= reg_or_extension %>, rm_mem);
 <% end %>